@@ -0,0 +1,69 @@
+// Tap-to-data latency on emulated DESFire EV1 cards.
+// Compares a listen callback calling info() and readNdef() with listen({autoRead}) delivering
+// the UID, the version and the NDEF message with the arrival, and with the UID only mode.
+//
+//   node-gyp rebuild && node bench/autoread.js [taps] [latency in usec per command]
+var common = require("./common");
+var mifare = common.mifare;
+var first = common.first;
+var check = common.check;
+var now = common.now;
+
+var taps = parseInt(process.argv[2], 10) || 200;
+var latency = parseInt(process.argv[3], 10) || 2000;
+
+var reader = first(mifare.getReader());
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+var uid = [0x04, 0x41, 0x55, 0x54, 0x4F, 0x00, 0x01];
+
+// One NDEF formatted card which is tapped again and again
+mifare.mock.create(uid, {blank: true});
+var tap = common.tapper(reader);
+check(tap(uid).provision({ndef: ndef}), "provision");
+tap.remove();
+reader.release();
+mifare.mock.latency("default", latency);
+run("info+readNdef", null, function() {
+  run("autoRead", {autoRead: ["uid", "version", "ndef"]}, function() {
+    run("uid mode", {mode: "uid"}, function() {});
+  });
+});
+
+function run(name, options, next) {
+  var count = 0;
+  var total = 0;
+  var tapped;
+  function tap() {
+    tapped = now();
+    mifare.mock.insert(reader.name, uid);
+  }
+  reader.listen(function(err, r, card) {
+    if(!card) {
+      if(r.status == "empty" && count < taps) {
+        tap();
+      }
+      return;
+    }
+    var data;
+    if(options && options.mode == "uid") {
+      // A Buffer with the UID
+      data = card;
+    } else if(options) {
+      data = [card.uid, card.version, card.ndef];
+    } else {
+      data = [card.info(), card.readNdef().data];
+    }
+    total += now() - tapped;
+    if(card.free) {
+      card.free();
+    }
+    mifare.mock.remove(reader.name);
+    if(++count == taps) {
+      reader.release();
+      console.log(name + ": " + taps + " taps, mean tap-to-data " + (total / taps).toFixed(2) + " ms");
+      next();
+    }
+  }, options ? {interval: 1, autoRead: options.autoRead, mode: options.mode} : {interval: 1});
+  tap();
+}
@@ -0,0 +1,74 @@
+// Microbenchmark of the binding overhead.
+// Runs against the node_mifare_mock target which links the addon against the
+// in memory libfreefare/PCSC mock, so no reader and no card is needed.
+//
+//   node-gyp rebuild && node bench/bench.js [iterations] [--json]
+var common = require("./common");
+var mifare = common.mifare;
+var first = common.first;
+var check = common.check;
+var now = common.now;
+
+var iterations = parseInt(process.argv[2], 10) || 10000;
+var json = process.argv.indexOf("--json") != -1;
+
+function measure(name, fn) {
+  // Warm up to get the JIT out of the numbers
+  for(var i = 0; i < Math.min(iterations, 1000); i++) {
+    fn();
+  }
+  mifare.mock.reset();
+  var start = now();
+  for(var i = 0; i < iterations; i++) {
+    fn();
+  }
+  var elapsed = now() - start;
+  return {
+    name: name,
+    iterations: iterations,
+    opsPerSec: Math.round(iterations * 1e3 / elapsed),
+    nsPerOp: Math.round(elapsed * 1e6 / iterations),
+    commandsPerOp: mifare.mock.commands() / iterations
+  };
+}
+
+var reader = first(mifare.getReader());
+var tap = common.tapper(reader);
+var card = tap();
+
+var ndef = new Buffer(64);
+ndef.fill(0x42);
+var results = [];
+
+results.push(measure("info", function() {
+  check(card.info(), "info");
+}));
+results.push(measure("writeNdef", function() {
+  check(card.writeNdef(ndef), "writeNdef");
+}));
+results.push(measure("readNdef", function() {
+  check(card.readNdef(), "readNdef");
+}));
+// One arrival and one departure per iteration through the poll loop into the callback
+results.push(measure("listen", function() {
+  mifare.mock.remove(reader.name);
+  mifare.mock.tick(reader);
+  mifare.mock.insert(reader.name);
+  mifare.mock.tick(reader);
+}));
+
+tap.remove();
+reader.release();
+
+if(json) {
+  console.log(JSON.stringify(results, null, 2));
+} else {
+  results.forEach(function(r) {
+    console.log(
+      (r.name + "            ").substr(0, 12) +
+      r.opsPerSec + " ops/sec, " +
+      r.nsPerOp + " ns/op, " +
+      r.commandsPerOp + " commands/op"
+    );
+  });
+}
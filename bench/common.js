@@ -0,0 +1,62 @@
+// Helpers shared by the benchmarks
+var mifare = require("../build/Release/node_mifare_mock.node");
+
+/** The addon built against the libfreefare/PCSC mock */
+exports.mifare = mifare;
+
+/** The first value of an object, e.g. the only reader of getReader() */
+exports.first = function(obj) {
+  for (var a in obj) {
+    return obj[a];
+  }
+};
+
+/** Throw if a {err, data} result reports errors, return it otherwise */
+exports.check = function(res, name) {
+  if(res && res.err && res.err.length) {
+    throw new Error(name + " failed: " + JSON.stringify(res.err));
+  }
+  return res;
+};
+
+/** Monotonic time in ms */
+exports.now = function() {
+  var t = process.hrtime();
+  return t[0] * 1e3 + t[1] / 1e6;
+};
+
+/**
+ * Listens on the reader and returns a function tap(uid) which takes the card from the reader,
+ * puts the kept card with the uid (a new card without uid) on it and returns the card object of the arrival.
+ * The card object of the previous arrival is freed. tap.remove() takes the card from the reader.
+ */
+exports.tapper = function(reader, options) {
+  var card;
+  reader.listen(function(err, r, tag) {
+    if(tag) {
+      if(card && card.free) {
+        card.free();
+      }
+      card = tag;
+    }
+  }, options || {});
+  function remove() {
+    if(card && card.free) {
+      card.free();
+    }
+    card = undefined;
+    mifare.mock.remove(reader.name);
+    mifare.mock.tick(reader);
+  }
+  function tap(uid) {
+    remove();
+    mifare.mock.insert(reader.name, uid);
+    mifare.mock.tick(reader);
+    if(!card) {
+      throw new Error("The card was not reported by listen");
+    }
+    return card;
+  }
+  tap.remove = remove;
+  return tap;
+};
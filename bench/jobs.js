@@ -0,0 +1,72 @@
+// Encoding station with several readers driven by the native job queue.
+// Blank cards are fed to every reader, each finished card is replaced by a new blank one
+// after the handling time of the operator. Reports the throughput per reader and of the station.
+//
+//   node-gyp rebuild && node bench/jobs.js [readers] [cards] [latency in usec per command] [handling ms]
+var common = require("./common");
+var mifare = common.mifare;
+
+var readerCount = parseInt(process.argv[2], 10) || 8;
+var cards = parseInt(process.argv[3], 10) || 400;
+var latency = parseInt(process.argv[4], 10) || 2000;
+var handling = parseInt(process.argv[5], 10) || 0;
+
+mifare.mock.readers(readerCount);
+mifare.mock.latency("default", latency);
+var readers = mifare.getReader();
+var fed = 0;
+var finished = 0;
+
+function feed(name) {
+  if(fed >= cards) {
+    mifare.mock.remove(name);
+    return;
+  }
+  var i = fed++;
+  var uid = [0x04, 0x4A, 0x42, (i >> 24) & 0xFF, (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF];
+  mifare.mock.create(uid, {blank: true});
+  mifare.mock.insert(name, uid);
+}
+
+Object.keys(readers).forEach(function(name) {
+  // Cards that are not blank end up here, the jobs never need javascript
+  readers[name].listen(function(err, reader, card) {
+    if(card) {
+      card.free();
+    }
+  }, {interval: 10});
+  feed(name);
+});
+
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+var key = mifare.createKey([0, 0, 0, 0, 0, 0, 0, 0], "des", true);
+
+function done(err, result) {
+  if(err) {
+    console.log("job failed", JSON.stringify(err));
+  } else {
+    setTimeout(function() {
+      mifare.mock.remove(result.reader);
+      feed(result.reader);
+    }, handling);
+  }
+  if(++finished == cards) {
+    var stats = mifare.jobStats().data;
+    Object.keys(stats.readers).forEach(function(name) {
+      var r = stats.readers[name];
+      console.log(name + ": " + r.done + " cards, " + r.failed + " failed, " +
+        Math.round(r.cardsPerMinute) + " cards/min, busy " + Math.round(r.busy) + " ms");
+    });
+    console.log("station: " + stats.done + " cards, " + Math.round(stats.cardsPerMinute) + " cards/min with " +
+      readerCount + " readers and " + latency + " usec per command");
+    Object.keys(readers).forEach(function(name) {
+      readers[name].release();
+    });
+    key.release();
+  }
+}
+
+for(var i = 0; i < cards; i++) {
+  mifare.enqueueJob({piccKey: key, appKey: key, ndef: ndef}, done);
+}
@@ -0,0 +1,43 @@
+// Load test of the provisioning and read flows against emulated DESFire EV1 cards.
+// Every tap puts a blank card on the reader, formats it, creates the NDEF application,
+// writes and reads back an NDEF message and removes the card again.
+//
+//   node-gyp rebuild && node bench/loadtest.js [taps] [latency in usec per command]
+var common = require("./common");
+var mifare = common.mifare;
+var first = common.first;
+var check = common.check;
+var now = common.now;
+
+var taps = parseInt(process.argv[2], 10) || 1000;
+var latency = parseInt(process.argv[3], 10) || 0;
+
+var reader = first(mifare.getReader());
+var tap = common.tapper(reader);
+
+mifare.mock.latency("default", latency);
+mifare.mock.reset();
+
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+var start = now();
+for(var i = 0; i < taps; i++) {
+  var uid = [0x04, 0x4C, 0x54, (i >> 24) & 0xFF, (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF];
+  mifare.mock.create(uid, {blank: true});
+  var card = tap(uid);
+  check(card.format(), "format");
+  check(card.createNdef(), "createNdef");
+  check(card.writeNdef(ndef), "writeNdef");
+  var read = check(card.readNdef(), "readNdef");
+  if(read.data.ndef.length != ndef.length) {
+    throw new Error("Read back " + read.data.ndef.length + " bytes instead of " + ndef.length);
+  }
+  tap.remove();
+  mifare.mock.forget();
+}
+var elapsed = now() - start;
+reader.release();
+
+console.log(taps + " taps in " + Math.round(elapsed) + " ms: " +
+  Math.round(taps * 1000 / elapsed) + " taps/sec, " +
+  (mifare.mock.commands() / taps) + " commands/tap");
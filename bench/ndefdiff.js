@@ -0,0 +1,43 @@
+// Rewrites of a mostly static NDEF message where only a counter changes.
+// Compares the full writeNdef() with writeNdef(buf, {diff: true}) for both NDEF layouts
+// and reports the written bytes and card commands per update.
+//
+//   node-gyp rebuild && node bench/ndefdiff.js [updates] [message size]
+var common = require("./common");
+var mifare = common.mifare;
+var first = common.first;
+var check = common.check;
+var now = common.now;
+
+var updates = parseInt(process.argv[2], 10) || 1000;
+var size = parseInt(process.argv[3], 10) || 512;
+
+var reader = first(mifare.getReader());
+var tap = common.tapper(reader);
+
+var ndef = new Buffer(size);
+ndef.fill(0x42);
+
+function run(name, layout, options) {
+  var uid = [0x04, 0x44, 0x49, 0x46, 0x46, 0x00, layout == "backup" ? 1 : 0];
+  mifare.mock.create(uid, {blank: true});
+  var card = tap(uid);
+  check(card.provision({ndef: ndef, layout: layout}), "provision");
+  mifare.mock.reset();
+  var start = now();
+  for(var i = 0; i < updates; i++) {
+    ndef.writeUInt32BE(i, 16);
+    check(options ? card.writeNdef(ndef, options) : card.writeNdef(ndef), "writeNdef");
+  }
+  var elapsed = now() - start;
+  console.log(name + " (" + layout + "): " + updates + " updates in " + Math.round(elapsed) + " ms, " +
+    (mifare.mock.written() / updates) + " bytes/update, " + (mifare.mock.commands() / updates) + " commands/update");
+  tap.remove();
+}
+
+["std", "backup"].forEach(function(layout) {
+  run("full", layout);
+  run("diff", layout, {diff: true});
+});
+
+reader.release();
@@ -0,0 +1,55 @@
+// Provisioning throughput against emulated DESFire EV1 cards.
+// Compares format(), createNdef(), writeNdef() with provision() doing the same in one session,
+// with the standard and the backup data file NDEF layout,
+// and reports cards per minute and card commands per card.
+//
+//   node-gyp rebuild && node bench/provision.js [cards] [latency in usec per command]
+var common = require("./common");
+var mifare = common.mifare;
+var first = common.first;
+var check = common.check;
+var now = common.now;
+
+var cards = parseInt(process.argv[2], 10) || 1000;
+var latency = parseInt(process.argv[3], 10) || 0;
+
+var reader = first(mifare.getReader());
+var tap = common.tapper(reader);
+
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+var key = mifare.createKey([0, 0, 0, 0, 0, 0, 0, 0], "des", true);
+
+function run(name, encode) {
+  mifare.mock.latency("default", latency);
+  mifare.mock.reset();
+  var start = now();
+  for(var i = 0; i < cards; i++) {
+    var uid = [0x04, 0x50, 0x52, (i >> 24) & 0xFF, (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF];
+    mifare.mock.create(uid, {blank: true});
+    encode(tap(uid));
+    tap.remove();
+    mifare.mock.forget();
+  }
+  var elapsed = now() - start;
+  console.log(name + ": " + cards + " cards in " + Math.round(elapsed) + " ms: " +
+    Math.round(cards * 60000 / elapsed) + " cards/min, " +
+    (mifare.mock.commands() / cards) + " commands/card");
+}
+
+run("format+createNdef+writeNdef", function(card) {
+  check(card.format(), "format");
+  check(card.createNdef(), "createNdef");
+  check(card.writeNdef(ndef), "writeNdef");
+});
+
+run("provision", function(card) {
+  check(card.provision({piccKey: key, appKey: key, ndef: ndef}), "provision");
+});
+
+run("provision backup layout", function(card) {
+  check(card.provision({piccKey: key, appKey: key, ndef: ndef, layout: "backup"}), "provision");
+});
+
+key.release();
+reader.release();
@@ -0,0 +1,53 @@
+// Tap storm load generator.
+// Simulates N emulated readers each producing M arrivals and M departures per second.
+// The events run through the real poll timer and callCallback into the JS callback,
+// the latency from the simulated arrival/departure to the callback and the lost events are reported.
+//
+//   node-gyp rebuild && node bench/tapstorm.js [readers] [rate] [duration ms] [poll interval ms]
+var common = require("./common");
+var mifare = common.mifare;
+
+var readerCount = parseInt(process.argv[2], 10) || 40;
+var rate = parseInt(process.argv[3], 10) || 2;
+var duration = parseInt(process.argv[4], 10) || 10000;
+var interval = parseInt(process.argv[5], 10) || 250;
+
+mifare.mock.readers(readerCount);
+var readers = mifare.getReader();
+var callbacks = 0;
+
+Object.keys(readers).forEach(function(name) {
+  readers[name].listen(function(err, reader, card) {
+    callbacks++;
+    if(card) {
+      card.free();
+    }
+  }, {interval: interval});
+});
+
+var lag = 0;
+var lagCheck = Date.now();
+var lagTimer = setInterval(function() {
+  var now = Date.now();
+  lag = Math.max(lag, now - lagCheck - 100);
+  lagCheck = now;
+}, 100);
+
+mifare.mock.storm({rate: rate, duration: duration});
+
+// Let the last events of the storm drain through the poll timers
+setTimeout(function() {
+  mifare.mock.stop();
+  clearInterval(lagTimer);
+  Object.keys(readers).forEach(function(name) {
+    readers[name].release();
+  });
+  var stats = mifare.mock.stats();
+  console.log(readerCount + " readers, " + rate + " arrivals/sec each, poll every " + interval + " ms for " + duration + " ms");
+  console.log("events:    generated " + stats.generated + ", detected " + stats.detected +
+    ", delivered " + stats.delivered + ", lost " + stats.lost +
+    " (" + (stats.generated ? (100 * stats.lost / stats.generated).toFixed(1) : 0) + "%)");
+  console.log("latency:   min " + stats.latency.min + " us, mean " + Math.round(stats.latency.mean) +
+    " us, p50 " + stats.latency.p50 + " us, p99 " + stats.latency.p99 + " us, max " + stats.latency.max + " us");
+  console.log("callbacks: " + callbacks + ", max event loop lag " + lag + " ms");
+}, duration + 2 * interval + 500);
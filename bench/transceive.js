@@ -0,0 +1,55 @@
+// Raw commands through card.transceive().
+// Compares one session per command, transceiveMany() with one session for all commands,
+// and transceiveMany() writing into preallocated response Buffers.
+//
+//   node-gyp rebuild && node bench/transceive.js [commands] [batch]
+var common = require("./common");
+var mifare = common.mifare;
+var first = common.first;
+var check = common.check;
+var now = common.now;
+
+var commands = parseInt(process.argv[2], 10) || 10000;
+var batch = parseInt(process.argv[3], 10) || 16;
+
+var reader = first(mifare.getReader());
+var tap = common.tapper(reader);
+
+var uid = [0x04, 0x54, 0x52, 0x58, 0x00, 0x00, 0x01];
+mifare.mock.create(uid);
+var card = tap(uid);
+
+// DESFire GetVersion wrapped in an ISO 7816-4 APDU
+var getVersion = new Buffer([0x90, 0x60, 0x00, 0x00, 0x00]);
+var requests = [], responses = [];
+for(var i = 0; i < batch; i++) {
+  requests.push(getVersion);
+  responses.push(new Buffer(16));
+}
+
+function run(name, send) {
+  mifare.mock.reset();
+  var start = now();
+  for(var i = 0; i < commands; i += batch) {
+    send();
+  }
+  var elapsed = now() - start;
+  var sent = Math.ceil(commands / batch) * batch;
+  console.log(name + ": " + Math.round(sent / elapsed * 1000) + " commands/s, " +
+    (mifare.mock.commands() / sent).toFixed(2) + " card commands/command");
+}
+
+run("transceive", function() {
+  for(var j = 0; j < batch; j++) {
+    check(card.transceive(getVersion), "transceive");
+  }
+});
+run("transceiveMany", function() {
+  check(card.transceiveMany(requests), "transceiveMany");
+});
+run("transceiveMany into Buffers", function() {
+  check(card.transceiveMany(requests, responses), "transceiveMany");
+});
+
+tap.remove();
+reader.release();
@@ -1,70 +1,126 @@
 {
   "variables": {
     "source_dir": "src",
+    "mifare_sources": [
+      "src/mifare.cc",
+      "src/reader.cc",
+      "src/desfire.cc",
+      "src/ultralight.cc",
+      "src/utils.cc",
+      "src/keys.cc",
+      "src/jobs.cc",
+      "src/ndef_cache.cc",
+      "src/card_cache.cc",
+      "src/autoread.cc",
+      "src/filter.cc",
+      "src/events.cc",
+      "src/addon.cc",
+      "src/deadline.cc",
+      "src/device_lock.cc",
+      "src/arena.cc",
+      "src/call_watch.cc",
+      "src/transceive.cc",
+      "src/backend_pcsc.cc",
+      "src/backend_nfc.cc"
+    ],
+    # Backends compiled into node_mifare, both can be enabled side by side.
+    # Override with node-gyp configure -- -Dwith_pcsc=0 -Dwith_libnfc=1
+    "with_pcsc%": 1,
+    "conditions": [
+      ['OS=="linux"', {
+        "with_libnfc%": "<!(uname -m | grep -q ^arm && echo 1 || echo 0)",
+      }, {
+        "with_libnfc%": 0,
+      }],
+    ],
+  },
+  "target_defaults": {
+    "conditions": [
+      ['OS=="mac"', {
+        'xcode_settings': {
+          'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
+          'OTHER_CPLUSPLUSFLAGS' : ['-std=c++11','-stdlib=libc++'],
+          'OTHER_LDFLAGS': ['-stdlib=libc++'],
+          'MACOSX_DEPLOYMENT_TARGET': '10.7',
+        }
+      }]
+    ],
+    "msvs_settings": {
+      "VCCLCompilerTool": {
+        "ExceptionHandling": '2'
+      }
+    },
+    "defines": [
+      "_HAS_EXCEPTIONS=1"
+    ],
+    "cflags": [
+      "-std=c++11",
+      "-Wall",
+      "-Wextra",
+      "-Wno-unused-parameter",
+      "-fPIC",
+      "-fno-strict-aliasing",
+      "-pedantic"
+    ],
+    "cflags_cc": [
+      "-std=c++11",
+      "-Wall",
+      "-Wextra",
+      "-Wno-unused-parameter",
+      "-fPIC",
+      "-fno-strict-aliasing",
+      "-pedantic"
+    ],
+    "cflags!": [ '-fno-exceptions' ],
+    "cflags_cc!": [ '-fno-exceptions' ],
   },
   "targets": [
     {
       "target_name": "node_mifare",
       "dependencies": ["node_modules/libfreefare-pcsc/binding.gyp:freefare_pcsc"],
       "conditions": [
-        ['OS=="linux"', {
-          "variables": { "ARCH%": "<!(uname -m | grep ^arm && echo arm || /bin/true)", },
-          "conditions": [
-            ['ARCH=="arm"', {
-              "defines": [
-                "USE_LIBNFC",
-              ],
-            }],
+        ['with_pcsc==1', {
+          "defines": [
+            "HAVE_PCSC",
+          ],
+        }],
+        ['with_libnfc==1', {
+          "defines": [
+            "HAVE_LIBNFC",
           ],
         }],
-        ['OS=="mac"', {
-          'xcode_settings': {
-            'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
-            'OTHER_CPLUSPLUSFLAGS' : ['-std=c++11','-stdlib=libc++'],
-            'OTHER_LDFLAGS': ['-stdlib=libc++'],
-            'MACOSX_DEPLOYMENT_TARGET': '10.7',
-          }
-        }]
       ],
       "include_dirs": [
         "<!(node -e \"require('nan')\")",
         "<(source_dir)"
       ],
       "sources": [
-        "src/mifare.cc",
-        "src/reader.cc",
-        "src/desfire.cc",
-        "src/ultralight.cc",
-        "src/utils.cc"
+        "<@(mifare_sources)"
+      ],
+    },
+    {
+      # The addon linked against the in memory libfreefare/PCSC mock in src/mock.
+      # Used by the benchmarks in bench/, needs no reader and no libfreefare.
+      "target_name": "node_mifare_mock",
+      "conditions": [
+        ['OS=="win"', {
+          "type": "none",
+        }],
       ],
-      "msvs_settings": {
-        "VCCLCompilerTool": {
-          "ExceptionHandling": '2'
-        }
-      },
       "defines": [
-        "_HAS_EXCEPTIONS=1"
+        "HAVE_PCSC",
+        "USE_MOCK",
       ],
-      "cflags": [
-        "-std=c++11",
-        "-Wall",
-        "-Wextra",
-        "-Wno-unused-parameter",
-        "-fPIC",
-        "-fno-strict-aliasing",
-        "-pedantic"
+      "include_dirs": [
+        "<!(node -e \"require('nan')\")",
+        "<(source_dir)/mock",
+        "<(source_dir)"
       ],
-      "cflags_cc": [
-        "-std=c++11",
-        "-Wall",
-        "-Wextra",
-        "-Wno-unused-parameter",
-        "-fPIC",
-        "-fno-strict-aliasing",
-        "-pedantic"
+      "sources": [
+        "<@(mifare_sources)",
+        "src/mock/mock.cc",
+        "src/mock/mock_binding.cc"
       ],
-      "cflags!": [ '-fno-exceptions' ],
-      "cflags_cc!": [ '-fno-exceptions' ],
     }
   ]
 }
@@ -85,4 +85,7 @@ function bindings (opts) {
   throw err
 }
 
-module.exports = exports = bindings('node_mifare.node')
+// NODE_MIFARE_BACKEND=emulator loads the build linked against the emulated DESFire cards in src/mock
+module.exports = exports = bindings(
+  process.env.NODE_MIFARE_BACKEND == 'emulator' ? 'node_mifare_mock.node' : 'node_mifare.node'
+)
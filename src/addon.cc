@@ -0,0 +1,60 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "addon.h"
+#include "reader.h"
+#include "autoread.h"
+
+AddonData::AddonData(uv_loop_t *loop) : loop(loop), reads(0), reopens(0), closing(0), cleanup(false) {
+#if defined(HAVE_PCSC)
+  pcsc = NULL;
+#endif
+#if defined(HAVE_LIBNFC)
+  nfc = NULL;
+#endif
+  readers_object.Reset(Nan::New<v8::Object>());
+}
+
+AddonData::~AddonData() {
+  readers_object.Reset();
+}
+
+AddonData *AddonData_from_info(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  return static_cast<AddonData *>(v8::Local<v8::External>::Cast(info.Data())->Value());
+}
+
+void addon_export(v8::Local<v8::Object> target, const char *name, Nan::FunctionCallback callback, AddonData *addon) {
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(callback, Nan::New<v8::External>(addon));
+  Nan::Set(target, Nan::New(name).ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+void addon_drop_readers(AddonData *addon) {
+  v8::Local<v8::Object> readers = Nan::New(addon->readers_object);
+  for(std::vector<ReaderData *>::iterator iter = addon->readers.begin(); iter != addon->readers.end(); ++iter) {
+    Nan::Delete(readers, Nan::New((*iter)->name.c_str()).ToLocalChecked());
+    reader_destroy(*iter);
+  }
+  addon->readers.clear();
+}
+
+void addon_cleanup(void *arg) {
+  Nan::HandleScope scope;
+  AddonData *addon = static_cast<AddonData *>(arg);
+  addon->cleanup = true;
+  // The cards on the pool hold their readers, the after work callbacks only free them now
+  while(JobsRunning(addon) || AutoReadRunning(addon) || addon->reopens) {
+    uv_run(addon->loop, UV_RUN_ONCE);
+  }
+  addon_drop_readers(addon);
+  // The loop has to close the timers before it is closed itself
+  while(addon->closing) {
+    uv_run(addon->loop, UV_RUN_NOWAIT);
+  }
+#if defined(HAVE_PCSC)
+  PcscBackend::close(addon);
+#endif
+#if defined(HAVE_LIBNFC)
+  NfcBackend::close(addon);
+#endif
+  delete addon;
+}
@@ -0,0 +1,95 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef ADDON_H
+#define ADDON_H
+
+#include <nan.h>
+#include <uv.h>
+#include <vector>
+#include <map>
+#include <string>
+
+#include "backend.h"
+#include "jobs.h"
+#include "call_watch.h"
+
+struct ReaderData;
+
+#if defined(HAVE_LIBNFC)
+/* A device opened by the probe of NfcBackend::list with the context it was opened on */
+struct NfcProbed {
+  nfc_context *nfc;
+  nfc_device *device;
+};
+#endif
+
+/*
+ * The state of one instance of the addon.
+ * Node loads an instance per context: one for the main thread and one for every worker thread
+ * requiring the addon. Each instance has its own loop, readers, backend contexts and job queue,
+ * so the readers can be sharded across worker threads.
+ * Keys, the NDEF and card caches and the sleep setting are shared by all instances.
+ */
+struct AddonData {
+  AddonData(uv_loop_t *loop);
+  ~AddonData();
+
+  // The loop of the thread which loaded the instance, runs the poll timers and the card work
+  uv_loop_t *loop;
+  // The readers of the last getReader
+  std::vector<ReaderData *> readers;
+  // Returned by getReader, the reader objects are replaced on each call
+  Nan::Persistent<v8::Object> readers_object;
+#if defined(HAVE_PCSC)
+  pcsc_context *pcsc;
+#endif
+#if defined(HAVE_LIBNFC)
+  nfc_context *nfc;
+  // Devices opened by the probe of NfcBackend::list, taken over with their contexts by the readers on attach
+  std::map<std::string, NfcProbed> nfc_probed;
+#endif
+  // Provisioning jobs of enqueueJob
+  JobQueue jobs;
+  // Blocking time of the reader and card methods
+  CallWatch watch;
+  // Cards read by autoRead on the pool
+  unsigned int reads;
+  // Devices reopened on the pool after a failure
+  unsigned int reopens;
+  // Readers whose timer is not closed yet
+  unsigned int closing;
+  // The environment is torn down, no javascript is called anymore
+  bool cleanup;
+};
+
+/**
+ * Get the instance a function was created for
+ * @param info The arguments of a function created by addon_export
+ **/
+AddonData *AddonData_from_info(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+/**
+ * Export a function which knows its addon instance
+ * @param target The exports object
+ * @param name The name of the function
+ * @param callback The native function
+ * @param addon Returned by AddonData_from_info in the function
+ **/
+void addon_export(v8::Local<v8::Object> target, const char *name, Nan::FunctionCallback callback, AddonData *addon);
+
+/**
+ * Destroy the readers of an instance.
+ * The readers are released and detached from their devices right away,
+ * the memory is freed when their timers are closed by the loop.
+ * @param addon The instance
+ **/
+void addon_drop_readers(AddonData *addon);
+
+/**
+ * Tear down an instance when its environment exits (process exit or end of a worker thread).
+ * Waits for the card work on the pool, drops the readers and closes the backend contexts.
+ * @param arg The AddonData
+ **/
+void addon_cleanup(void *arg);
+
+#endif // ADDON_H
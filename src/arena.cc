@@ -0,0 +1,66 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "arena.h"
+#include <cstdlib>
+
+// Alignment of all allocations, enough for every scalar type
+static const size_t ARENA_ALIGN = 16;
+// Size of the first block before any session needed more
+static const size_t ARENA_INITIAL = 1024;
+
+static size_t arena_align(size_t size) {
+  return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+Arena::Arena() : m_block(NULL), m_size(0), m_used(0), m_overflow(NULL), m_overflow_used(0) {}
+
+Arena::~Arena() {
+  reset();
+  free(m_block);
+}
+
+void *Arena::alloc(size_t size) {
+  size = arena_align(size ? size : 1);
+  if(!m_block) {
+    m_size = size > ARENA_INITIAL ? size : ARENA_INITIAL;
+    m_block = static_cast<uint8_t *>(malloc(m_size));
+    if(!m_block) {
+      m_size = 0;
+      return NULL;
+    }
+  }
+  if(m_used + size <= m_size) {
+    void *result = m_block + m_used;
+    m_used += size;
+    return result;
+  }
+  // The first block is still in use, the session gets a block of its own which is merged on reset
+  Overflow *block = static_cast<Overflow *>(malloc(arena_align(sizeof(Overflow)) + size));
+  if(!block) {
+    return NULL;
+  }
+  block->next = m_overflow;
+  m_overflow = block;
+  m_overflow_used += size;
+  return reinterpret_cast<uint8_t *>(block) + arena_align(sizeof(Overflow));
+}
+
+void Arena::reset() {
+  if(m_overflow) {
+    while(m_overflow) {
+      Overflow *next = m_overflow->next;
+      free(m_overflow);
+      m_overflow = next;
+    }
+    // Grow the first block to what the session needed, the next one fits without overflow
+    uint8_t *block = static_cast<uint8_t *>(malloc(m_used + m_overflow_used));
+    if(block) {
+      free(m_block);
+      m_block = block;
+      m_size = m_used + m_overflow_used;
+    }
+    m_overflow_used = 0;
+  }
+  m_used = 0;
+}
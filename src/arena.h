@@ -0,0 +1,57 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * Bump allocator for the scratch buffers of one card session.
+ * Allocations are never freed one by one, the whole arena is reset when the session ends.
+ * The first block grows to the high water mark of the sessions, after a few taps
+ * a session is served from it without touching the heap.
+ * Not thread safe, a reader only runs one session at a time.
+ */
+class Arena {
+  public:
+    /* An empty arena, the first block is allocated on the first use */
+    Arena();
+
+    ~Arena();
+
+    /* Returns size bytes aligned for any type, NULL if the heap is exhausted */
+    void *alloc(size_t size);
+
+    /* Returns an array of count elements of T, uninitialized */
+    template<class T>
+    T *alloc(size_t count) {
+      return static_cast<T *>(alloc(count * sizeof(T)));
+    }
+
+    /* Releases all allocations. The memory is kept for the next session */
+    void reset();
+
+    /* Bytes in the first block */
+    size_t capacity() const {
+      return m_size;
+    }
+
+  private:
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+
+    /* Blocks for the allocations which did not fit, chained and freed on reset */
+    struct Overflow {
+      Overflow *next;
+    };
+
+    uint8_t *m_block;
+    size_t m_size;
+    size_t m_used;
+    Overflow *m_overflow;
+    // Bytes served by the overflow blocks since the last reset
+    size_t m_overflow_used;
+};
+
+#endif // ARENA_H
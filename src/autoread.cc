@@ -0,0 +1,154 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include <string>
+#include <vector>
+#include <uv.h>
+
+#include "autoread.h"
+#include "desfire.h"
+#include "addon.h"
+#include "utils.h"
+
+/* A card read on a thread of the pool before it is reported. Only the card is touched on the worker thread */
+struct AutoReadWork {
+  AutoReadWork() : reader(NULL), card(NULL), flags(0), has_version(false), has_ndef(false), ndef_max_len(0) {
+    req.data = this;
+  }
+
+  uv_work_t req;
+  ReaderData *reader;
+  DesfireData *card;
+  unsigned int flags;
+  std::string uid;
+  bool has_version;
+  struct mifare_desfire_version_info version;
+  bool has_ndef;
+  std::vector<uint8_t> ndef;
+  uint16_t ndef_max_len;
+  std::vector<MifareError> errors;
+};
+
+bool AutoReadRunning(const AddonData *addon) {
+  return addon->reads != 0;
+}
+
+bool AutoReadOption(v8::Local<v8::Value> value, unsigned int &flags) {
+  flags = 0;
+  if(value->IsUndefined()) {
+    return true;
+  }
+  if(!value->IsArray()) {
+    return false;
+  }
+  v8::Local<v8::Array> items = v8::Local<v8::Array>::Cast(value);
+  for(uint32_t i = 0; i < items->Length(); i++) {
+    std::string item = *Nan::Utf8String(items->Get(i));
+    if(item == "uid") {
+      flags |= AUTO_READ_UID;
+    } else if(item == "ndef") {
+      flags |= AUTO_READ_NDEF;
+    } else if(item == "version") {
+      flags |= AUTO_READ_VERSION;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Runs on a thread of the libuv pool */
+static void auto_read_work(uv_work_t *req) {
+  AutoReadWork *work = static_cast<AutoReadWork *>(req->data);
+  try {
+    DesfireGuardTag tag(work->card);
+    if(work->flags & AUTO_READ_UID) {
+      work->uid = tag.uid();
+    }
+    if(work->flags & AUTO_READ_VERSION) {
+      DesfireGetVersion(tag, work->version);
+      work->has_version = true;
+    }
+    if(work->flags & AUTO_READ_NDEF) {
+      try {
+        // A public NDEF is read over ISO 7816-4, the native lookup needs the version
+        if(!DesfireReadNdefIso(tag, work->ndef, work->ndef_max_len)) {
+          if(!work->has_version) {
+            DesfireGetVersion(tag, work->version);
+            work->has_version = true;
+          }
+          uint8_t file_no;
+          DesfireReadNdefTVL(tag, work->version, file_no, work->ndef_max_len, *key_default());
+          DesfireReadNdefFile(tag, file_no, work->ndef_max_len, work->ndef);
+        }
+        work->has_ndef = true;
+      } catch(MifareError err) {
+        // No NDEF on the card, the other data is still reported
+        work->errors.push_back(err);
+      }
+    }
+  } catch(MifareError err) {
+    work->errors.push_back(err);
+  }
+}
+
+/* Back on the main thread: report the card with the data read */
+static void auto_read_after(uv_work_t *req, int status) {
+  Nan::HandleScope scope;
+  AutoReadWork *work = static_cast<AutoReadWork *>(req->data);
+  ReaderData *reader = work->reader;
+  --reader->addon->reads;
+  reader->reading = false;
+
+  // The tags stay alive for the card object, or are freed with the last reference on return
+  TagsPtr tags = work->card->tags;
+  FreefareTag tag = work->card->tag;
+  delete work->card;
+  if(reader->callback.IsEmpty() || reader->addon->cleanup) {
+    // The reader was released meanwhile
+    delete work;
+    return;
+  }
+
+  v8::Local<v8::Object> card = DesfireCreate(reader, tags, tag);
+  if(work->flags & AUTO_READ_UID) {
+    card->Set(Nan::New("uid").ToLocalChecked(), Nan::New(work->uid.c_str()).ToLocalChecked());
+  }
+  if((work->flags & AUTO_READ_VERSION) && work->has_version) {
+    card->Set(Nan::New("version").ToLocalChecked(), DesfireVersionObject(work->version));
+  }
+  if(work->has_ndef) {
+    v8::Local<v8::Object> ndef = buffer(work->ndef.data(), work->ndef.size());
+    ndef->Set(Nan::New("maxLength").ToLocalChecked(), Nan::New(work->ndef_max_len));
+    card->Set(Nan::New("ndef").ToLocalChecked(), ndef);
+  }
+  if(!work->errors.empty()) {
+    v8::Local<v8::Array> errors = Nan::New<v8::Array>();
+    for(size_t i = 0; i < work->errors.size(); i++) {
+      errors->Set(i, errorObject(work->errors[i]));
+    }
+    card->Set(Nan::New("readErr").ToLocalChecked(), errors);
+  }
+  v8::Local<v8::Object> reader_obj = Nan::New(reader->self);
+  reader_obj->Set(Nan::New("name").ToLocalChecked(), Nan::New(reader->name.c_str()).ToLocalChecked());
+  reader_obj->Set(Nan::New("status").ToLocalChecked(), Nan::New("present").ToLocalChecked());
+  delete work;
+  callCallback(reader, Nan::Undefined(), reader_obj, card);
+}
+
+bool AutoReadDispatch(ReaderData *reader, const TagsPtr &tags, FreefareTag tag) {
+  // The read takes the whole tag list, so only single cards are taken
+  if(!reader->auto_read || !tags || tags.get()[0] != tag || tags.get()[1] != NULL) {
+    return false;
+  }
+  AutoReadWork *work = new AutoReadWork();
+  work->reader = reader;
+  work->flags = reader->auto_read;
+  work->card = new DesfireData(reader, tags);
+  work->card->tag = tag;
+  // The reader is not polled until the card is reported, so events stay in order
+  reader->reading = true;
+  ++reader->addon->reads;
+  uv_queue_work(reader->addon->loop, &work->req, auto_read_work, auto_read_after);
+  return true;
+}
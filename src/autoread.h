@@ -0,0 +1,39 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef AUTOREAD_H
+#define AUTOREAD_H
+
+#include <nan.h>
+
+#include "backend.h"
+#include "card.h"
+#include "reader.h"
+
+struct AddonData;
+
+/**
+ * Offer a freshly detected DESFire card to the auto read of its reader.
+ * If the reader listens with autoRead, the requested data is read on a thread of the libuv pool
+ * in one session and the card is reported to the listen callback afterwards.
+ * @param reader The reader which detected the card
+ * @param tags The tag list of the card, the read owns it if the card is taken
+ * @param tag The card
+ * @return true if the card is read
+ **/
+bool AutoReadDispatch(ReaderData *reader, const TagsPtr &tags, FreefareTag tag);
+
+/**
+ * True while cards are read on reader threads.
+ * The readers must not be destroyed then.
+ **/
+bool AutoReadRunning(const AddonData *addon);
+
+/**
+ * Parse the autoRead option of listen: an array of "uid", "ndef" and "version"
+ * @param value The option value
+ * @param flags Returns the AutoRead flags
+ * @return false on invalid values
+ **/
+bool AutoReadOption(v8::Local<v8::Value> value, unsigned int &flags);
+
+#endif // AUTOREAD_H
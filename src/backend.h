@@ -0,0 +1,101 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <vector>
+#include <string>
+
+#if defined(HAVE_PCSC)
+#if defined(__APPLE__) || defined(__linux__)
+#include <PCSC/winscard.h>
+#include <PCSC/wintypes.h>
+#else
+#include <winscard.h>
+#endif
+#include <freefare_pcsc.h>
+#endif // HAVE_PCSC
+
+#if defined(HAVE_LIBNFC)
+#include <nfc/nfc.h>
+#include <freefare_nfc.h>
+#endif // HAVE_LIBNFC
+
+#if !defined(HAVE_PCSC) && !defined(HAVE_LIBNFC)
+#error "At least one backend (HAVE_PCSC or HAVE_LIBNFC) has to be enabled"
+#endif
+
+/* Return type of the card commands. Wide enough for the PCSC LONG and the libnfc int */
+typedef long res_t;
+
+/* The backends a reader can be driven by. Every reader is bound to one at creation */
+enum MifareBackend {
+  BACKEND_PCSC,
+  BACKEND_LIBNFC
+};
+
+struct ReaderData;
+struct AddonData;
+
+/*
+ * Backend policies.
+ * Each backend is a class with static members only. The reader code is templated on the policy,
+ * the backend of a reader is dispatched once when the poll timer is started,
+ * so the poll loop itself has no virtual calls and no runtime checks of the backend.
+ */
+
+#if defined(HAVE_PCSC)
+/* Readers driven by a PCSC service (pcsc-lite, WinSCard) */
+struct PcscBackend {
+  static const MifareBackend id = BACKEND_PCSC;
+
+  /* Name of the backend as reported to javascript */
+  static const char *name() { return "pcsc"; }
+
+  /* (Re)establishes the backend context of an addon instance. Returns false on failure */
+  static bool open(AddonData *addon);
+
+  /* Releases the backend context of an addon instance */
+  static void close(AddonData *addon);
+
+  /* Appends the names of all connected devices to names. Returns false on failure */
+  static bool list(AddonData *addon, std::vector<std::string> &names);
+
+  /* Initializes the backend specific part of a reader */
+  static void attach(ReaderData *data);
+
+  /* Releases the backend specific part of a reader */
+  static void detach(ReaderData *data);
+
+  /* Prepares the reader for polling */
+  static void listen(ReaderData *data);
+
+  /* Stops using the device of the reader */
+  static void release(ReaderData *data);
+
+  /* One poll of the reader, reports changes to the javascript callback */
+  static void poll(ReaderData *data);
+
+  /* Aborts the transaction in flight on the reader. Called from the deadline watchdog thread */
+  static void abort(ReaderData *data);
+};
+#endif // HAVE_PCSC
+
+#if defined(HAVE_LIBNFC)
+/* Readers driven directly by libnfc (PN53x and friends) */
+struct NfcBackend {
+  static const MifareBackend id = BACKEND_LIBNFC;
+  static const char *name() { return "libnfc"; }
+  static bool open(AddonData *addon);
+  static void close(AddonData *addon);
+  static bool list(AddonData *addon, std::vector<std::string> &names);
+  static void attach(ReaderData *data);
+  static void detach(ReaderData *data);
+  static void listen(ReaderData *data);
+  static void release(ReaderData *data);
+  static void poll(ReaderData *data);
+  static void abort(ReaderData *data);
+};
+#endif // HAVE_LIBNFC
+
+#endif // BACKEND_H
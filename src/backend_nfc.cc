@@ -0,0 +1,454 @@
+// Copyright 2013, Rolf Meyer
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "backend.h"
+
+#if defined(HAVE_LIBNFC)
+
+#include <algorithm>
+
+#include "reader.h"
+#include "desfire.h"
+#include "ultralight.h"
+#include "jobs.h"
+#include "autoread.h"
+#include "addon.h"
+#include "utils.h"
+
+/* Backoff of the reopen of a failed device in ms */
+static const uint32_t NFC_REOPEN_MIN = 100;
+static const uint32_t NFC_REOPEN_MAX = 30000;
+
+/* Frees the uids remembered from the last poll */
+static void clear_last_uids(ReaderData *data) {
+  for(std::vector<char *>::iterator i = data->last_uids.begin(); i != data->last_uids.end(); ++i) {
+    free(*i);
+    *i = NULL;
+  }
+  data->last_uids.clear();
+}
+
+/* The reader status reported for a libnfc error */
+static const char *nfc_status(int err) {
+  if(err == NFC_EIO) {
+    return "ioerror";
+  } else if(err == NFC_EINVARG) {
+    // XXX: should not happen
+    return "error";
+  } else if(err == NFC_EDEVNOTSUPP || err == NFC_ENOTSUCHDEV || err == NFC_ENOTIMPL) {
+    return "invalid";
+  } else if(err == NFC_EOVFLOW) {
+    return "overflow";
+  } else if(err == NFC_ETIMEOUT) {
+    return "timeout";
+  } else if(err == NFC_EOPABORTED) {
+    return "aborted";
+  } else if(err == NFC_ETGRELEASED) {
+    return "released";
+  } else if(err == NFC_ERFTRANS || err == NFC_ESOFT) {
+    return "error";
+  } else if(err == NFC_EMFCAUTHFAIL) {
+    return "authfail";
+  } else if(err == NFC_ECHIP) {
+    return "brokenchip";
+  }
+  return "unknown";
+}
+
+/* The device is gone (unplugged, USB reset) and has to be reopened */
+static bool nfc_lost(int err) {
+  return err == NFC_EIO || err == NFC_ENOTSUCHDEV;
+}
+
+/* Marks the device as failed, the polls reopen it from now on */
+static void reopen_schedule(ReaderData *data) {
+  if(!data->broken) {
+    data->broken = true;
+    data->reopen_delay = NFC_REOPEN_MIN;
+    data->reopen_at = uv_hrtime() + static_cast<uint64_t>(data->reopen_delay) * 1000000;
+  }
+}
+
+/* Runs on a thread of the pool, opening a device takes a while */
+static void reopen_work(uv_work_t *req) {
+  ReaderData *data = static_cast<ReaderData *>(req->data);
+  GuardReader reader_guard(data, true);
+  if(data->device) {
+    nfc_close(data->device);
+  }
+  data->device = data->nfc ? nfc_open(data->nfc, data->name.c_str()) : NULL;
+  if(data->device && nfc_initiator_init(data->device) < 0) {
+    nfc_close(data->device);
+    data->device = NULL;
+  }
+}
+
+/* Back on the loop: report the recovery or back off */
+static void reopen_after(uv_work_t *req, int status) {
+  Nan::HandleScope scope;
+  ReaderData *data = static_cast<ReaderData *>(req->data);
+  delete req;
+  data->reading = false;
+  data->addon->reopens--;
+  if(data->addon->cleanup) {
+    // The device is closed when the reader is detached
+    return;
+  }
+  if(data->callback.IsEmpty()) {
+    // Released meanwhile
+    NfcBackend::release(data);
+    return;
+  }
+  if(!data->device) {
+    data->reopen_delay = std::min(data->reopen_delay * 2, NFC_REOPEN_MAX);
+    data->reopen_at = uv_hrtime() + static_cast<uint64_t>(data->reopen_delay) * 1000000;
+    return;
+  }
+  data->broken = false;
+  data->last_err = NFC_SUCCESS;
+  clear_last_uids(data);
+  v8::Local<v8::Object> reader = Nan::New(data->self);
+  reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("recovered").ToLocalChecked());
+  callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+}
+
+/* Starts the reopen of a failed device when its backoff is over. The reader is not polled meanwhile */
+static void reopen_start(ReaderData *data) {
+  if(uv_hrtime() < data->reopen_at) {
+    return;
+  }
+  uv_work_t *req = new uv_work_t();
+  req->data = data;
+  data->reading = true;
+  data->addon->reopens++;
+  uv_queue_work(data->addon->loop, req, reopen_work, reopen_after);
+}
+
+/* Poll in uid mode: select an ISO14443A target and report its UID from the anticollision, no tags are created */
+static void poll_uid(ReaderData *data, v8::Local<v8::Object> reader) {
+  nfc_target target;
+  const nfc_modulation modulation = {NMT_ISO14443A, NBR_106};
+  GuardReader reader_guard(data, true);
+  int res = nfc_initiator_init(data->device);
+  if(res >= 0) {
+    nfc_device_set_property_bool(data->device, NP_INFINITE_SELECT, false);
+    res = nfc_initiator_select_passive_target(data->device, modulation, NULL, 0, &target);
+  }
+  if(res > 0) {
+    nfc_initiator_deselect_target(data->device);
+  }
+  reader_guard.unlock();
+
+  int err = res < 0 ? res : NFC_SUCCESS;
+  if(err != NFC_SUCCESS) {
+    if(err != data->last_err) {
+      data->last_err = err;
+      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New(nfc_status(err)).ToLocalChecked());
+      callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+    }
+    if(nfc_lost(err)) {
+      reopen_schedule(data);
+    }
+    return;
+  }
+  data->last_err = err;
+  FilterReport report = FILTER_NONE;
+  if(data->filter.active()) {
+    report = res > 0 ? data->filter.present(uv_hrtime()) : data->filter.absent(uv_hrtime());
+    if(report == FILTER_NONE) {
+      return;
+    }
+  }
+  if(res == 0) {
+    if(data->last_uids.size() == 0 && report != FILTER_DEPARTURE) {
+      // empty -> empty, no change
+      return;
+    }
+    clear_last_uids(data);
+    reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("empty").ToLocalChecked());
+    callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+    return;
+  }
+
+  uint8_t *uid = target.nti.nai.abtUid;
+  size_t uid_len = std::min(target.nti.nai.szUidLen, sizeof(target.nti.nai.abtUid));
+  std::string uid_hex = hexString(uid, uid_len);
+  if(report == FILTER_ARRIVAL) {
+    if(!data->filter.accept(uid_hex, uv_hrtime())) {
+      return;
+    }
+  } else if(data->last_uids.size() == 1 && uid_hex == data->last_uids[0]) {
+    // Still the same card
+    return;
+  }
+  clear_last_uids(data);
+  data->last_uids.push_back(strdup(uid_hex.c_str()));
+  reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("present").ToLocalChecked());
+  callCallback(data, Nan::Undefined(), reader, Nan::CopyBuffer(reinterpret_cast<char *>(uid), uid_len).ToLocalChecked());
+}
+
+bool NfcBackend::open(AddonData *addon) {
+  close(addon);
+  nfc_init(&addon->nfc);
+  return addon->nfc != NULL;
+}
+
+/* Closes the probed devices no reader took, with their contexts */
+static void probed_close(AddonData *addon) {
+  for(std::map<std::string, NfcProbed>::iterator i = addon->nfc_probed.begin(); i != addon->nfc_probed.end(); ++i) {
+    nfc_close(i->second.device);
+    nfc_exit(i->second.nfc);
+  }
+  addon->nfc_probed.clear();
+}
+
+/* A device opened by a probe thread */
+struct NfcProbe {
+  const char *connstring;
+  NfcProbed opened;
+  uv_thread_t thread;
+  bool started;
+};
+
+/* libnfc does not promise that one context can open devices from several threads, each probe gets its own */
+static void probe_run(void *arg) {
+  NfcProbe *probe = static_cast<NfcProbe *>(arg);
+  probe->opened.device = NULL;
+  nfc_init(&probe->opened.nfc);
+  if(!probe->opened.nfc) {
+    return;
+  }
+  probe->opened.device = nfc_open(probe->opened.nfc, probe->connstring);
+  if(!probe->opened.device) {
+    nfc_exit(probe->opened.nfc);
+    probe->opened.nfc = NULL;
+  }
+}
+
+void NfcBackend::close(AddonData *addon) {
+  probed_close(addon);
+  if(addon->nfc) {
+    nfc_exit(addon->nfc);
+  }
+  addon->nfc = NULL;
+}
+
+bool NfcBackend::list(AddonData *addon, std::vector<std::string> &names) {
+  const size_t MAX_READERS = 16;
+  nfc_connstring reader_names[MAX_READERS];
+  if(!addon->nfc) {
+    return false;
+  }
+  probed_close(addon);
+  size_t numDevices = nfc_list_devices(addon->nfc, reader_names, MAX_READERS);
+  // See if we can claim them. The devices are opened side by side, the slowest link bounds the startup,
+  // and the open handles are kept for the readers
+  NfcProbe probes[MAX_READERS];
+  for(size_t i = 0; i < numDevices; i++) {
+    probes[i].connstring = reader_names[i];
+    probes[i].started = uv_thread_create(&probes[i].thread, probe_run, &probes[i]) == 0;
+    if(!probes[i].started) {
+      probe_run(&probes[i]);
+    }
+  }
+  for(size_t i = 0; i < numDevices; i++) {
+    if(probes[i].started) {
+      uv_thread_join(&probes[i].thread);
+    }
+    if(probes[i].opened.device == NULL) {
+      // XXX: failed to open connstring
+      continue;
+    }
+    addon->nfc_probed[reader_names[i]] = probes[i].opened;
+    names.push_back(reader_names[i]);
+  }
+  return true;
+}
+
+void NfcBackend::attach(ReaderData *data) {
+  data->nfc = NULL;
+  data->last_err = NFC_ENOTSUCHDEV;
+  data->device = NULL;
+  // The device stays open from the probe, listen does not open it again.
+  // The reader owns the context of the probe, listen and the reopens use it as well
+  std::map<std::string, NfcProbed>::iterator probed = data->addon->nfc_probed.find(data->name);
+  if(probed != data->addon->nfc_probed.end()) {
+    data->nfc = probed->second.nfc;
+    data->device = probed->second.device;
+    data->addon->nfc_probed.erase(probed);
+  } else {
+    nfc_init(&data->nfc);
+  }
+  data->broken = false;
+  data->reopen_at = 0;
+  data->reopen_delay = NFC_REOPEN_MIN;
+}
+
+void NfcBackend::detach(ReaderData *data) {
+  if(data->device) {
+    nfc_close(data->device);
+  }
+  data->device = NULL;
+  if(data->nfc) {
+    nfc_exit(data->nfc);
+  }
+  data->nfc = NULL;
+  clear_last_uids(data);
+}
+
+void NfcBackend::listen(ReaderData *data) {
+  GuardReader reader_guard(data, true);
+  if(data->nfc && data->device == NULL) {
+    data->device = nfc_open(data->nfc, data->name.c_str());
+  }
+  data->broken = false;
+}
+
+void NfcBackend::release(ReaderData *data) {
+  GuardReader reader_guard(data, true);
+  if(data->device) {
+    nfc_close(data->device);
+  }
+  data->device = NULL;
+}
+
+void NfcBackend::abort(ReaderData *data) {
+  // The session holds the device, so it stays open meanwhile
+  if(data->device) {
+    nfc_abort_command(data->device);
+  }
+}
+
+void NfcBackend::poll(ReaderData *data) {
+  const char *status = NULL;
+  v8::Local<v8::Object> reader = Nan::New(data->self);
+  GuardReader reader_guard(data, true);
+  reader->Set(Nan::New("name").ToLocalChecked(), Nan::New(data->name.c_str()).ToLocalChecked());
+
+  if(data->broken) {
+    // Reported when it failed, the next report is the recovery
+    reader_guard.unlock();
+    reopen_start(data);
+    return;
+  }
+  if(!data->device) {
+    reader_guard.unlock();
+    reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("unavailable").ToLocalChecked());
+    callCallback(data, Nan::New("No NFC device associated with this reader").ToLocalChecked(), reader, Nan::Undefined());
+    reopen_schedule(data);
+    return;
+  }
+  if(data->mode == READER_MODE_UID) {
+    reader_guard.unlock();
+    poll_uid(data, reader);
+    return;
+  }
+
+  FreefareTag *tags = freefare_get_tags(data->device);
+  int err = nfc_device_get_last_error(data->device);
+  nfc_device_set_property_bool(data->device, NP_INFINITE_SELECT, false);
+  reader_guard.unlock();
+  if(data->filter.active() && err == NFC_SUCCESS) {
+    // Only filtered arrivals and departures are reported
+    data->last_err = err;
+    bool in_field = tags != NULL && tags[0] != NULL;
+    uint64_t now = uv_hrtime();
+    FilterReport report = in_field ? data->filter.present(now) : data->filter.absent(now);
+    if(report == FILTER_ARRIVAL) {
+      char *uid = freefare_get_tag_uid(tags[0]);
+      bool accepted = data->filter.accept(uid ? uid : "", now);
+      free(uid);
+      if(accepted) {
+        // Reported as new tags below
+        clear_last_uids(data);
+      } else {
+        report = FILTER_NONE;
+      }
+    }
+    if(report == FILTER_DEPARTURE) {
+      clear_last_uids(data);
+      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("empty").ToLocalChecked());
+      callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+    }
+    if(report != FILTER_ARRIVAL) {
+      freefare_free_tags(tags);
+      return;
+    }
+  }
+  // return on all but success cases
+  // for succes, we have to distinghish between empty and present
+  if(err != NFC_SUCCESS && err == data->last_err) {
+    freefare_free_tags(tags);
+    return;
+  }
+  if(err == NFC_SUCCESS && tags != NULL && tags[0] != NULL) { // found more than 0 tags -> present
+    data->last_err = err;
+
+    FreefareTag t = NULL;
+    char *old_tag_uid, *t_uid;
+    // we definetly found new tags if previous search did not get any
+    // else we have to compare in the loop below
+    bool found_new_tag = data->last_uids.size() == 0;
+    for(std::vector<char *>::const_iterator i = data->last_uids.begin(); !found_new_tag && i != data->last_uids.end(); ++i) {
+      found_new_tag = true; // assume tag is new
+      old_tag_uid = *i;
+      int tag_count = 0;
+      for(t = tags[0]; t != NULL && found_new_tag; t=tags[++tag_count]) {
+        t_uid = freefare_get_tag_uid(t);
+        if(0 == strcmp(old_tag_uid, t_uid)) {
+          found_new_tag = false; // unless it matches a known uid
+        }
+        free(t_uid);
+      }
+    }
+
+    // XXX: What happens when an existing tag get's a new uid?!
+    if(!found_new_tag) {
+      freefare_free_tags(tags);
+      return;
+    }
+    clear_last_uids(data);
+    reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("present").ToLocalChecked());
+
+    // Shared by the cards of this poll and freed with the last one, or on return if no card took it
+    TagsPtr list = tags_ptr(tags);
+    int tag_count = 0;
+    for(t = tags[0]; t != NULL; t=tags[++tag_count]) {
+      data->last_uids.push_back(freefare_get_tag_uid(t));
+      if(freefare_get_tag_type(t) == MIFARE_DESFIRE) {
+        if(JobDispatch(data, list, t) || AutoReadDispatch(data, list, t)) {
+          // The job or the read holds the tags now and reports the card
+          break;
+        }
+        v8::Local<v8::Object> card = DesfireCreate(data, list, t);
+        callCallback(data, Nan::Undefined(), reader, card);
+      } else if(freefare_get_tag_type(t) == MIFARE_ULTRALIGHT || freefare_get_tag_type(t) == MIFARE_ULTRALIGHT_C) {
+        v8::Local<v8::Object> card = UltralightCreate(data, list, t);
+        callCallback(data, Nan::Undefined(), reader, card);
+      }
+    }
+  } else { // not tag found
+    freefare_free_tags(tags);
+    data->last_err = err;
+    if(err == NFC_SUCCESS) {
+      if(data->last_uids.size() == 0) {
+        // empty -> empty, no change
+        return;
+      }
+      // present -> empty
+      clear_last_uids(data);
+      status = "empty";
+    } else {
+      status = nfc_status(err);
+      if(nfc_lost(err)) {
+        reopen_schedule(data);
+      }
+    }
+    /* Came here because err changed. So we call the callback function */
+    reader->Set(Nan::New("status").ToLocalChecked(), Nan::New(status).ToLocalChecked());
+    callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+  }
+}
+
+#endif // HAVE_LIBNFC
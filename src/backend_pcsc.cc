@@ -0,0 +1,242 @@
+// Copyright 2013, Rolf Meyer
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "backend.h"
+
+#if defined(HAVE_PCSC)
+
+#include "reader.h"
+#include "desfire.h"
+#include "ultralight.h"
+#include "jobs.h"
+#include "autoread.h"
+#include "addon.h"
+#include "transceive.h"
+#include "utils.h"
+
+/* Read the UID of the card in the field with the GET DATA pseudo APDU of PC/SC part 3, no tags are created */
+static bool pcsc_read_uid(ReaderData *data, std::vector<uint8_t> &uid) {
+  static const uint8_t get_uid[] = {0xFF, 0xCA, 0x00, 0x00, 0x00};
+  uint8_t response[12];
+  size_t length = sizeof(response);
+  // The GET DATA has the deadline of a command on a card of the reader
+  Deadline deadline;
+  deadline.start(data, data->timeout);
+  RawChannel channel(data, &deadline);
+  if(channel.open() < 0 || channel.transmit(get_uid, sizeof(get_uid), response, length) < 0) {
+    return false;
+  }
+  channel.close();
+  // The UID followed by SW1 SW2 = 90 00
+  if(length < 3 || response[length - 2] != 0x90 || response[length - 1] != 0x00) {
+    return false;
+  }
+  uid.assign(response, response + length - 2);
+  return true;
+}
+
+/*
+ * Report the card in the reader to the listen callback: its UID in uid mode, otherwise a card object.
+ * A filtered reader drops the arrival if the retap window suppresses the UID
+ * and reports a card it can't connect to as error, the filter takes it as arrival either way.
+ */
+static void report_card(ReaderData *data, v8::Local<v8::Object> reader, bool filtered) {
+  if(data->mode == READER_MODE_UID) {
+    std::vector<uint8_t> uid;
+    if(!pcsc_read_uid(data, uid)) {
+      if(filtered) {
+        data->filter.accept(std::string(), uv_hrtime());
+      }
+      callCallback(data, Nan::New("Can't read the UID of the card").ToLocalChecked(), reader, Nan::Undefined());
+      return;
+    }
+    if(filtered && !data->filter.accept(hexString(uid.data(), uid.size()), uv_hrtime())) {
+      return;
+    }
+    callCallback(data, Nan::Undefined(), reader, Nan::CopyBuffer(reinterpret_cast<char *>(uid.data()), uid.size()).ToLocalChecked());
+    return;
+  }
+
+  // Establishes a connection to a smart card contained by a specific reader.
+  FreefareTag *tags = freefare_get_tags_pcsc(data->pcsc, data->state.szReader);
+  if(filtered && !(tags && tags[0])) {
+    // Reported as arrival without card, so the filter waits for the departure instead of connecting again
+    data->filter.accept(std::string(), uv_hrtime());
+    if(tags) {
+      freefare_free_tags(tags);
+    }
+    callCallback(data, Nan::New("Can't connect to the card").ToLocalChecked(), reader, Nan::Undefined());
+    return;
+  }
+  if(filtered) {
+    char *uid = freefare_get_tag_uid(tags[0]);
+    bool accepted = data->filter.accept(uid ? uid : "", uv_hrtime());
+    free(uid);
+    if(!accepted) {
+      freefare_free_tags(tags);
+      return;
+    }
+  }
+  // Freed with the last card using it, or on return if no card took it
+  TagsPtr list = tags_ptr(tags);
+  // XXX: With PCSC tags is always length 2 with {tag, NULL} we assume this is allways the case here!!!!
+  for(int i = 0; tags && tags[i]; i++) {
+    if(tags[i] && freefare_get_tag_type(tags[i]) == MIFARE_DESFIRE) {
+      if(JobDispatch(data, list, tags[i]) || AutoReadDispatch(data, list, tags[i])) {
+        // The job or the read holds the tags now and reports the card
+        break;
+      }
+      v8::Local<v8::Object> card = DesfireCreate(data, list, tags[i]);
+      callCallback(data, Nan::Undefined(), reader, card);
+    } else if(freefare_get_tag_type(tags[i]) == MIFARE_ULTRALIGHT || freefare_get_tag_type(tags[i]) == MIFARE_ULTRALIGHT_C) {
+      v8::Local<v8::Object> card = UltralightCreate(data, list, tags[i]);
+      callCallback(data, Nan::Undefined(), reader, card);
+    }
+  }
+}
+
+/* Poll of a reader with presence filter: only filtered arrivals and departures are reported */
+static void poll_filtered(ReaderData *data, v8::Local<v8::Object> reader) {
+  uint64_t now = uv_hrtime();
+  bool in_field = (data->state.dwCurrentState & SCARD_STATE_PRESENT) != 0;
+  switch(in_field ? data->filter.present(now) : data->filter.absent(now)) {
+    case FILTER_ARRIVAL:
+      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("present").ToLocalChecked());
+      report_card(data, reader, true);
+      break;
+    case FILTER_DEPARTURE:
+      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("empty").ToLocalChecked());
+      callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+      break;
+    default:
+      break;
+  }
+}
+
+bool PcscBackend::open(AddonData *addon) {
+  close(addon);
+  // One context per instance: PCSC contexts must not be shared between threads
+  pcsc_init(&addon->pcsc);
+  return addon->pcsc != NULL;
+}
+
+void PcscBackend::close(AddonData *addon) {
+  if(addon->pcsc) {
+    pcsc_exit(addon->pcsc);
+  }
+  addon->pcsc = NULL;
+}
+
+bool PcscBackend::list(AddonData *addon, std::vector<std::string> &names) {
+  char *reader_names;
+  if(!addon->pcsc) {
+    return false;
+  }
+  LONG res = pcsc_list_devices(addon->pcsc, &reader_names);
+  if(res != SCARD_S_SUCCESS || reader_names[0] == '\0') {
+    return false;
+  }
+  // Get readers from null separated string
+  for(char *reader_iter = reader_names; *reader_iter != '\0'; reader_iter += strlen(reader_iter)+1) {
+    names.push_back(reader_iter);
+  }
+  return true;
+}
+
+void PcscBackend::attach(ReaderData *data) {
+  // One context per reader, so cancelling its status wait does not hit the other readers
+  data->pcsc = NULL;
+  pcsc_init(&data->pcsc);
+  data->state.szReader = data->name.c_str();
+  data->state.dwCurrentState = SCARD_STATE_UNAWARE;
+  data->state.pvUserData = data;
+}
+
+void PcscBackend::detach(ReaderData *data) {
+  data->state.szReader = NULL;
+  if(data->pcsc) {
+    pcsc_exit(data->pcsc);
+  }
+  data->pcsc = NULL;
+}
+
+void PcscBackend::listen(ReaderData *data) {
+}
+
+void PcscBackend::release(ReaderData *data) {
+}
+
+void PcscBackend::abort(ReaderData *data) {
+  // Ends the blocking calls on the reader's own context, e.g. a wait in SCardGetStatusChange.
+  // pcsc-lite can't interrupt a SCardTransmit in flight, it returns when the driver gives up
+  // and the session fails with the deadline error then instead of retrying
+  if(data->pcsc) {
+    SCardCancel(data->pcsc->context);
+  }
+}
+
+void PcscBackend::poll(ReaderData *data) {
+  LONG res;
+  DWORD event;
+  v8::Local<v8::String> status;
+  v8::Local<v8::Object> reader = Nan::New(data->self);
+  reader->Set(Nan::New("name").ToLocalChecked(), Nan::New(data->name.c_str()).ToLocalChecked());
+
+  res = SCardGetStatusChange(data->pcsc->context, 1, &data->state, 1);
+  if(static_cast<unsigned int>(res) == SCARD_E_CANCELLED) {
+    // A card session of this reader ran past its deadline, not a change of the reader
+    return;
+  }
+  if(data->filter.active() && (res == SCARD_S_SUCCESS || static_cast<unsigned int>(res) == SCARD_E_TIMEOUT)) {
+    // The filter needs the presence of every poll, not only the changes
+    if(res == SCARD_S_SUCCESS && (data->state.dwEventState & SCARD_STATE_CHANGED)) {
+      data->state.dwCurrentState = data->state.dwEventState;
+    }
+    poll_filtered(data, reader);
+    return;
+  }
+  if(res == SCARD_S_SUCCESS) {
+    event = data->state.dwEventState;
+    if(event & SCARD_STATE_CHANGED) {
+      data->state.dwCurrentState = event;
+      if(event & SCARD_STATE_IGNORE) {
+        status = Nan::New("ignore").ToLocalChecked();
+      } else if(event & SCARD_STATE_ATRMATCH) {
+        status = Nan::New("atrmatch").ToLocalChecked();
+      } else if(event & SCARD_STATE_EXCLUSIVE) {
+        status = Nan::New("exclusive").ToLocalChecked();
+      } else if(event & SCARD_STATE_INUSE) {
+        status = Nan::New("inuse").ToLocalChecked();
+      } else if(event & SCARD_STATE_MUTE) {
+        status = Nan::New("mute").ToLocalChecked();
+      } else if(event & SCARD_STATE_UNKNOWN) {
+        status = Nan::New("unknown").ToLocalChecked();
+      } else if(event & SCARD_STATE_UNAVAILABLE) {
+        status = Nan::New("unavailable").ToLocalChecked();
+      } else if(event & SCARD_STATE_EMPTY) {
+        status = Nan::New("empty").ToLocalChecked();
+      } else if(event & SCARD_STATE_PRESENT) {
+        status = Nan::New("present").ToLocalChecked();
+      }
+
+      // Prepare readerObject event
+      reader->Set(Nan::New("status").ToLocalChecked(), status);
+
+      // Card object, will be eventually filled lateron
+      if(event & SCARD_STATE_PRESENT) {
+        report_card(data, reader, false);
+      } else {
+        callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+      }
+    }
+  } else if(static_cast<unsigned int>(res) == SCARD_E_TIMEOUT) {
+      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("timeout").ToLocalChecked());
+      callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+  } else {
+      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("unknown").ToLocalChecked());
+      callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+  }
+}
+
+#endif // HAVE_PCSC
@@ -0,0 +1,105 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include <uv.h>
+
+#include "call_watch.h"
+#include "addon.h"
+
+CallWatch::~CallWatch() {
+  callback.Reset();
+  for(std::map<std::pair<const char *, Nan::FunctionCallback>, CallSite *>::iterator site = sites.begin(); site != sites.end(); ++site) {
+    delete site->second;
+  }
+}
+
+/* Counts a call. Returns true if it has to be reported */
+static bool watch_account(AddonData *addon, uint64_t time) {
+  CallWatch &watch = addon->watch;
+  watch.calls++;
+  if(time > watch.max) {
+    watch.max = time;
+  }
+  if(watch.threshold && time >= watch.threshold && !watch.callback.IsEmpty() && !addon->cleanup) {
+    watch.slow++;
+    return true;
+  }
+  return false;
+}
+
+/* Calls the callback with the report of a slow call, exceptions of the callback are dropped */
+static void watch_report(CallWatch &watch, const char *name, const std::string &reader, const std::string &uid, uint64_t time) {
+  v8::Local<v8::Object> report = Nan::New<v8::Object>();
+  Nan::Set(report, Nan::New("method").ToLocalChecked(), Nan::New(name).ToLocalChecked());
+  Nan::Set(report, Nan::New("reader").ToLocalChecked(), Nan::New(reader.c_str()).ToLocalChecked());
+  Nan::Set(report, Nan::New("uid").ToLocalChecked(), Nan::New(uid.c_str()).ToLocalChecked());
+  Nan::Set(report, Nan::New("time").ToLocalChecked(), Nan::New(static_cast<double>(time) / 1e6));
+  v8::Local<v8::Value> argv[1] = { report };
+  Nan::TryCatch try_catch;
+  Nan::Call(Nan::New(watch.callback), Nan::GetCurrentContext()->Global(), 1, argv);
+}
+
+/* Entry point of all watched methods */
+static void watch_call(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  CallSite *site = static_cast<CallSite *>(v8::Local<v8::External>::Cast(info.Data())->Value());
+  uint64_t start = uv_hrtime();
+  Nan::TryCatch try_catch;
+  site->callback(info);
+  uint64_t time = uv_hrtime() - start;
+  if(watch_account(site->addon, time)) {
+    // The exception of the call is held by try_catch while the report runs
+    std::string reader, uid;
+    site->subject(info.This(), reader, uid);
+    watch_report(site->addon->watch, site->name, reader, uid, time);
+  }
+  if(try_catch.HasCaught()) {
+    try_catch.ReThrow();
+  }
+}
+
+void watch_poll(AddonData *addon, const std::string &reader, uint64_t start) {
+  uint64_t time = uv_hrtime() - start;
+  if(watch_account(addon, time)) {
+    watch_report(addon->watch, "poll", reader, std::string(), time);
+  }
+}
+
+void watch_method(v8::Local<v8::Object> target, const char *name, Nan::FunctionCallback callback, CallSubject subject, AddonData *addon) {
+  CallSite *&site = addon->watch.sites[std::make_pair(name, callback)];
+  if(!site) {
+    site = new CallSite();
+    site->name = name;
+    site->callback = callback;
+    site->subject = subject;
+    site->addon = addon;
+  }
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(watch_call, Nan::New<v8::External>(site));
+  v8::Local<v8::Function> fn = Nan::GetFunction(tpl).ToLocalChecked();
+  v8::Local<v8::String> fn_name = Nan::New(name).ToLocalChecked();
+  fn->SetName(fn_name);
+  Nan::Set(target, fn_name, fn);
+}
+
+void WatchCalls(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  CallWatch &watch = AddonData_from_info(info)->watch;
+  if(info.Length() == 2 && info[0]->IsObject() && info[1]->IsFunction()) {
+    v8::Local<v8::Value> threshold = v8::Local<v8::Object>::Cast(info[0])->Get(Nan::New("threshold").ToLocalChecked());
+    if(!threshold->IsUint32() || Nan::To<uint32_t>(threshold).FromJust() == 0) {
+      Nan::ThrowError("The threshold is a number of ms larger than 0");
+      return;
+    }
+    watch.threshold = Nan::To<uint32_t>(threshold).FromJust() * 1000000ULL;
+    watch.callback.Reset(info[1].As<v8::Function>());
+  } else if(info.Length() == 0) {
+    watch.threshold = 0;
+    watch.callback.Reset();
+  } else {
+    Nan::ThrowError("The arguments are an options object {threshold: ms} and a callback(report), none to stop");
+    return;
+  }
+  v8::Local<v8::Object> stats = Nan::New<v8::Object>();
+  Nan::Set(stats, Nan::New("calls").ToLocalChecked(), Nan::New(static_cast<double>(watch.calls)));
+  Nan::Set(stats, Nan::New("slow").ToLocalChecked(), Nan::New(static_cast<double>(watch.slow)));
+  Nan::Set(stats, Nan::New("maxMs").ToLocalChecked(), Nan::New(static_cast<double>(watch.max) / 1e6));
+  info.GetReturnValue().Set(stats);
+}
@@ -0,0 +1,70 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef CALL_WATCH_H
+#define CALL_WATCH_H
+
+#include <nan.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <stdint.h>
+
+struct AddonData;
+
+/* Returns the reader name and card UID of the object a watched method was called on, empty if unknown.
+ * Runs right after a possibly failed call, so it only uses what the object already knows and sends no card command */
+typedef void (*CallSubject)(v8::Local<v8::Object> self, std::string &reader, std::string &uid);
+
+/* A watched method: the native function, its name and the instance to report to */
+struct CallSite {
+  const char *name;
+  Nan::FunctionCallback callback;
+  CallSubject subject;
+  AddonData *addon;
+};
+
+/*
+ * Blocking time of the reader and card methods and of the reader polls of one addon instance, see mifare.watchCalls.
+ * Every call is timed, calls at or over the threshold are reported to the callback
+ * right after they returned, with the method name, the reader and the card UID.
+ * Only used on the thread of the instance.
+ */
+struct CallWatch {
+  CallWatch() : threshold(0), calls(0), slow(0), max(0) {}
+  ~CallWatch();
+
+  // Reported calls take at least this long in ns, 0 disables the reports
+  uint64_t threshold;
+  Nan::Persistent<v8::Function> callback;
+  uint64_t calls;
+  uint64_t slow;
+  // Longest call in ns
+  uint64_t max;
+  // One site per method, shared by all objects of the instance
+  std::map<std::pair<const char *, Nan::FunctionCallback>, CallSite *> sites;
+};
+
+/**
+ * Nan::SetMethod with the blocking time of the calls watched
+ * @param target The reader or card object
+ * @param name The name of the method, a string literal
+ * @param callback The native function
+ * @param subject Describes the object in a report
+ * @param addon The instance the object belongs to
+ **/
+void watch_method(v8::Local<v8::Object> target, const char *name, Nan::FunctionCallback callback, CallSubject subject, AddonData *addon);
+
+/**
+ * Time a poll of a reader like a watched method, reported as method "poll" without UID.
+ * The time includes the listen callbacks run by the poll.
+ * @param addon The instance the reader belongs to
+ * @param reader The name of the reader
+ * @param start uv_hrtime when the poll started
+ **/
+void watch_poll(AddonData *addon, const std::string &reader, uint64_t start);
+
+/** mifare.watchCalls({threshold}, callback): Report reader and card calls blocking the thread longer than threshold ms,
+ *  without arguments the reports are stopped. Returns {calls, slow, maxMs} */
+void WatchCalls(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+#endif // CALL_WATCH_H
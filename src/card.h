@@ -0,0 +1,68 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef CARD_H
+#define CARD_H
+
+#include <nan.h>
+#include <memory>
+
+#include "backend.h"
+
+/*
+ * Lifetime of the native data of card objects.
+ * The tag list of a poll is shared by all cards found in it and freed with the last one.
+ * A card object holds its data through a weak handle: card.free() releases the data at once,
+ * a card javascript forgot is released when the garbage collector finds it unreachable.
+ * The data reports its size to V8 as external memory, so abandoned cards drive the collection.
+ */
+
+/* The tag list of one poll, freed with freefare_free_tags when the last card is gone */
+typedef std::shared_ptr<FreefareTag> TagsPtr;
+
+/** Take ownership of a tag list returned by freefare_get_tags */
+inline TagsPtr tags_ptr(FreefareTag *tags) {
+  return TagsPtr(tags, freefare_free_tags);
+}
+
+/* Memory held by libfreefare for a tag (tag, crypto buffer and session state), reported to V8 with the data */
+static const int CARD_TAG_MEMORY = 1024;
+
+/* Releases the data of a collected card object. Runs in the second pass, when V8 calls are allowed again */
+template<class Data>
+void card_collected(const Nan::WeakCallbackInfo<Data> &info) {
+  Data *data = info.GetParameter();
+  data->self.Reset();
+  Nan::AdjustExternalMemory(-static_cast<int>(sizeof(Data) + CARD_TAG_MEMORY));
+  delete data;
+}
+
+/**
+ * Bind the native data to its card object.
+ * The data needs a member Nan::Persistent<v8::Object> self and is deleted with the object.
+ * @param card The card object, gets the data as private "data"
+ * @param data The data, owned by the card object from now on
+ **/
+template<class Data>
+void card_attach(v8::Local<v8::Object> card, Data *data) {
+  Nan::SetPrivate(card, Nan::New("data").ToLocalChecked(), Nan::New<v8::External>(data));
+  data->self.Reset(card);
+  data->self.SetWeak(data, card_collected<Data>, Nan::WeakCallbackType::kParameter);
+  Nan::AdjustExternalMemory(static_cast<int>(sizeof(Data) + CARD_TAG_MEMORY));
+}
+
+/**
+ * Release the data of a card object now, e.g. on card.free().
+ * The object stays, its functions report "Card is already free" afterwards.
+ * @param card The card object
+ * @param data The data bound to it by card_attach
+ **/
+template<class Data>
+void card_release(v8::Local<v8::Object> card, Data *data) {
+  Nan::SetPrivate(card, Nan::New("data").ToLocalChecked(), Nan::New<v8::External>(static_cast<void *>(NULL)));
+  data->self.ClearWeak();
+  data->self.Reset();
+  Nan::AdjustExternalMemory(-static_cast<int>(sizeof(Data) + CARD_TAG_MEMORY));
+  delete data;
+}
+
+#endif // CARD_H
@@ -0,0 +1,158 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "card_cache.h"
+#include "lru_cache.h"
+
+/* Number of cards kept in the cache */
+static const size_t CARD_CACHE_SIZE = 1024;
+
+struct CardCacheEntry {
+  CardCacheEntry() : version_at(0), key_settings_at(0), free_memory_at(0), iso_ndef_at(0) {}
+  // uv_hrtime when each fact was read, 0 if it is unknown
+  struct mifare_desfire_version_info version;
+  uint64_t version_at;
+  uint8_t key_settings;
+  uint8_t max_keys;
+  uint64_t key_settings_at;
+  uint32_t free_memory;
+  uint64_t free_memory_at;
+  // Kept as long as the version, the applications only change with the writes
+  bool iso_ndef;
+  uint64_t iso_ndef_at;
+};
+
+typedef LruCache<CardCacheEntry> CardCache;
+
+/* The cache is accessed from the main thread and the worker threads */
+static CardCache cache(CARD_CACHE_SIZE);
+// Lifetimes in ns
+static uint64_t cache_ttl = 10 * 1000000000ULL;
+static uint64_t cache_version_ttl = 3600 * 1000000000ULL;
+
+/* True if a fact read at is still valid */
+static bool cache_fresh(uint64_t at, uint64_t ttl) {
+  return at && uv_hrtime() - at < ttl;
+}
+
+bool card_cache_version(const std::string &uid, struct mifare_desfire_version_info &version) {
+  CardCache::Guard guard(cache);
+  CardCacheEntry *entry = cache.find(uid);
+  if(!entry || !cache_fresh(entry->version_at, cache_version_ttl)) {
+    return false;
+  }
+  version = entry->version;
+  return true;
+}
+
+void card_cache_put_version(const std::string &uid, const struct mifare_desfire_version_info &version) {
+  CardCache::Guard guard(cache);
+  if(uid.empty() || !cache_version_ttl) {
+    return;
+  }
+  CardCacheEntry &entry = cache.entry(uid);
+  entry.version = version;
+  entry.version_at = uv_hrtime();
+}
+
+bool card_cache_key_settings(const std::string &uid, uint8_t &settings, uint8_t &max_keys) {
+  CardCache::Guard guard(cache);
+  CardCacheEntry *entry = cache.find(uid);
+  if(!entry || !cache_fresh(entry->key_settings_at, cache_ttl)) {
+    return false;
+  }
+  settings = entry->key_settings;
+  max_keys = entry->max_keys;
+  return true;
+}
+
+void card_cache_put_key_settings(const std::string &uid, uint8_t settings, uint8_t max_keys) {
+  CardCache::Guard guard(cache);
+  if(uid.empty() || !cache_ttl) {
+    return;
+  }
+  CardCacheEntry &entry = cache.entry(uid);
+  entry.key_settings = settings;
+  entry.max_keys = max_keys;
+  entry.key_settings_at = uv_hrtime();
+}
+
+bool card_cache_free_memory(const std::string &uid, uint32_t &size) {
+  CardCache::Guard guard(cache);
+  CardCacheEntry *entry = cache.find(uid);
+  if(!entry || !cache_fresh(entry->free_memory_at, cache_ttl)) {
+    return false;
+  }
+  size = entry->free_memory;
+  return true;
+}
+
+void card_cache_put_free_memory(const std::string &uid, uint32_t size) {
+  CardCache::Guard guard(cache);
+  if(uid.empty() || !cache_ttl) {
+    return;
+  }
+  CardCacheEntry &entry = cache.entry(uid);
+  entry.free_memory = size;
+  entry.free_memory_at = uv_hrtime();
+}
+
+bool card_cache_iso_ndef(const std::string &uid, bool &readable) {
+  CardCache::Guard guard(cache);
+  CardCacheEntry *entry = cache.find(uid);
+  if(!entry || !cache_fresh(entry->iso_ndef_at, cache_version_ttl)) {
+    return false;
+  }
+  readable = entry->iso_ndef;
+  return true;
+}
+
+void card_cache_put_iso_ndef(const std::string &uid, bool readable) {
+  CardCache::Guard guard(cache);
+  if(uid.empty() || !cache_version_ttl) {
+    return;
+  }
+  CardCacheEntry &entry = cache.entry(uid);
+  entry.iso_ndef = readable;
+  entry.iso_ndef_at = uv_hrtime();
+}
+
+void card_cache_invalidate(const std::string &uid) {
+  CardCache::Guard guard(cache);
+  CardCacheEntry *entry = cache.find(uid);
+  if(entry) {
+    entry->key_settings_at = 0;
+    entry->free_memory_at = 0;
+    entry->iso_ndef_at = 0;
+  }
+}
+
+void card_cache_drop(const std::string &uid) {
+  CardCache::Guard guard(cache);
+  cache.erase(uid);
+}
+
+void card_cache_configure(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  const char *error = "The only argument is an options object with members: {ttl:ms, versionTtl:ms}";
+  if(info.Length()!=1 || !info[0]->IsObject()) {
+    Nan::ThrowError(error);
+    return;
+  }
+  v8::Local<v8::Object> options = v8::Local<v8::Object>::Cast(info[0]);
+  v8::Local<v8::Value> ttl = options->Get(Nan::New("ttl").ToLocalChecked());
+  v8::Local<v8::Value> version_ttl = options->Get(Nan::New("versionTtl").ToLocalChecked());
+  if((!ttl->IsUndefined() && !ttl->IsUint32()) || (!version_ttl->IsUndefined() && !version_ttl->IsUint32())) {
+    Nan::ThrowError(error);
+    return;
+  }
+  CardCache::Guard guard(cache);
+  if(ttl->IsUint32()) {
+    cache_ttl = Nan::To<uint32_t>(ttl).FromJust() * 1000000ULL;
+  }
+  if(version_ttl->IsUint32()) {
+    cache_version_ttl = Nan::To<uint32_t>(version_ttl).FromJust() * 1000000ULL;
+  }
+  if(!cache_ttl && !cache_version_ttl) {
+    cache.clear();
+  }
+}
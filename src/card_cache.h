@@ -0,0 +1,55 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef CARD_CACHE_H
+#define CARD_CACHE_H
+
+#include <nan.h>
+#include <string>
+#include <stdint.h>
+
+#include "backend.h"
+
+/*
+ * Facts about DESFire cards which rarely or never change, keyed by the UID.
+ * A card tapped again, or moved to a neighbouring reader, is answered from memory.
+ * The version is fixed by the chip and kept for a long time, the PICC key settings and the free memory
+ * change with format and application creation: they expire sooner and are dropped by the writes.
+ * Raw commands can change anything, transceive() forgets the card completely.
+ * The cache is shared by all readers and threads and holds a limited number of cards,
+ * the least recently used card is dropped first.
+ */
+
+/** Lookup the version of a card. Returns false if it is unknown or expired */
+bool card_cache_version(const std::string &uid, struct mifare_desfire_version_info &version);
+
+/** Remember the version read from a card */
+void card_cache_put_version(const std::string &uid, const struct mifare_desfire_version_info &version);
+
+/** Lookup the key settings of the PICC master key. Returns false if they are unknown or expired */
+bool card_cache_key_settings(const std::string &uid, uint8_t &settings, uint8_t &max_keys);
+
+/** Remember the key settings of the PICC master key */
+void card_cache_put_key_settings(const std::string &uid, uint8_t settings, uint8_t max_keys);
+
+/** Lookup the free memory of a card. Returns false if it is unknown or expired */
+bool card_cache_free_memory(const std::string &uid, uint32_t &size);
+
+/** Remember the free memory of a card */
+void card_cache_put_free_memory(const std::string &uid, uint32_t size);
+
+/** Lookup whether the NDEF of a card is free to read over ISO 7816-4. Returns false if it is unknown or expired */
+bool card_cache_iso_ndef(const std::string &uid, bool &readable);
+
+/** Remember whether the NDEF of a card is free to read over ISO 7816-4 */
+void card_cache_put_iso_ndef(const std::string &uid, bool readable);
+
+/** Forget what a write can change (key settings, free memory and the ISO NDEF), e.g. after a format */
+void card_cache_invalidate(const std::string &uid);
+
+/** Forget everything about a card, e.g. before raw commands which can change anything */
+void card_cache_drop(const std::string &uid);
+
+/** mifare.setCardCache({ttl, versionTtl}): Lifetime of the cached facts in ms, 0 disables the cache */
+void card_cache_configure(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+#endif // CARD_CACHE_H
@@ -0,0 +1,101 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include <list>
+
+#include "deadline.h"
+#include "reader.h"
+
+/*
+ * The watchdog. One thread for the process, it sleeps until the earliest started deadline.
+ * The deadlines are started and stopped by the threads running the card sessions.
+ */
+static uv_once_t watchdog_once = UV_ONCE_INIT;
+static uv_mutex_t watchdog_lock;
+static uv_cond_t watchdog_cond;
+static uv_thread_t watchdog_thread;
+static std::list<Deadline *> watchdog_deadlines;
+// The deadline whose reader is aborted right now, its session waits in stop() until the abort is done
+static Deadline *watchdog_aborting = NULL;
+static uv_cond_t watchdog_aborted;
+
+/* Aborts the transaction in flight on the reader of an expired deadline */
+static void watchdog_abort(ReaderData *reader) {
+  switch(reader->backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC: PcscBackend::abort(reader); break;
+#endif
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC: NfcBackend::abort(reader); break;
+#endif
+    default: break;
+  }
+}
+
+static void watchdog_run(void *arg) {
+  uv_mutex_lock(&watchdog_lock);
+  while(true) {
+    Deadline *next = NULL;
+    for(std::list<Deadline *>::iterator i = watchdog_deadlines.begin(); i != watchdog_deadlines.end(); ++i) {
+      if(!next || (*i)->end() < next->end()) {
+        next = *i;
+      }
+    }
+    if(!next) {
+      uv_cond_wait(&watchdog_cond, &watchdog_lock);
+      continue;
+    }
+    uint64_t now = uv_hrtime();
+    if(now < next->end()) {
+      // Woken up early by a new deadline or the timeout, the list is checked again either way
+      uv_cond_timedwait(&watchdog_cond, &watchdog_lock, next->end() - now);
+      continue;
+    }
+    // The abort blocks in the backend, the other readers start and stop their deadlines meanwhile.
+    // The session of this deadline waits in stop(), so the reader stays alive until the abort is done
+    watchdog_deadlines.remove(next);
+    watchdog_aborting = next;
+    ReaderData *reader = next->reader();
+    uv_mutex_unlock(&watchdog_lock);
+    watchdog_abort(reader);
+    uv_mutex_lock(&watchdog_lock);
+    watchdog_aborting = NULL;
+    uv_cond_broadcast(&watchdog_aborted);
+  }
+}
+
+static void watchdog_init() {
+  uv_mutex_init(&watchdog_lock);
+  uv_cond_init(&watchdog_cond);
+  uv_cond_init(&watchdog_aborted);
+  uv_thread_create(&watchdog_thread, watchdog_run, NULL);
+}
+
+void Deadline::start(ReaderData *reader, uint32_t timeout) {
+  stop();
+  m_reader = reader;
+  m_timeout = timeout;
+  if(!timeout) {
+    m_end = 0;
+    return;
+  }
+  m_end = uv_hrtime() + static_cast<uint64_t>(timeout) * 1000000;
+  uv_once(&watchdog_once, watchdog_init);
+  uv_mutex_lock(&watchdog_lock);
+  watchdog_deadlines.push_back(this);
+  m_active = true;
+  uv_cond_signal(&watchdog_cond);
+  uv_mutex_unlock(&watchdog_lock);
+}
+
+void Deadline::stop() {
+  if(m_active) {
+    uv_mutex_lock(&watchdog_lock);
+    watchdog_deadlines.remove(this);
+    while(watchdog_aborting == this) {
+      uv_cond_wait(&watchdog_aborted, &watchdog_lock);
+    }
+    m_active = false;
+    uv_mutex_unlock(&watchdog_lock);
+  }
+}
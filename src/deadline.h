@@ -0,0 +1,65 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <uv.h>
+#include <stdint.h>
+
+struct ReaderData;
+
+/* Position code of the error thrown when a card session runs past its deadline */
+static const int DEADLINE_ERROR = 0x12339;
+
+/*
+ * The deadline of the calls of one card session.
+ * While it is started, a watchdog thread aborts the transaction in flight on the reader when the deadline passes:
+ * SCardCancel on the context of the reader on PCSC, nfc_abort_command on libnfc. The guards and the raw channels
+ * restart it for every command and give up with DEADLINE_ERROR, so a card which stops answering can not stall the reader.
+ * The abort runs without the lock of the watchdog, only the session of the expired deadline waits for it.
+ */
+class Deadline {
+  public:
+    Deadline() : m_reader(NULL), m_timeout(0), m_end(0), m_active(false) {}
+
+    /* Stops the deadline */
+    ~Deadline() {
+      stop();
+    }
+
+    /* Start the deadline of a session on reader. A timeout of 0 ms never expires */
+    void start(ReaderData *reader, uint32_t timeout);
+
+    /* Start the deadline again with the timeout of the last start, for the next call of the session */
+    void restart() {
+      if(m_timeout) {
+        start(m_reader, m_timeout);
+      }
+    }
+
+    /* Stop the deadline, the watchdog forgets it */
+    void stop();
+
+    /* True if the deadline passed */
+    bool expired() const {
+      return m_end && uv_hrtime() >= m_end;
+    }
+
+    /* Called by the watchdog */
+    ReaderData *reader() const {
+      return m_reader;
+    }
+
+    /* The end in ns of uv_hrtime, 0 for none */
+    uint64_t end() const {
+      return m_end;
+    }
+
+  private:
+    ReaderData *m_reader;
+    uint32_t m_timeout;
+    uint64_t m_end;
+    bool m_active;
+};
+
+#endif // DEADLINE_H
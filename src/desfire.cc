@@ -1,89 +1,138 @@
 // Copyright 2013, Rolf Meyer
 // See LICENCE for more information
 
+#include <algorithm>
+#include <cstddef>
+
 #include "desfire.h"
+#include "addon.h"
+#include "call_watch.h"
+#include "card_cache.h"
+#include "ndef_cache.h"
+#include "transceive.h"
 #include "utils.h"
 
-v8::Local<v8::Object> DesfireCreate(ReaderData *reader, FreefareTag *tagList, FreefareTag activeTag) {
+/* Changed ranges closer than this are written with one command, a command costs about as much */
+static const uint16_t NDEF_DIFF_GAP = 8;
+
+/* Reader and UID of a card in a report of the call watch */
+static void DesfireSubject(v8::Local<v8::Object> card, std::string &reader, std::string &uid) {
+  DesfireData *data = static_cast<DesfireData *>(
+    v8::Local<v8::External>::Cast(Nan::GetPrivate(card, Nan::New("data").ToLocalChecked()).ToLocalChecked())->Value());
+  if(data) {
+    reader = data->reader->name;
+    // Known once a call needed it, the tag is not asked after a failed call
+    uid = data->uid;
+  }
+}
+
+v8::Local<v8::Object> DesfireCreate(ReaderData *reader, const TagsPtr &tagList, FreefareTag activeTag) {
   DesfireData *cardData = new DesfireData(reader, tagList);
   cardData->tag = activeTag;
   v8::Local<v8::Object> card = Nan::New<v8::Object>();
   Nan::Set(card, Nan::New("type").ToLocalChecked(), Nan::New("desfire").ToLocalChecked());
-  Nan::SetPrivate(card, Nan::New("data").ToLocalChecked(), Nan::New<v8::External>(cardData));
-
-  Nan::SetMethod(card, "info", DesfireInfo);
-  Nan::SetMethod(card, "masterKeyInfo", DesfireMasterKeyInfo);
-  Nan::SetMethod(card, "keyVersion", DesfireKeyVersion);
-  Nan::SetMethod(card, "freeMemory", DesfireFreeMemory);
-  Nan::SetMethod(card, "setKey", DesfireSetKey);
-  Nan::SetMethod(card, "setAid", DesfireSetAid);
-  Nan::SetMethod(card, "format", DesfireFormat);
-  Nan::SetMethod(card, "createNdef", DesfireCreateNdef);
-  Nan::SetMethod(card, "readNdef", DesfireReadNdef);
-  Nan::SetMethod(card, "writeNdef", DesfireWriteNdef);
-  Nan::SetMethod(card, "free", DesfireFree);
+  card_attach(card, cardData);
+
+  watch_method(card, "info", DesfireInfo, DesfireSubject, reader->addon);
+  watch_method(card, "masterKeyInfo", DesfireMasterKeyInfo, DesfireSubject, reader->addon);
+  watch_method(card, "keyVersion", DesfireKeyVersion, DesfireSubject, reader->addon);
+  watch_method(card, "freeMemory", DesfireFreeMemory, DesfireSubject, reader->addon);
+  watch_method(card, "setKey", DesfireSetKey, DesfireSubject, reader->addon);
+  watch_method(card, "setTimeout", DesfireSetTimeout, DesfireSubject, reader->addon);
+  watch_method(card, "setAid", DesfireSetAid, DesfireSubject, reader->addon);
+  watch_method(card, "format", DesfireFormat, DesfireSubject, reader->addon);
+  watch_method(card, "createNdef", DesfireCreateNdef, DesfireSubject, reader->addon);
+  watch_method(card, "readNdef", DesfireReadNdef, DesfireSubject, reader->addon);
+  watch_method(card, "writeNdef", DesfireWriteNdef, DesfireSubject, reader->addon);
+  watch_method(card, "provision", DesfireProvision, DesfireSubject, reader->addon);
+  watch_method(card, "transceive", DesfireTransceive, DesfireSubject, reader->addon);
+  watch_method(card, "transceiveMany", DesfireTransceiveMany, DesfireSubject, reader->addon);
+  watch_method(card, "free", DesfireFree, DesfireSubject, reader->addon);
   return card;
 }
 
+/* The hardware or software part of a version */
+static v8::Local<v8::Object> version_part(uint8_t vendor_id, uint8_t type, uint8_t subtype, uint8_t major, uint8_t minor, uint8_t storage_size, uint8_t protocol) {
+  v8::Local<v8::Object> part = Nan::New<v8::Object>();
+  part->Set(Nan::New("vendorId").ToLocalChecked(), Nan::New(vendor_id));
+  part->Set(Nan::New("type").ToLocalChecked(), Nan::New(type));
+  part->Set(Nan::New("subtype").ToLocalChecked(), Nan::New(subtype));
+  v8::Local<v8::Object> version = Nan::New<v8::Object>();
+  version->Set(Nan::New("major").ToLocalChecked(), Nan::New(major));
+  version->Set(Nan::New("minor").ToLocalChecked(), Nan::New(minor));
+  part->Set(Nan::New("version").ToLocalChecked(), version);
+  part->Set(Nan::New("storageSize").ToLocalChecked(), Nan::New(storage_size));
+  part->Set(Nan::New("protocol").ToLocalChecked(), Nan::New(protocol));
+  return part;
+}
+
+/* Getter of the derived fields of a version object: builds the field from the raw version once and replaces the getter by it */
+static void DesfireVersionField(v8::Local<v8::String> property, const Nan::PropertyCallbackInfo<v8::Value> &info) {
+  const struct mifare_desfire_version_info &version =
+    *reinterpret_cast<const struct mifare_desfire_version_info *>(node::Buffer::Data(info.Data()));
+  std::string name = *Nan::Utf8String(property);
+  v8::Local<v8::Object> field;
+  if(name == "hardware") {
+    field = version_part(version.hardware.vendor_id, version.hardware.type, version.hardware.subtype,
+                         version.hardware.version_major, version.hardware.version_minor,
+                         version.hardware.storage_size, version.hardware.protocol);
+  } else if(name == "software") {
+    field = version_part(version.software.vendor_id, version.software.type, version.software.subtype,
+                         version.software.version_major, version.software.version_minor,
+                         version.software.storage_size, version.software.protocol);
+  } else {
+    field = Nan::New<v8::Object>();
+    field->Set(Nan::New("week").ToLocalChecked(), Nan::New(version.production_week));
+    field->Set(Nan::New("year").ToLocalChecked(), Nan::New(version.production_year));
+  }
+  Nan::DefineOwnProperty(info.This(), property, field);
+  info.GetReturnValue().Set(field);
+}
+
+v8::Local<v8::Object> DesfireVersionObject(const struct mifare_desfire_version_info &info) {
+  // One copy of the raw version, uid and batchNumber are views into it
+  v8::Local<v8::Object> raw = Nan::CopyBuffer(reinterpret_cast<const char *>(&info), sizeof(info)).ToLocalChecked();
+  v8::Local<v8::Uint8Array> bytes = raw.As<v8::Uint8Array>();
+  size_t offset = bytes->ByteOffset();
+  v8::Isolate *isolate = v8::Isolate::GetCurrent();
+
+  v8::Local<v8::Object> card = Nan::New<v8::Object>();
+  card->Set(Nan::New("uid").ToLocalChecked(),
+            node::Buffer::New(isolate, bytes->Buffer(), offset + offsetof(struct mifare_desfire_version_info, uid), sizeof(info.uid)).ToLocalChecked());
+  card->Set(Nan::New("batchNumber").ToLocalChecked(),
+            node::Buffer::New(isolate, bytes->Buffer(), offset + offsetof(struct mifare_desfire_version_info, batch_number), sizeof(info.batch_number)).ToLocalChecked());
+  // The objects are only built if they are read
+  Nan::SetAccessor(card, Nan::New("production").ToLocalChecked(), DesfireVersionField, 0, raw);
+  Nan::SetAccessor(card, Nan::New("hardware").ToLocalChecked(), DesfireVersionField, 0, raw);
+  Nan::SetAccessor(card, Nan::New("software").ToLocalChecked(), DesfireVersionField, 0, raw);
+  return card;
+}
+
+void DesfireGetVersion(DesfireGuardTag &tag, struct mifare_desfire_version_info &info) {
+  if(card_cache_version(tag.uid(), info)) {
+    return;
+  }
+  tag.retry(0x12304, "Fetch Tag Version Info",
+            [&]()mutable->res_t{return mifare_desfire_get_version(tag, &info);});
+  card_cache_put_version(tag.uid(), info);
+}
+
 void DesfireInfo(const Nan::FunctionCallbackInfo<v8::Value> &v8info) {
   try {
-    v8::Local<v8::Object> card = Nan::New<v8::Object>();
     struct mifare_desfire_version_info info;
 
     if(v8info.Length()!=0) {
       throw errorResult(v8info, 0x12302, "This function takes no arguments");
     }
-    { // Guarded realm;
-      DesfireGuardTag tag(v8info);
-      tag.retry(0x12304, "Fetch Tag Version Info",
-                [&]()mutable->res_t{return mifare_desfire_get_version(tag, &info);});
-    }
-
-    v8::Local<v8::Array> uid = Nan::New<v8::Array>(7);
-    for(unsigned int j=0; j<7; j++) {
-      uid->Set(j, Nan::New(info.uid[j]));
-    }
-    card->Set(Nan::New("uid").ToLocalChecked(), uid);
-
-    v8::Local<v8::Array> bno = Nan::New<v8::Array>(5);
-    for(unsigned int j=0; j<5; j++) {
-      bno->Set(j, Nan::New(info.batch_number[j]));
+    { // Guarded realm, only entered if the card is not known yet
+      DesfireGuardTag tag(v8info, false);
+      if(!card_cache_version(tag.uid(), info)) {
+        tag.guard();
+        DesfireGetVersion(tag, info);
+      }
     }
-    card->Set(Nan::New("batchNumber").ToLocalChecked(), bno);
-
-    v8::Local<v8::Object> pdate = Nan::New<v8::Object>();
-    pdate->Set(Nan::New("week").ToLocalChecked(), Nan::New(info.production_week));
-    pdate->Set(Nan::New("year").ToLocalChecked(), Nan::New(info.production_year));
-    card->Set(Nan::New("production").ToLocalChecked(), pdate);
 
-    v8::Local<v8::Object> hardware = Nan::New<v8::Object>();
-    hardware->Set(Nan::New("vendorId").ToLocalChecked(), Nan::New(info.hardware.vendor_id));
-    hardware->Set(Nan::New("type").ToLocalChecked(), Nan::New(info.hardware.type));
-    hardware->Set(Nan::New("subtype").ToLocalChecked(), Nan::New(info.hardware.subtype));
-
-    v8::Local<v8::Object> hw_version = Nan::New<v8::Object>();
-    hw_version->Set(Nan::New("major").ToLocalChecked(), Nan::New(info.hardware.version_major));
-    hw_version->Set(Nan::New("minor").ToLocalChecked(), Nan::New(info.hardware.version_minor));
-    hardware->Set(Nan::New("version").ToLocalChecked(), hw_version);
-    hardware->Set(Nan::New("storageSize").ToLocalChecked(), Nan::New(info.hardware.storage_size));
-    hardware->Set(Nan::New("protocol").ToLocalChecked(), Nan::New(info.hardware.protocol));
-    card->Set(Nan::New("hardware").ToLocalChecked(), hardware);
-
-    v8::Local<v8::Object> software = Nan::New<v8::Object>();
-    software->Set(Nan::New("vendorId").ToLocalChecked(), Nan::New(info.software.vendor_id));
-    software->Set(Nan::New("type").ToLocalChecked(), Nan::New(info.software.type));
-    software->Set(Nan::New("subtype").ToLocalChecked(), Nan::New(info.software.subtype));
-
-    v8::Local<v8::Object> sw_version = Nan::New<v8::Object>();
-    sw_version->Set(Nan::New("major").ToLocalChecked(), Nan::New(info.software.version_major));
-    sw_version->Set(Nan::New("minor").ToLocalChecked(), Nan::New(info.software.version_minor));
-    software->Set(Nan::New("version").ToLocalChecked(), sw_version);
-
-    software->Set(Nan::New("storageSize").ToLocalChecked(), Nan::New(info.software.storage_size));
-    software->Set(Nan::New("protocol").ToLocalChecked(), Nan::New(info.software.protocol));
-    card->Set(Nan::New("software").ToLocalChecked(), software);
-
-    v8info.GetReturnValue().Set(card);
+    v8info.GetReturnValue().Set(DesfireVersionObject(info));
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
   }
@@ -98,9 +147,17 @@ void DesfireMasterKeyInfo(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     if(info.Length()!=0) {
       throw errorResult(info, 0x12306, "This function takes no arguments");
     }
-    DesfireGuardTag tag_guard(info);
-
-    res = mifare_desfire_get_key_settings(tag_guard, &settings, &max_keys);
+    DesfireGuardTag tag_guard(info, false);
+    if(card_cache_key_settings(tag_guard.uid(), settings, max_keys)) {
+      res = 0;
+    } else {
+      tag_guard.guard();
+      tag_guard.deadline().restart();
+      res = mifare_desfire_get_key_settings(tag_guard, &settings, &max_keys);
+      if(!res) {
+        card_cache_put_key_settings(tag_guard.uid(), settings, max_keys);
+      }
+    }
     if(!res) {
       v8::Local<v8::Object> key = Nan::New<v8::Object>();
       key->Set(Nan::New("configChangable").ToLocalChecked(), Nan::New((settings & 0x08)!=0));
@@ -154,9 +211,13 @@ void DesfireFreeMemory(const Nan::FunctionCallbackInfo<v8::Value> &info) {
       throw errorResult(info, 0x12302, "This function takes no arguments");
     }
 
-    DesfireGuardTag tag(info);
-    tag.retry(0x12309, "Free Memory",
-              [&]()mutable->res_t{return mifare_desfire_free_mem(tag, &size);});
+    DesfireGuardTag tag(info, false);
+    if(!card_cache_free_memory(tag.uid(), size)) {
+      tag.guard();
+      tag.retry(0x12309, "Free Memory",
+                [&]()mutable->res_t{return mifare_desfire_free_mem(tag, &size);});
+      card_cache_put_free_memory(tag.uid(), size);
+    }
     info.GetReturnValue().Set(Nan::New(size));
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
@@ -173,10 +234,15 @@ void DesfireSetAid(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     if(info.Length()!=1 || !info[0]->IsNumber() || Nan::To<uint32_t>(info[0]).FromJust() > 0xFFFFFF) {
       throw errorResult(info, 0x12302, "This function takes the aid as argument a number smaller than 0x1000000");
     }
+    // Replaced only after the new one exists, the card keeps a valid aid on every path
+    MifareDESFireAID aid = mifare_desfire_aid_new(Nan::To<uint32_t>(info[0]).FromJust());
+    if(!aid) {
+      throw errorResult(info, 0x12322, "Allocation of the aid failed");
+    }
     if(data->aid) {
       free(data->aid);
     }
-    data->aid = mifare_desfire_aid_new(Nan::To<uint32_t>(info[0]).FromJust());
+    data->aid = aid;
     validTrue(info);
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
@@ -185,93 +251,24 @@ void DesfireSetAid(const Nan::FunctionCallbackInfo<v8::Value> &info) {
 
 void DesfireSetKey(const Nan::FunctionCallbackInfo<v8::Value> &info) {
   try {
-    typedef MifareDESFireKey (*callback_t)(const uint8_t *);
-    callback_t callbacks[4][2] = {
-      {mifare_desfire_des_key_new, mifare_desfire_des_key_new_with_version},
-      {mifare_desfire_3des_key_new, mifare_desfire_3des_key_new_with_version},
-      {mifare_desfire_3k3des_key_new, mifare_desfire_3k3des_key_new_with_version},
-      {mifare_desfire_aes_key_new, NULL}
-    };
-
     DesfireData *data = DesfireData_from_info(info);
     if(!data) {
       throw errorResult(info, 0x12301, "Card is already free");
     }
+    data->key = key_from_args(info);
+    info.GetReturnValue().Set(info.This());
+  } catch(MifareError err) {
+    // The error is already assigned to the InfoScope
+  }
+}
 
-    uint8_t key_val[24];
-    bool version = false;
-    //uint8_t aes_ver = 0;
-    int type = 0;
-    uint32_t max_len = 8;
-    std::string error = (
-      "This function takes up to four arguments. "
-      "The first is the key an must be an array of 8, 16 or 24 bytes, depending on the type. "
-      "The second is the type a string out of (des|3des|3k3des|aes) which defines also the length of the key. "
-      "If you choose \"des\" the key is 8 numbers long. If you choose 3des or aes it is 16 numbers long. "
-      "For 3k3des it has to be 24 numbers long. it will default to \"des\"."
-      "The third is version a boolean describing wether the key is versioned. It will default to false"
-      "If you choose to use an \"aes\" key the fourth argument is the aes version a number smaller 255"
-    );
-    if(info.Length()==0 || info.Length()>4 || !info[0]->IsArray() ||
-        (info.Length()>1 && !info[1]->IsString()) ||
-        (info.Length()>2 && !info[2]->IsBoolean()) ||
-        (info.Length()>3 && !info[3]->IsUint32()) ||
-        (info.Length()>3 && Nan::To<uint32_t>(info[3]).FromJust()>255)
-      ) {
-      throw errorResult(info, 0x12302, error);
-    }
-
-    if(info.Length()>2) {
-      version = info[2]->BooleanValue();
-    }
-
-    if(info.Length()>1) {
-      v8::Local<v8::String> t = v8::Local<v8::String>::Cast(info[1]);
-      if(t->Equals(Nan::New("aes").ToLocalChecked())) {
-        type = 3;
-        max_len = 16;
-      } else if(t->Equals(Nan::New("3k3des").ToLocalChecked())) {
-        type = 2;
-        max_len = 24;
-      } else if(t->Equals(Nan::New("3des").ToLocalChecked())) {
-        type = 1;
-        max_len = 16;
-      }
-    }
-
-    //if(type == 3 && info.Length() > 3) {
-    //  aes_ver = (uint8_t)(Nan::To<uint32_t>(info[3]).FromJust()&0xFF);
-    //}
-
-    if(info[0]->IsArray()) {
-      v8::Local<v8::Array> key = v8::Local<v8::Array>::Cast(info[0]);
-      if(key->Length()!=max_len) {
-        throw errorResult(info, 0x12302, error);
-      }
-      for(uint32_t i=0; i<max_len; i++) {
-        v8::Local<v8::Value> k = key->Get(i);
-        if(!k->IsInt32()) {
-          throw errorResult(info, 0x12302, error);
-        }
-        if(Nan::To<int32_t>(k).FromJust()>255) {
-          throw errorResult(info, 0x12302, error);
-        }
-        key_val[i] = (uint8_t)(Nan::To<int32_t>(k).FromJust() & 0xFF);
-      }
-      if(data->key) {
-        mifare_desfire_key_free(data->key);
-      }
-      callback_t cb = callbacks[type][version];
-      if(cb) {
-        data->key = cb(key_val);
-      } else {
-        mifare_desfire_aes_key_new_with_version(key_val, 0);
-      }
-    }
-    for(uint32_t i = 0; i < max_len; i++) {
-      key_val[i] = 0;
+void DesfireSetTimeout(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  try {
+    DesfireData *data = DesfireData_from_info(info);
+    if(info.Length()>1 || (info.Length()==1 && !info[0]->IsUint32())) {
+      throw errorResult(info, 0x12302, "The only argument is the optional deadline of each command on the card in ms");
     }
-
+    data->timeout = info.Length()==1 ? Nan::To<uint32_t>(info[0]).FromJust() : -1;
     info.GetReturnValue().Set(info.This());
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
@@ -280,7 +277,6 @@ void DesfireSetKey(const Nan::FunctionCallbackInfo<v8::Value> &info) {
 
 void DesfireFormat(const Nan::FunctionCallbackInfo<v8::Value> &info) {
   try {
-    uint8_t key_data_picc[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
     if(info.Length()>1 || (info.Length()==1 && !info[0]->IsObject())) {
       throw errorResult(info, 0x12302, "The only argument is an options object with members: {configChangable:bool, freeCreateDelete:bool, freeDirectoryList:bool, keyChangable:bool}");
     }
@@ -306,65 +302,228 @@ void DesfireFormat(const Nan::FunctionCallbackInfo<v8::Value> &info) {
     uint8_t flags = (configChangable << 3) | (freeCreateDelete << 2) | (freeDirectoryList << 1) | (keyChangable << 0);
 
     DesfireGuardTag tag(info);
-    MifareDESFireKey key_picc = mifare_desfire_des_key_new_with_version(key_data_picc);
+    KeyPtr key_picc = key_default();
     tag.retry(0x12310, "Authenticate on Mifare DESFire target",
-              [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, key_picc);});
-    mifare_desfire_key_free(key_picc);
+              [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, *key_picc);});
     mifare_sleep();
     tag.retry(0x12311, "Change Key Settings",
               [&]()mutable->res_t{return mifare_desfire_change_key_settings(tag, flags);});
     mifare_sleep();
     tag.retry(0x12312, "Format PICC",
               [&]()mutable->res_t{return mifare_desfire_format_picc(tag);});
+    tag.data()->ndef_layout = NDEF_LAYOUT_UNKNOWN;
+    ndef_cache_drop(tag.uid());
+    card_cache_invalidate(tag.uid());
     validTrue(info);
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
   }
 }
 
+int DesfireNdefMapping(const struct mifare_desfire_version_info &cardinfo) {
+  switch(cardinfo.software.version_major) {
+  case 0:
+    return 1;
+  case 1:
+  default: // newer version? let's assume it supports latest mapping too
+    return 2;
+  }
+}
+
+MifareDESFireAID DesfireNdefAid(int mapping) {
+  // Created once and shared by all cards and threads, libfreefare only reads them
+  static MifareDESFireAID mapping1 = mifare_desfire_aid_new(0xEEEE10);
+  static MifareDESFireAID mapping2 = mifare_desfire_aid_new(0x000001);
+  return mapping == 1 ? mapping1 : mapping2;
+}
+
+uint16_t DesfireNdefMaxSize(const struct mifare_desfire_version_info &cardinfo, NdefLayout layout) {
+  uint16_t ndef_max_size = 0x0EE0;
+  if(DesfireNdefMapping(cardinfo) != 1) {
+    ndef_max_size = 0x0800;
+    uint16_t announcedsize = 1 << (cardinfo.software.storage_size >> 1);
+    if(announcedsize >= 0x1000) {
+      ndef_max_size = 0x1000;
+    }
+    if(announcedsize >= 0x1E00) {
+      ndef_max_size = 0x1E00;
+    }
+  }
+  if(layout == NDEF_LAYOUT_BACKUP) {
+    // The card keeps a mirror of a backup data file
+    ndef_max_size /= 2;
+  }
+  return ndef_max_size;
+}
+
+NdefLayout DesfireNdefLayoutOption(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> value, const char *error) {
+  if(value->IsUndefined() || value->Equals(Nan::New("std").ToLocalChecked())) {
+    return NDEF_LAYOUT_STD;
+  }
+  if(value->Equals(Nan::New("backup").ToLocalChecked())) {
+    return NDEF_LAYOUT_BACKUP;
+  }
+  throw errorResult(info, 0x12302, error);
+}
+
+NdefLayout DesfireNdefFileLayout(DesfireGuardTag &tag, uint8_t file_no) {
+  DesfireData *data = tag.data();
+  if(data->ndef_layout == NDEF_LAYOUT_UNKNOWN) {
+    struct mifare_desfire_file_settings settings;
+    tag.retry(0x12336, "Read NDEF file settings",
+              [&]()mutable->res_t{return mifare_desfire_get_file_settings(tag, file_no, &settings);});
+    data->ndef_layout = settings.file_type == MDFT_BACKUP_DATA_FILE ? NDEF_LAYOUT_BACKUP : NDEF_LAYOUT_STD;
+  }
+  return data->ndef_layout;
+}
+
+void DesfireCreateNdefFiles(DesfireGuardTag &tag, const struct mifare_desfire_version_info &cardinfo, MifareDESFireKey key_app, NdefLayout layout, uint8_t &file_no, uint16_t &ndef_max_len) {
+  uint16_t ndef_max_size = DesfireNdefMaxSize(cardinfo, layout);
+  if(DesfireNdefMapping(cardinfo) == 1) {
+    // Mifare DESFire Create Application with AID equal to EEEE10h, key settings equal to 0x09, NumOfKeys equal to 01h
+    MifareDESFireAID aid = DesfireNdefAid(1);
+    tag.retry(0x12314, "Application creation (Try format before running create if failing)",
+              [&]()mutable->res_t{return mifare_desfire_create_application(tag, aid, 0x09, 1);});
+    // Mifare DESFire SelectApplication (Select previously creates application)
+    tag.retry(0x12313, "Application selection",
+              [&]()mutable->res_t{return mifare_desfire_select_application(tag, aid);});
+
+    // Authentication with NDEF Tag Application master key (Authentication with key 0)
+    tag.retry(0x12310, "Authentication with NDEF Tag Application master key",
+              [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, key_app);});
+
+    // Mifare DESFire ChangeKeySetting with key settings equal to 00001001b
+    tag.retry(0x12311, "Change Key Settings",
+              [&]()mutable->res_t{return mifare_desfire_change_key_settings(tag, 0x09);});
+
+    // Mifare DESFire CreateStdDataFile with FileNo equal to 03h (CC File DESFire FID), ComSet equal to 00h,
+    // AccesRights equal to E000h, File Size bigger equal to 00000Fh
+    tag.retry(0x12315, "Create StDataFile",
+              [&]()mutable->res_t{return mifare_desfire_create_std_data_file(tag, 0x03, MDCM_PLAIN, 0xE000, 0x00000F);});
+
+    // Mifare DESFire WriteData to write the content of the CC File with CClEN equal to 000Fh,
+    // Mapping Version equal to 10h,MLe equal to 003Bh, MLc equal to 0034h, and NDEF File Control TLV
+    // equal to T =04h, L=06h, V=E1 04 (NDEF ISO FID=E104h) 0E E0 (NDEF File size =3808 Bytes) 00 (free read access)
+    // 00 free write access
+    uint8_t capability_container_file_content[15] = {
+      0x00, 0x0F,     // CCLEN: Size of this capability container.CCLEN values are between 000Fh and FFFEh
+      0x10,           // Mapping version
+      0x00, 0x3B,     // MLe: Maximum data size that can be read using a single ReadBinary command. MLe = 000Fh-FFFFh
+      0x00, 0x34,     // MLc: Maximum data size that can be sent using a single UpdateBinary command. MLc = 0001h-FFFFh
+      0x04, 0x06,     // T & L of NDEF File Control TLV, followed by 6 bytes of V:
+      0xE1, 0x04,     //   File Identifier of NDEF File
+      0x0E, 0xE0,     //   Maximum NDEF File size of 3808 bytes
+      0x00,           //   free read access
+      0x00            //   free write acces
+    };
+    capability_container_file_content[11] = ndef_max_size >> 8;
+    capability_container_file_content[12] = ndef_max_size & 0xFF;
+
+    tag.retry(0x12316, "Write CC file content",
+              [&]()mutable->res_t{return mifare_desfire_write_data(tag, 0x03, 0, sizeof(capability_container_file_content), capability_container_file_content);});
+
+    // Mifare DESFire CreateStdDataFile with FileNo equal to 04h (NDEF FileDESFire FID), CmmSet equal to 00h, AccessRigths
+    // equal to EEE0h, FileSize equal to 000EE0h (3808 Bytes) or a backup data file of half the size
+    if(layout == NDEF_LAYOUT_BACKUP) {
+      tag.retry(0x12337, "Create BackupDataFile",
+                [&]()mutable->res_t{return mifare_desfire_create_backup_data_file(tag, 0x04, MDCM_PLAIN, 0xEEE0, ndef_max_size);});
+    } else {
+      tag.retry(0x12317, "Create StdDataFile",
+                [&]()mutable->res_t{return mifare_desfire_create_std_data_file(tag, 0x04, MDCM_PLAIN, 0xEEE0, ndef_max_size);});
+    }
+    file_no = 0x04;
+    ndef_max_len = ndef_max_size;
+  } else {
+    // Mifare DESFire Create Application with AID equal to 000001h, key settings equal to 0x0F, NumOfKeys equal to 01h,
+    // 2 bytes File Identifiers supported, File-ID equal to E110h
+    MifareDESFireAID aid = DesfireNdefAid(2);
+    uint8_t app[] = { 0xd2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01 };
+    tag.retry(0x12314, "Application Creation",
+              [&]()mutable->res_t{return mifare_desfire_create_application_iso(tag, aid, 0x0F, 0x21, 0, 0xE110, app, sizeof(app));});
+
+    // Mifare DESFire SelectApplication (Select previously creates application)
+    tag.retry(0x12313, "Application Selection",
+              [&]()mutable->res_t{return mifare_desfire_select_application(tag, aid);});
+
+    // Authentication with NDEF Tag Application master key (Authentication with key 0)
+    tag.retry(0x12310, "Authentication with NDEF Tag Application master key",
+              [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, key_app);});
+
+    // Mifare DESFire CreateStdDataFile with FileNo equal to 01h (DESFire FID), ComSet equal to 00h,
+    // AccesRights equal to E000h, File Size bigger equal to 00000Fh, ISO File ID equal to E103h
+    tag.retry(0x12316, "Create StdDataFileIso",
+              [&]()mutable->res_t{return mifare_desfire_create_std_data_file_iso(tag, 0x01, MDCM_PLAIN, 0xE000, 0x00000F, 0xE103);});
+
+    // Mifare DESFire WriteData to write the content of the CC File with CClEN equal to 000Fh,
+    // Mapping Version equal to 20h,MLe equal to 003Bh, MLc equal to 0034h, and NDEF File Control TLV
+    // equal to T =04h, L=06h, V=E1 04 (NDEF ISO FID=E104h) 0xNNNN (NDEF File size = 0x0800/0x1000/0x1E00 bytes)
+    // 00 (free read access) 00 free write access
+    uint8_t capability_container_file_content[15] = {
+      0x00, 0x0F,     // CCLEN: Size of this capability container.CCLEN values are between 000Fh and FFFEh
+      0x20,           // Mapping version
+      0x00, 0x3B,     // MLe: Maximum data size that can be read using a single ReadBinary command. MLe = 000Fh-FFFFh
+      0x00, 0x34,     // MLc: Maximum data size that can be sent using a single UpdateBinary command. MLc = 0001h-FFFFh
+      0x04, 0x06,     // T & L of NDEF File Control TLV, followed by 6 bytes of V:
+      0xE1, 0x04,     //   File Identifier of NDEF File
+      0x04, 0x00,     //   Maximum NDEF File size of 1024 bytes
+      0x00,           //   free read access
+      0x00            //   free write acces
+    };
+
+    capability_container_file_content[11] = ndef_max_size >> 8;
+    capability_container_file_content[12] = ndef_max_size & 0xFF;
+    tag.retry(0x12317, "Write CC file content",
+              [&]()mutable->res_t{return mifare_desfire_write_data(tag, 0x01, 0, sizeof(capability_container_file_content), capability_container_file_content);});
+
+    // Mifare DESFire CreateStdDataFile with FileNo equal to 02h (DESFire FID), CmmSet equal to 00h, AccessRigths
+    // equal to EEE0h, FileSize equal to ndefmaxsize (0x000800, 0x001000 or 0x001E00) or a backup data file of half the size
+    if(layout == NDEF_LAYOUT_BACKUP) {
+      tag.retry(0x12337, "Create BackupDataFileIso",
+                [&]()mutable->res_t{return mifare_desfire_create_backup_data_file_iso(tag, 0x02, MDCM_PLAIN, 0xEEE0, ndef_max_size, 0xE104);});
+    } else {
+      tag.retry(0x12318, "Create StdDataFileIso",
+                [&]()mutable->res_t{return mifare_desfire_create_std_data_file_iso(tag, 0x02, MDCM_PLAIN, 0xEEE0, ndef_max_size, 0xE104);});
+    }
+    file_no = 0x02;
+    ndef_max_len = ndef_max_size;
+  }
+}
+
 void DesfireCreateNdef(const Nan::FunctionCallbackInfo<v8::Value> &info) {
   try {
-    uint8_t ndef_read_key[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
-    uint8_t *key_data_picc = ndef_read_key;
-    uint8_t *key_data_app = ndef_read_key;
-
-    if(info.Length()>=1) {
-      throw errorResult(info, 0x12302, "This function takes no arguments");
+    uint8_t file_no;
+    uint16_t ndef_max_len;
+    const char *error = "This function takes an optional options object: {layout:\"std\"|\"backup\"}";
+    NdefLayout layout = NDEF_LAYOUT_STD;
+    if(info.Length()>1 || (info.Length()==1 && !info[0]->IsObject())) {
+      throw errorResult(info, 0x12302, error);
+    }
+    if(info.Length()==1) {
+      layout = DesfireNdefLayoutOption(info, v8::Local<v8::Object>::Cast(info[0])->Get(Nan::New("layout").ToLocalChecked()), error);
     }
 
     DesfireGuardTag tag(info);
     struct mifare_desfire_version_info cardinfo;
-    tag.retry(0x12304, "Fetch Version Infomation",
-              [&]()mutable->res_t{return mifare_desfire_get_version(tag, &cardinfo);});
-
-    int ndef_mapping;
-    switch(cardinfo.software.version_major) {
-    case 0: {
-        ndef_mapping = 1;
-      } break;
-    case 1:
-    default: // newer version? let's assume it supports latest mapping too
-        ndef_mapping = 2;
-    }
+    DesfireGetVersion(tag, cardinfo);
+    // Key settings and free memory change below, also if a step fails
+    card_cache_invalidate(tag.uid());
 
     /* Initialised Formatting Procedure. See section 6.5.1 and 8.1 of Mifare DESFire as Type 4 Tag document*/
     // Send Mifare DESFire Select Application with AID equal to 000000h to select the PICC level
     tag.retry(0x12313, "Select Application",
               [&]()mutable->res_t{return mifare_desfire_select_application(tag, NULL);});
 
-    MifareDESFireKey key_picc;
-    MifareDESFireKey key_app;
-    key_picc = mifare_desfire_des_key_new_with_version(key_data_picc);
-    key_app = mifare_desfire_des_key_new_with_version(key_data_app);
+    KeyPtr key_picc = key_default();
+    KeyPtr key_app = key_default();
 
     // Authentication with PICC master key MAY be needed to issue ChangeKeySettings command
     tag.retry(0x12310, "Authentication with PICC master key",
-              [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, key_picc);});
+              [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, *key_picc);});
 
-    MifareDESFireAID aid;
-    if(ndef_mapping == 1) {
+    if(DesfireNdefMapping(cardinfo) == 1) {
       uint8_t key_settings;
       uint8_t max_keys;
+      tag.deadline().restart();
       mifare_desfire_get_key_settings(tag, &key_settings, &max_keys);
       if((key_settings & 0x08) == 0x08) {
 
@@ -377,110 +536,11 @@ void DesfireCreateNdef(const Nan::FunctionCallbackInfo<v8::Value> &info) {
         tag.retry(0x12311, "Change Key Settings",
                   [&]()mutable->res_t{return mifare_desfire_change_key_settings(tag, 0x09);});
       }
-
-      // Mifare DESFire Create Application with AID equal to EEEE10h, key settings equal to 0x09, NumOfKeys equal to 01h
-      aid = mifare_desfire_aid_new(0xEEEE10);
-      tag.retry(0x12314, "Application creation (Try format before running create if failing)",
-                [&]()mutable->res_t{return mifare_desfire_create_application(tag, aid, 0x09, 1);});
-      // Mifare DESFire SelectApplication (Select previously creates application)
-      tag.retry(0x12313, "Application selection",
-                [&]()mutable->res_t{return mifare_desfire_select_application(tag, aid);});
-      free(aid);
-
-      // Authentication with NDEF Tag Application master key (Authentication with key 0)
-      tag.retry(0x12310, "Authentication with NDEF Tag Application master key",
-                [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, key_app);});
-
-      // Mifare DESFire ChangeKeySetting with key settings equal to 00001001b
-      tag.retry(0x12311, "Change Key Settings",
-                [&]()mutable->res_t{return mifare_desfire_change_key_settings(tag, 0x09);});
-
-      // Mifare DESFire CreateStdDataFile with FileNo equal to 03h (CC File DESFire FID), ComSet equal to 00h,
-      // AccesRights equal to E000h, File Size bigger equal to 00000Fh
-      tag.retry(0x12315, "Create StDataFile",
-                [&]()mutable->res_t{return mifare_desfire_create_std_data_file(tag, 0x03, MDCM_PLAIN, 0xE000, 0x00000F);});
-
-      // Mifare DESFire WriteData to write the content of the CC File with CClEN equal to 000Fh,
-      // Mapping Version equal to 10h,MLe equal to 003Bh, MLc equal to 0034h, and NDEF File Control TLV
-      // equal to T =04h, L=06h, V=E1 04 (NDEF ISO FID=E104h) 0E E0 (NDEF File size =3808 Bytes) 00 (free read access)
-      // 00 free write access
-      uint8_t capability_container_file_content[15] = {
-        0x00, 0x0F,     // CCLEN: Size of this capability container.CCLEN values are between 000Fh and FFFEh
-        0x10,           // Mapping version
-        0x00, 0x3B,     // MLe: Maximum data size that can be read using a single ReadBinary command. MLe = 000Fh-FFFFh
-        0x00, 0x34,     // MLc: Maximum data size that can be sent using a single UpdateBinary command. MLc = 0001h-FFFFh
-        0x04, 0x06,     // T & L of NDEF File Control TLV, followed by 6 bytes of V:
-        0xE1, 0x04,     //   File Identifier of NDEF File
-        0x0E, 0xE0,     //   Maximum NDEF File size of 3808 bytes
-        0x00,           //   free read access
-        0x00            //   free write acces
-      };
-
-      tag.retry(0x12316, "Write CC file content",
-                [&]()mutable->res_t{return mifare_desfire_write_data(tag, 0x03, 0, sizeof(capability_container_file_content), capability_container_file_content);});
-
-      // Mifare DESFire CreateStdDataFile with FileNo equal to 04h (NDEF FileDESFire FID), CmmSet equal to 00h, AccessRigths
-      // equal to EEE0h, FileSize equal to 000EE0h (3808 Bytes)
-      tag.retry(0x12317, "Create StdDataFile",
-                [&]()mutable->res_t{return mifare_desfire_create_std_data_file(tag, 0x04, MDCM_PLAIN, 0xEEE0, 0x000EE0);});
-    } else if(ndef_mapping == 2) {
-      // Mifare DESFire Create Application with AID equal to 000001h, key settings equal to 0x0F, NumOfKeys equal to 01h,
-      // 2 bytes File Identifiers supported, File-ID equal to E110h
-      aid = mifare_desfire_aid_new(0x000001);
-      uint8_t app[] = { 0xd2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01 };
-      tag.retry(0x12314, "Application Creation",
-                [&]()mutable->res_t{return mifare_desfire_create_application_iso(tag, aid, 0x0F, 0x21, 0, 0xE110, app, sizeof(app));});
-
-      // Mifare DESFire SelectApplication (Select previously creates application)
-      tag.retry(0x12313, "Application Selection",
-                [&]()mutable->res_t{return mifare_desfire_select_application(tag, aid);});
-      free(aid);
-
-      // Authentication with NDEF Tag Application master key (Authentication with key 0)
-      tag.retry(0x12310, "Authentication with NDEF Tag Application master key",
-                [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, key_app);});
-
-      // Mifare DESFire CreateStdDataFile with FileNo equal to 01h (DESFire FID), ComSet equal to 00h,
-      // AccesRights equal to E000h, File Size bigger equal to 00000Fh, ISO File ID equal to E103h
-      tag.retry(0x12316, "Create StdDataFileIso",
-                [&]()mutable->res_t{return mifare_desfire_create_std_data_file_iso(tag, 0x01, MDCM_PLAIN, 0xE000, 0x00000F, 0xE103);});
-
-      // Mifare DESFire WriteData to write the content of the CC File with CClEN equal to 000Fh,
-      // Mapping Version equal to 20h,MLe equal to 003Bh, MLc equal to 0034h, and NDEF File Control TLV
-      // equal to T =04h, L=06h, V=E1 04 (NDEF ISO FID=E104h) 0xNNNN (NDEF File size = 0x0800/0x1000/0x1E00 bytes)
-      // 00 (free read access) 00 free write access
-      uint8_t capability_container_file_content[15] = {
-        0x00, 0x0F,     // CCLEN: Size of this capability container.CCLEN values are between 000Fh and FFFEh
-        0x20,           // Mapping version
-        0x00, 0x3B,     // MLe: Maximum data size that can be read using a single ReadBinary command. MLe = 000Fh-FFFFh
-        0x00, 0x34,     // MLc: Maximum data size that can be sent using a single UpdateBinary command. MLc = 0001h-FFFFh
-        0x04, 0x06,     // T & L of NDEF File Control TLV, followed by 6 bytes of V:
-        0xE1, 0x04,     //   File Identifier of NDEF File
-        0x04, 0x00,     //   Maximum NDEF File size of 1024 bytes
-        0x00,           //   free read access
-        0x00            //   free write acces
-      };
-
-      uint16_t ndef_max_size = 0x0800;
-      uint16_t announcedsize = 1 << (cardinfo.software.storage_size >> 1);
-      if(announcedsize >= 0x1000) {
-        ndef_max_size = 0x1000;
-      }
-      if(announcedsize >= 0x1E00) {
-        ndef_max_size = 0x1E00;
-      }
-      capability_container_file_content[11] = ndef_max_size >> 8;
-      capability_container_file_content[12] = ndef_max_size & 0xFF;
-      tag.retry(0x12317, "Write CC file content",
-                [&]()mutable->res_t{return mifare_desfire_write_data(tag, 0x01, 0, sizeof(capability_container_file_content), capability_container_file_content);});
-
-      // Mifare DESFire CreateStdDataFile with FileNo equal to 02h (DESFire FID), CmmSet equal to 00h, AccessRigths
-      // equal to EEE0h, FileSize equal to ndefmaxsize (0x000800, 0x001000 or 0x001E00)
-      tag.retry(0x12318, "Create StdDataFileIso",
-                [&]()mutable->res_t{return mifare_desfire_create_std_data_file_iso(tag, 0x02, MDCM_PLAIN, 0xEEE0, ndef_max_size, 0xE104);});
     }
-    mifare_desfire_key_free(key_picc);
-    mifare_desfire_key_free(key_app);
+    DesfireCreateNdefFiles(tag, cardinfo, *key_app, layout, file_no, ndef_max_len);
+    tag.data()->ndef_layout = layout;
+    // The new NDEF file is empty
+    ndef_cache_put(tag.uid(), NULL, 0);
 
     validTrue(info);
   } catch(MifareError err) {
@@ -488,32 +548,26 @@ void DesfireCreateNdef(const Nan::FunctionCallbackInfo<v8::Value> &info) {
   }
 }
 
-
-
-int DesfireReadNdefTVL(const Nan::FunctionCallbackInfo<v8::Value> &v8info, DesfireGuardTag &tag, uint8_t &file_no, uint16_t &ndef_max_len, MifareDESFireKey key_app) {
-  int version;
-  res_t res;
-  uint8_t *cc_data;
+int DesfireReadNdefTVL(DesfireGuardTag &tag, uint8_t &file_no, uint16_t &ndef_max_len, MifareDESFireKey key_app) {
   // #### Get Version
   // We've to track DESFire version as NDEF mapping is different
   struct mifare_desfire_version_info info;
-  tag.retry(0x12304, "Fetch Tag Version Info",
-            [&]()mutable->res_t{return mifare_desfire_get_version(tag, &info);});
-  version = info.software.version_major;
+  DesfireGetVersion(tag, info);
+  return DesfireReadNdefTVL(tag, info, file_no, ndef_max_len, key_app);
+}
+
+int DesfireReadNdefTVL(DesfireGuardTag &tag, const struct mifare_desfire_version_info &info, uint8_t &file_no, uint16_t &ndef_max_len, MifareDESFireKey key_app) {
+  int version = info.software.version_major;
+  res_t res;
+  uint8_t *cc_data;
 
   // ### Select app
   // Mifare DESFire SelectApplication (Select application)
-  MifareDESFireAID aid;
-  if(version == 0) {
-      aid = mifare_desfire_aid_new(0xEEEE10);
-  } else {
-      // There is no more relationship between DESFire AID and ISO AID...
-      // Let's assume it's in AID 000001h as proposed in the spec
-      aid = mifare_desfire_aid_new(0x000001);
-  }
+  // There is no more relationship between DESFire AID and ISO AID...
+  // Let's assume it's in AID 000001h as proposed in the spec
+  MifareDESFireAID aid = DesfireNdefAid(version == 0 ? 1 : 2);
   tag.retry(0x12313, "Application selection (NDEF application)",
             [&]()mutable->res_t{return mifare_desfire_select_application(tag, aid);});
-  free(aid);
 
   // ### Authentication
   // NDEF Tag Application master key (Authentication with key 0)
@@ -533,15 +587,14 @@ int DesfireReadNdefTVL(const Nan::FunctionCallbackInfo<v8::Value> &v8info, Desfi
                         }});
 
   if(res > 2) {
-    throw errorResult(v8info, 0x12320, "Reading the ndef capability container file length to long");
+    throw tag.fail(0x12320, "Reading the ndef capability container file length to long");
   }
   uint32_t cclen = (((uint16_t)lendata[0]) << 8) + ((uint16_t)lendata[1]);
   if(cclen < 15) {
-    throw errorResult(v8info, 0x12321, "The read ndef capability container file (E103) is to short");
-  }
-  if(!(cc_data = new uint8_t[cclen + 20])) { // cf FIXME in mifare_desfire.c read_data()
-    throw errorResult(v8info, 0x12322, "Allocation of ndef capability container file (E103) failed");
+    throw tag.fail(0x12321, "The read ndef capability container file (E103) is to short");
   }
+  // Released with the session, also when a command below throws
+  cc_data = tag.scratch(cclen + 20, 0x12322, "Allocation of ndef capability container file (E103) failed"); // cf FIXME in mifare_desfire.c read_data()
   res = tag.retry(0x12320, "Reading the ndef capability container file",
                   [&]()mutable->res_t{if(version == 0) {
                           return mifare_desfire_read_data(tag, 0x03, 0, cclen, cc_data);
@@ -555,10 +608,10 @@ int DesfireReadNdefTVL(const Nan::FunctionCallbackInfo<v8::Value> &v8info, Desfi
   }
 
   if(off + 7 >= cclen) {
-    throw errorResult(v8info, 0x12323, "We've reached the end of the ndef capability container file (E103) and did not find the ndef TLV");
+    throw tag.fail(0x12323, "We've reached the end of the ndef capability container file (E103) and did not find the ndef TLV");
   }
   if(cc_data[off + 2] != 0xE1) {
-    throw errorResult(v8info, 0x12324, "Found unknown ndef file reference");
+    throw tag.fail(0x12324, "Found unknown ndef file reference");
   }
 
   // ### Get file
@@ -571,95 +624,496 @@ int DesfireReadNdefTVL(const Nan::FunctionCallbackInfo<v8::Value> &v8info, Desfi
   }
   // Swap endianess
   ndef_max_len = (((uint16_t)cc_data[off + 4]) << 8) + ((uint16_t)cc_data[off + 5]);
-  delete [] cc_data;
   return 0;
 }
 
+void DesfireReadNdefFile(DesfireGuardTag &tag, uint8_t file_no, uint16_t ndef_max_len, std::vector<uint8_t> &ndef_msg) {
+  res_t res;
+  uint16_t ndef_msg_len;
+  uint8_t lendata[20]; // cf FIXME in mifare_desfire.c read_data()
+  tag.retry(0x12326, "Reading of NDEF file",
+            [&]()mutable->res_t{return mifare_desfire_read_data(tag, file_no, 0, 2, lendata);});
+  ndef_msg_len = (((uint16_t)lendata[0]) << 8) + ((uint16_t)lendata[1]); // uint16_t endianess swap
+  if(ndef_msg_len + 2 > ndef_max_len) {
+    throw tag.fail(0x12327, "Declared ndef size larger than max ndef size");
+  }
+  if(ndef_msg_len == 0) {
+    throw tag.fail(0x12332, "Declared ndef size is zero last write was faulty");
+  }
+  ndef_msg.resize(ndef_msg_len + 20); // cf FIXME in mifare_desfire.c read_data()
+  res = tag.retry(0x12326, "Reading NDEF message faild",
+                  [&]()mutable->res_t{return mifare_desfire_read_data(tag, file_no, 2, ndef_msg_len, ndef_msg.data());});
+  if(res != ndef_msg_len){
+    throw tag.fail(0x12329, "Reading full ndef message failed");
+  }
+  ndef_msg.resize(ndef_msg_len);
+  ndef_cache_put(tag.uid(), ndef_msg.data(), ndef_msg_len);
+}
+
+/* Send an ISO 7816-4 APDU. Returns the status word, which is stripped, or -1 if the card did not answer */
+static int iso_status(RawChannel &channel, const uint8_t *apdu, size_t apdu_len, uint8_t *response, size_t &response_len) {
+  if(channel.transmit(apdu, apdu_len, response, response_len) < 0 || response_len < 2) {
+    return -1;
+  }
+  response_len -= 2;
+  return (((int)response[response_len]) << 8) + response[response_len + 1];
+}
+
+/* Send an ISO 7816-4 APDU. Returns false unless the status word is 90 00, the status word is stripped */
+static bool iso_command(RawChannel &channel, const uint8_t *apdu, size_t apdu_len, uint8_t *response, size_t &response_len) {
+  return iso_status(channel, apdu, apdu_len, response, response_len) == 0x9000;
+}
+
+/* SELECT of an EF by its file identifier */
+static bool iso_select_file(RawChannel &channel, const uint8_t *file_id) {
+  uint8_t apdu[] = {0x00, 0xA4, 0x00, 0x0C, 0x02, file_id[0], file_id[1]};
+  uint8_t response[TRANSCEIVE_MAX_RESPONSE];
+  size_t response_len = sizeof(response);
+  return iso_command(channel, apdu, sizeof(apdu), response, response_len);
+}
+
+/* READ BINARY of length bytes (at most 256) at offset of the selected EF */
+static bool iso_read_binary(RawChannel &channel, uint16_t offset, uint16_t length, uint8_t *data, size_t &data_len) {
+  uint8_t apdu[] = {0x00, 0xB0, static_cast<uint8_t>(offset >> 8), static_cast<uint8_t>(offset), static_cast<uint8_t>(length)};
+  uint8_t response[TRANSCEIVE_MAX_RESPONSE];
+  size_t response_len = sizeof(response);
+  if(!iso_command(channel, apdu, sizeof(apdu), response, response_len) || response_len > length) {
+    return false;
+  }
+  memcpy(data, response, response_len);
+  data_len = response_len;
+  return true;
+}
+
+/* Outcome of iso_read_ndef */
+enum IsoNdefRead {
+  // The message was read
+  ISO_NDEF_READ,
+  // The card answered without an NDEF free to read over ISO: no NDEF Tag Application or no free NDEF file in the CC
+  ISO_NDEF_NONE,
+  // The card did not answer or gave an unexpected answer, the next read tries ISO again
+  ISO_NDEF_FAILED
+};
+
+/* The ISO 7816-4 read of DesfireReadNdefIso without the lookup in the card cache */
+static IsoNdefRead iso_read_ndef(DesfireGuardTag &tag, std::vector<uint8_t> &ndef_msg, uint16_t &ndef_max_len) {
+  // NDEF Tag Application of mapping version 2 and 1
+  static const uint8_t ndef_apps[2][14] = {
+    {0x00, 0xA4, 0x04, 0x00, 0x07, 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01, 0x00},
+    {0x00, 0xA4, 0x04, 0x00, 0x07, 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x00}
+  };
+  static const uint8_t cc_file[] = {0xE1, 0x03};
+  RawChannel channel(tag.reader(), &tag.deadline());
+  if(channel.open() < 0) {
+    return ISO_NDEF_FAILED;
+  }
+  uint8_t response[TRANSCEIVE_MAX_RESPONSE];
+  size_t response_len = sizeof(response);
+  int status = iso_status(channel, ndef_apps[0], 13, response, response_len);
+  if(status >= 0 && status != 0x9000) {
+    response_len = sizeof(response);
+    status = iso_status(channel, ndef_apps[1], 12, response, response_len);
+  }
+  if(status < 0) {
+    return ISO_NDEF_FAILED;
+  } else if(status != 0x9000) {
+    // No NDEF Tag Application with an ISO DF name
+    return ISO_NDEF_NONE;
+  }
+
+  // Capability Container: CCLEN, mapping version, MLe, MLc and the NDEF File Control TLV
+  uint8_t cc[15];
+  size_t cc_len = 0;
+  if(!iso_select_file(channel, cc_file) || !iso_read_binary(channel, 0, sizeof(cc), cc, cc_len) || cc_len < sizeof(cc)) {
+    return ISO_NDEF_FAILED;
+  }
+  uint16_t max_le = (((uint16_t)cc[3]) << 8) + ((uint16_t)cc[4]);
+  if(cc[7] != 0x04 || cc[8] < 6 || cc[13] != 0x00 || max_le == 0) {
+    // No NDEF file or not free to read, the native path authenticates
+    return ISO_NDEF_NONE;
+  }
+  ndef_max_len = (((uint16_t)cc[11]) << 8) + ((uint16_t)cc[12]);
+  uint16_t chunk = std::min<uint16_t>(max_le, 256);
+
+  // NLEN and the start of the message in one READ BINARY
+  if(!iso_select_file(channel, &cc[9]) || !iso_read_binary(channel, 0, std::min(chunk, ndef_max_len), response, response_len) || response_len < 2) {
+    return ISO_NDEF_FAILED;
+  }
+  uint16_t ndef_msg_len = (((uint16_t)response[0]) << 8) + ((uint16_t)response[1]);
+  if(ndef_msg_len + 2 > ndef_max_len) {
+    throw tag.fail(0x12327, "Declared ndef size larger than max ndef size");
+  }
+  if(ndef_msg_len == 0) {
+    throw tag.fail(0x12332, "Declared ndef size is zero last write was faulty");
+  }
+  ndef_msg.assign(response + 2, response + std::min<size_t>(response_len, ndef_msg_len + 2));
+  while(ndef_msg.size() < ndef_msg_len) {
+    uint16_t offset = ndef_msg.size() + 2;
+    if(!iso_read_binary(channel, offset, std::min<uint16_t>(chunk, ndef_msg_len - ndef_msg.size()), response, response_len) || response_len == 0) {
+      throw tag.fail(0x12329, "Reading full ndef message failed");
+    }
+    ndef_msg.insert(ndef_msg.end(), response, response + response_len);
+  }
+  ndef_cache_put(tag.uid(), ndef_msg.data(), ndef_msg_len);
+  return ISO_NDEF_READ;
+}
+
+bool DesfireReadNdefIso(DesfireGuardTag &tag, std::vector<uint8_t> &ndef_msg, uint16_t &ndef_max_len) {
+  const std::string &uid = tag.uid();
+  bool readable;
+  struct mifare_desfire_version_info version;
+  if(card_cache_iso_ndef(uid, readable) && !readable) {
+    // Fell back to the native commands before
+    return false;
+  }
+  if(card_cache_version(uid, version) && DesfireNdefMapping(version) == 1) {
+    // Cards of mapping version 1 get their NDEF application without ISO DF name, see DesfireCreateNdefFiles
+    card_cache_put_iso_ndef(uid, false);
+    return false;
+  }
+  switch(iso_read_ndef(tag, ndef_msg, ndef_max_len)) {
+    case ISO_NDEF_READ:
+      card_cache_put_iso_ndef(uid, true);
+      return true;
+    case ISO_NDEF_NONE:
+      // Only an answer of the card rules out ISO for the next reads
+      card_cache_put_iso_ndef(uid, false);
+      return false;
+    default:
+      if(tag.deadline().expired()) {
+        // The last command ran past its deadline
+        throw tag.fail(DEADLINE_ERROR, "Deadline exceeded", 0, "ISO 7816-4 read of the NDEF file");
+      }
+      // A transport failure says nothing about the card, the native commands try this time
+      return false;
+  }
+}
+
 void DesfireReadNdef(const Nan::FunctionCallbackInfo<v8::Value> &info) {
   try {
-    res_t res;
     uint8_t file_no;
     uint16_t ndef_msg_len_max;
-    uint16_t ndef_msg_len;
-    uint8_t *ndef_msg;
-    uint8_t ndef_read_key[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
     if(info.Length()!=0) {
       throw errorResult(info, 0x12302, "This function does not take any arguments");
     }
     DesfireGuardTag tag(info);
-    MifareDESFireKey key_app;
-    key_app = mifare_desfire_des_key_new_with_version(ndef_read_key);
-    res = DesfireReadNdefTVL(info, tag, file_no, ndef_msg_len_max, key_app);
-    mifare_desfire_key_free(key_app);
-    if(!(ndef_msg = new uint8_t[ndef_msg_len_max + 20])) { // cf FIXME in mifare_desfire.c read_data()
-      throw errorResult(info, 0x12325, "Allocation of ndef file failed");
-    }
-    uint8_t lendata[20]; // cf FIXME in mifare_desfire.c read_data()
-    tag.retry(0x12326, "Reading of NDEF file",
-              [&]()mutable->res_t{return mifare_desfire_read_data(tag, file_no, 0, 2, lendata);});
-    ndef_msg_len = (((uint16_t)lendata[0]) << 8) + ((uint16_t)lendata[1]); // uint16_t endianess swap
-    if(ndef_msg_len + 2 > ndef_msg_len_max) {
-      throw errorResult(info, 0x12327, "Declared ndef size larger than max ndef size");
-    }
-    if(ndef_msg_len == 0) {
-      throw errorResult(info, 0x12332, "Declared ndef size is zero last write was faulty");
-    }
-    res = tag.retry(0x12326, "Reading NDEF message faild",
-                    [&]()mutable->res_t{return mifare_desfire_read_data(tag, file_no, 2, ndef_msg_len, ndef_msg);});
-    if(res != ndef_msg_len){
-      throw errorResult(info, 0x12329, "Reading full ndef message failed");
-    }
-    v8::Local<v8::Object> result = buffer(ndef_msg, ndef_msg_len);
-    result->Set(Nan::New("maxLength").ToLocalChecked(), Nan::New(ndef_msg_len_max));
-    if(ndef_msg) {
-      delete [] ndef_msg;
+    std::vector<uint8_t> &ndef_msg = tag.message();
+    if(!DesfireReadNdefIso(tag, ndef_msg, ndef_msg_len_max)) {
+      DesfireReadNdefTVL(tag, file_no, ndef_msg_len_max, *key_default());
+      DesfireReadNdefFile(tag, file_no, ndef_msg_len_max, ndef_msg);
     }
+    v8::Local<v8::Object> result = buffer(ndef_msg.data(), ndef_msg.size());
+    result->Set(Nan::New("maxLength").ToLocalChecked(), Nan::New(ndef_msg_len_max));
     validResult(info, result);
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
   }
 }
 
+void DesfireWriteNdefFile(DesfireGuardTag &tag, uint8_t file_no, uint16_t ndef_max_len, uint8_t *ndef_msg, uint16_t ndef_msg_len, NdefLayout layout, bool blank) {
+  res_t res;
+  uint16_t ndef_msg_len_zero = 0;
+  uint8_t  ndef_msg_len_bigendian[2];
+  if(ndef_msg_len + 2 > ndef_max_len) {
+    throw tag.fail(0x12327, "Supplied NDEF larger than max NDEF size");
+  }
+
+  ndef_msg_len_bigendian[0] = (uint8_t)((ndef_msg_len) >> 8);
+  ndef_msg_len_bigendian[1] = (uint8_t)(ndef_msg_len);
+  if(layout == NDEF_LAYOUT_BACKUP) {
+    // The card only shows the new content after the commit: NLEN and message are written with one write
+    // and a torn write leaves the old message in place
+    size_t file_len = ndef_msg_len + 2;
+    uint8_t *file = tag.scratch(file_len, 0x12330, "Write NDEF message");
+    file[0] = ndef_msg_len_bigendian[0];
+    file[1] = ndef_msg_len_bigendian[1];
+    if(ndef_msg_len) {
+      memcpy(&file[2], ndef_msg, ndef_msg_len);
+    }
+    res = tag.retry(0x12330, "Write NDEF message",
+                    [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 0, file_len, file);});
+    if(res != static_cast<res_t>(file_len)) {
+      throw tag.fail(0x12329, "Writing full ndef message failed");
+    }
+    tag.retry(0x12338, "Commit NDEF message",
+              [&]()mutable->res_t{return mifare_desfire_commit_transaction(tag);});
+    return;
+  }
+  //Mifare DESFire WriteData to write the content of the NDEF File with NLEN equal to NDEF Message length and NDEF Message
+  // A freshly created file is all zero, the size is already invalid until the real size is written
+  if(!blank) {
+    tag.retry(0x12328, "Write NDEF message size (zero)",
+              [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 0, 2, (uint8_t*)&ndef_msg_len_zero);});
+  }
+  res = tag.retry(0x12330, "Write NDEF message",
+                  [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 2, ndef_msg_len, ndef_msg);});
+  if(res != ndef_msg_len) {
+    throw tag.fail(0x12329, "Writing full ndef message failed");
+  }
+  tag.retry(0x12331, "Write ndef message size (real)",
+            [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 0, 2, ndef_msg_len_bigendian);});
+}
+
+void DesfireWriteNdefDiff(DesfireGuardTag &tag, uint8_t file_no, uint16_t ndef_max_len, uint8_t *ndef_msg, uint16_t ndef_msg_len, NdefLayout layout, const std::vector<uint8_t> &previous) {
+  res_t res;
+  uint16_t ndef_msg_len_zero = 0;
+  uint8_t  ndef_msg_len_bigendian[2];
+  if(ndef_msg_len + 2 > ndef_max_len) {
+    throw tag.fail(0x12327, "Supplied NDEF larger than max NDEF size");
+  }
+
+  // Changed byte ranges of the message as [begin, end) pairs, bytes behind the old message are changed
+  std::vector<std::pair<uint16_t, uint16_t> > ranges;
+  for(uint16_t i = 0; i < ndef_msg_len; ++i) {
+    if(i < previous.size() && previous[i] == ndef_msg[i]) {
+      continue;
+    }
+    if(!ranges.empty() && i - ranges.back().second <= NDEF_DIFF_GAP) {
+      ranges.back().second = i + 1;
+    } else {
+      ranges.push_back(std::make_pair(i, i + 1));
+    }
+  }
+  bool len_changed = previous.size() != ndef_msg_len;
+  if(ranges.empty() && !len_changed) {
+    return;
+  }
+
+  ndef_msg_len_bigendian[0] = (uint8_t)((ndef_msg_len) >> 8);
+  ndef_msg_len_bigendian[1] = (uint8_t)(ndef_msg_len);
+  // The standard file keeps the protocol of the full write: NLEN is invalid while the message changes.
+  // A backup file only changes on commit
+  if(layout != NDEF_LAYOUT_BACKUP && !ranges.empty()) {
+    tag.retry(0x12328, "Write NDEF message size (zero)",
+              [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 0, 2, (uint8_t*)&ndef_msg_len_zero);});
+    len_changed = true;
+  }
+  for(std::vector<std::pair<uint16_t, uint16_t> >::const_iterator r = ranges.begin(); r != ranges.end(); ++r) {
+    uint16_t offset = r->first;
+    uint16_t length = r->second - r->first;
+    res = tag.retry(0x12330, "Write NDEF message",
+                    [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 2 + offset, length, ndef_msg + offset);});
+    if(res != length) {
+      throw tag.fail(0x12329, "Writing full ndef message failed");
+    }
+  }
+  if(len_changed) {
+    tag.retry(0x12331, "Write ndef message size (real)",
+              [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 0, 2, ndef_msg_len_bigendian);});
+  }
+  if(layout == NDEF_LAYOUT_BACKUP) {
+    tag.retry(0x12338, "Commit NDEF message",
+              [&]()mutable->res_t{return mifare_desfire_commit_transaction(tag);});
+  }
+}
+
 void DesfireWriteNdef(const Nan::FunctionCallbackInfo<v8::Value> &info) {
   try {
-    res_t res;
     uint8_t file_no;
-    uint8_t  ndef_read_key[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
     uint16_t ndef_msg_len;
-    uint16_t ndef_msg_len_zero = 0;
     uint16_t ndef_msg_len_max;
-    uint8_t  ndef_msg_len_bigendian[2];
     uint8_t *ndef_msg;
-    v8::Local<v8::Object> result = Nan::New<v8::Object>();
-    if(info.Length()!=1 || !node::Buffer::HasInstance(info[0])) {
-      throw errorResult(info, 0x12302, "This function takes a buffer to write to a tag");
+    bool diff = false;
+    if(info.Length()<1 || info.Length()>2 || !node::Buffer::HasInstance(info[0]) || (info.Length()==2 && !info[1]->IsObject())) {
+      throw errorResult(info, 0x12302, "This function takes a buffer to write to a tag and an optional options object: {diff:bool}");
+    }
+    if(info.Length()==2) {
+      diff = v8::Local<v8::Object>::Cast(info[1])->Get(Nan::New("diff").ToLocalChecked())->IsTrue();
     }
     ndef_msg_len = node::Buffer::Length(info[0]);
     ndef_msg = reinterpret_cast<uint8_t *>(node::Buffer::Data(info[0]));
     DesfireGuardTag tag(info);
 
-    MifareDESFireKey key_app;
-    key_app = mifare_desfire_des_key_new_with_version(ndef_read_key);
+    DesfireReadNdefTVL(tag, file_no, ndef_msg_len_max, *key_default());
+    NdefLayout layout = DesfireNdefFileLayout(tag, file_no);
+    const std::string &uid = tag.uid();
+    // Like all writes, the key settings and the free memory are read from the card again
+    card_cache_invalidate(uid);
+    std::vector<uint8_t> previous;
+    try {
+      if(diff && ndef_cache_get(uid, previous)) {
+        DesfireWriteNdefDiff(tag, file_no, ndef_msg_len_max, ndef_msg, ndef_msg_len, layout, previous);
+      } else {
+        DesfireWriteNdefFile(tag, file_no, ndef_msg_len_max, ndef_msg, ndef_msg_len, layout, false);
+      }
+    } catch(MifareError err) {
+      // The content on the card is unknown now
+      ndef_cache_drop(uid);
+      throw;
+    }
+    ndef_cache_put(uid, ndef_msg, ndef_msg_len);
+    validTrue(info);
+  } catch(MifareError err) {
+    // The error is already assigned to the InfoScope
+  }
+}
 
-    DesfireReadNdefTVL(info, tag, file_no, ndef_msg_len_max, key_app);
-    result->Set(Nan::New("maxLength").ToLocalChecked(), Nan::New(ndef_msg_len_max));
-    if(ndef_msg_len > ndef_msg_len_max) {
-      throw errorResult(info, 0x12327, "Supplied NDEF larger than max NDEF size");
+void DesfireProvisionOptions(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> value, DesfireProvisionSpec &spec) {
+  const char *error = "The provision options are an object with members: {piccKey:key, appKey:key, ndef:Buffer, layout:\"std\"|\"backup\"}";
+  if(!value->IsObject()) {
+    throw errorResult(info, 0x12302, error);
+  }
+  v8::Local<v8::Object> options = v8::Local<v8::Object>::Cast(value);
+  v8::Local<v8::Value> picc = options->Get(Nan::New("piccKey").ToLocalChecked());
+  v8::Local<v8::Value> app = options->Get(Nan::New("appKey").ToLocalChecked());
+  v8::Local<v8::Value> ndef = options->Get(Nan::New("ndef").ToLocalChecked());
+  v8::Local<v8::Value> layout = options->Get(Nan::New("layout").ToLocalChecked());
+  spec.picc = picc->IsUndefined() ? key_default() : key_from_value(info, picc, 0x12302);
+  spec.app = app->IsUndefined() ? key_default() : key_from_value(info, app, 0x12302);
+  spec.write_ndef = !ndef->IsUndefined();
+  if(spec.write_ndef) {
+    if(!node::Buffer::HasInstance(ndef) || node::Buffer::Length(ndef) > 0xFFFF) {
+      throw errorResult(info, 0x12302, error);
     }
+    uint8_t *data = reinterpret_cast<uint8_t *>(node::Buffer::Data(ndef));
+    spec.ndef.assign(data, data + node::Buffer::Length(ndef));
+  }
+  spec.layout = DesfireNdefLayoutOption(info, layout, error);
+}
 
-    ndef_msg_len_bigendian[0] = (uint8_t)((ndef_msg_len) >> 8);
-    ndef_msg_len_bigendian[1] = (uint8_t)(ndef_msg_len);
-    //Mifare DESFire WriteData to write the content of the NDEF File with NLEN equal to NDEF Message length and NDEF Message
-    tag.retry(0x12328, "Write NDEF message size (zero)",
-              [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 0, 2, (uint8_t*)&ndef_msg_len_zero);});
-    res = tag.retry(0x12330, "Write NDEF message",
-                    [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 2, ndef_msg_len, reinterpret_cast<uint8_t*>(ndef_msg));});
-    if(res != ndef_msg_len) {
-      throw errorResult(info, 0x12329, "Writing full ndef message failed");
+void DesfireProvisionCard(DesfireGuardTag &tag, const DesfireProvisionSpec &spec, uint16_t &ndef_max_len, int &ndef_mapping) {
+  uint8_t file_no;
+  uint16_t ndef_msg_len = spec.ndef.size();
+  // One session for the whole sequence: a single connect, the version is only read once
+  // and the PICC authentication is kept over change key settings, format and application creation
+  struct mifare_desfire_version_info cardinfo;
+  DesfireGetVersion(tag, cardinfo);
+  ndef_mapping = DesfireNdefMapping(cardinfo);
+  const std::string &uid = tag.uid();
+  ndef_cache_drop(uid);
+  card_cache_invalidate(uid);
+  // Check before the card is formatted
+  if(spec.write_ndef && ndef_msg_len + 2 > DesfireNdefMaxSize(cardinfo, spec.layout)) {
+    throw tag.fail(0x12327, "Supplied NDEF larger than max NDEF size");
+  }
+
+  tag.retry(0x12310, "Authenticate on Mifare DESFire target",
+            [&]()mutable->res_t{return mifare_desfire_authenticate(tag, 0, *spec.picc);});
+  // The settings format followed by createNdef would end with.
+  // Mapping 1 needs the PICC master key for CreateApplication (see DesfireCreateNdef)
+  uint8_t flags = ndef_mapping == 1 ? 0x09 : 0x0F;
+  tag.retry(0x12311, "Change Key Settings",
+            [&]()mutable->res_t{return mifare_desfire_change_key_settings(tag, flags);});
+  tag.retry(0x12312, "Format PICC",
+            [&]()mutable->res_t{return mifare_desfire_format_picc(tag);});
+
+  DesfireCreateNdefFiles(tag, cardinfo, *spec.app, spec.layout, file_no, ndef_max_len);
+  tag.data()->ndef_layout = spec.layout;
+  if(spec.write_ndef) {
+    DesfireWriteNdefFile(tag, file_no, ndef_max_len, const_cast<uint8_t *>(spec.ndef.data()), ndef_msg_len, spec.layout, true);
+  }
+  ndef_cache_put(uid, spec.ndef.data(), ndef_msg_len);
+}
+
+void DesfireProvision(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  try {
+    uint16_t ndef_max_len;
+    int ndef_mapping;
+    DesfireProvisionSpec spec;
+    if(info.Length()!=1) {
+      throw errorResult(info, 0x12302, "The only argument is an options object with members: {piccKey:key, appKey:key, ndef:Buffer, layout:\"std\"|\"backup\"}");
     }
-    tag.retry(0x12331, "Write ndef message size (real)",
-              [&]()mutable->res_t{return mifare_desfire_write_data(tag, file_no, 0, 2, ndef_msg_len_bigendian);});
-    validTrue(info);
+    DesfireProvisionOptions(info, info[0], spec);
+
+    DesfireGuardTag tag(info);
+    DesfireProvisionCard(tag, spec, ndef_max_len, ndef_mapping);
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    result->Set(Nan::New("maxLength").ToLocalChecked(), Nan::New(ndef_max_len));
+    result->Set(Nan::New("mapping").ToLocalChecked(), Nan::New(ndef_mapping));
+    validResult(info, result);
+  } catch(MifareError err) {
+    // The error is already assigned to the InfoScope
+  }
+}
+
+/* A raw command and the Buffer receiving its response, without Buffer the response is returned as new Buffer */
+struct DesfireRawCommand {
+  DesfireRawCommand() : command(NULL), command_len(0), response(NULL), response_len(0) {}
+  const uint8_t *command;
+  size_t command_len;
+  uint8_t *response;
+  size_t response_len;
+};
+
+/* Parse a command Buffer and its optional response Buffer */
+static DesfireRawCommand desfire_raw_command(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> command, v8::Local<v8::Value> response, const char *error) {
+  DesfireRawCommand raw;
+  if(!node::Buffer::HasInstance(command) || (!response->IsUndefined() && !node::Buffer::HasInstance(response))) {
+    throw errorResult(info, 0x12302, error);
+  }
+  // The Buffers are used in place, nothing runs javascript until the session is over
+  raw.command = reinterpret_cast<const uint8_t *>(node::Buffer::Data(command));
+  raw.command_len = node::Buffer::Length(command);
+  if(!response->IsUndefined()) {
+    raw.response = reinterpret_cast<uint8_t *>(node::Buffer::Data(response));
+    raw.response_len = node::Buffer::Length(response);
+  }
+  return raw;
+}
+
+/**
+ * Send raw commands in one guarded session.
+ * @return The new Buffer of the response or the length written to the response Buffer of each command
+ **/
+static v8::Local<v8::Array> desfire_transceive(DesfireGuardTag &tag, std::vector<DesfireRawCommand> &commands) {
+  v8::Local<v8::Array> results = Nan::New<v8::Array>(commands.size());
+  // Raw commands can change keys, applications, files and content, nothing known about the card holds afterwards
+  card_cache_drop(tag.uid());
+  ndef_cache_drop(tag.uid());
+  RawChannel channel(tag.reader(), &tag.deadline());
+  if(channel.open() < 0) {
+    throw tag.fail(0x1233B, "Can't open a raw channel to the card", channel.error(), "Transceive");
+  }
+  uint8_t scratch[TRANSCEIVE_MAX_RESPONSE];
+  for(size_t i = 0; i < commands.size(); i++) {
+    DesfireRawCommand &raw = commands[i];
+    uint8_t *response = raw.response ? raw.response : scratch;
+    size_t response_len = raw.response ? raw.response_len : sizeof(scratch);
+    if(channel.transmit(raw.command, raw.command_len, response, response_len) < 0) {
+      if(channel.expired()) {
+        throw tag.fail(DEADLINE_ERROR, "Deadline exceeded", channel.error(), "Transceive");
+      }
+      throw tag.fail(0x1233C, "Transceive failed", channel.error(), "Transceive");
+    }
+    if(raw.response) {
+      results->Set(i, Nan::New<v8::Number>(response_len));
+    } else {
+      results->Set(i, Nan::CopyBuffer(reinterpret_cast<char *>(scratch), response_len).ToLocalChecked());
+    }
+  }
+  return results;
+}
+
+void DesfireTransceive(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  try {
+    const char *error = "The arguments are the command Buffer and an optional Buffer receiving the response";
+    if(info.Length()<1 || info.Length()>2) {
+      throw errorResult(info, 0x12302, error);
+    }
+    std::vector<DesfireRawCommand> commands(1, desfire_raw_command(info, info[0], info.Length()==2 ? info[1] : Nan::Undefined().As<v8::Value>(), error));
+    DesfireGuardTag tag(info);
+    validResult(info, desfire_transceive(tag, commands)->Get(0));
+  } catch(MifareError err) {
+    // The error is already assigned to the InfoScope
+  }
+}
+
+void DesfireTransceiveMany(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  try {
+    const char *error = "The arguments are an array of command Buffers and an optional array of Buffers receiving the responses";
+    if(info.Length()<1 || info.Length()>2 || !info[0]->IsArray() || (info.Length()==2 && !info[1]->IsArray())) {
+      throw errorResult(info, 0x12302, error);
+    }
+    v8::Local<v8::Array> command_items = v8::Local<v8::Array>::Cast(info[0]);
+    v8::Local<v8::Array> response_items = info.Length()==2 ? v8::Local<v8::Array>::Cast(info[1]) : Nan::New<v8::Array>();
+    std::vector<DesfireRawCommand> commands;
+    commands.reserve(command_items->Length());
+    for(uint32_t i = 0; i < command_items->Length(); i++) {
+      commands.push_back(desfire_raw_command(info, command_items->Get(i), response_items->Get(i), error));
+    }
+    DesfireGuardTag tag(info);
+    validResult(info, desfire_transceive(tag, commands));
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
   }
@@ -676,7 +1130,7 @@ void DesfireFree(const Nan::FunctionCallbackInfo<v8::Value> &info) {
       throw errorResult(info, 0x12321, "This function takes no arguments");
     }
 
-    delete data;
+    card_release(info.This(), data);
     data = NULL;
     validTrue(info);
   } catch(MifareError err) {
@@ -9,58 +9,57 @@
 #include <iostream>
 #include <cstring>
 #include <memory>
+#include <string>
 
-#if ! defined(USE_LIBNFC)
-#if defined(__APPLE__) || defined(__linux__)
-#include <PCSC/winscard.h>
-#include <PCSC/wintypes.h>
-#else
-#include <winscard.h>
-#endif
-#include <freefare_pcsc.h>
-#else
-#include <freefare_nfc.h>
-#endif // ! USE_LIBNFC
+#include "backend.h"
 
+#include "card.h"
 #include "reader.h"
+#include "keys.h"
+#include "deadline.h"
 #include "utils.h"
 #include <cstdlib>
-#include <functional>
+
+/* How the NDEF file is stored on the card */
+enum NdefLayout {
+  NDEF_LAYOUT_UNKNOWN = -1,
+  // Standard data file: the length and the message are written one after the other
+  NDEF_LAYOUT_STD = 0,
+  // Backup data file: length and message become visible together on commit, half the size
+  NDEF_LAYOUT_BACKUP = 1
+};
 
 /* A data object collecting all interesting details for a tag */
 class DesfireData {
   public:
     /* The data object is created from a reader data object and a freefare tag object */
-    DesfireData(ReaderData *reader, FreefareTag *tags) : reader(reader), tags(tags) {
-      uint8_t null[8] = {0,0,0,0,0,0,0,0};
-      key = mifare_desfire_des_key_new(null);
-      aid = mifare_desfire_aid_new(0x000001);
-    }
+    DesfireData(ReaderData *reader, const TagsPtr &tags) : reader(reader), tag(NULL), tags(tags), key(key_default()), ndef_layout(NDEF_LAYOUT_UNKNOWN), timeout(-1), aid(NULL) {}
 
-    /* If destroyed it will free the tags as well */
+    /* If destroyed it will free the tags as well, unless another card of the same poll still uses them */
     ~DesfireData() {
-      if(key) {
-        mifare_desfire_key_free(key);
-        key = NULL;
-      }
       if(aid) {
         free(aid);
         aid = NULL;
       }
-      if(tag) {
-        freefare_free_tags(tags);
-      }
       tag = NULL;
-      tags = NULL;
     }
 
     ReaderData *reader;
     FreefareTag tag;
-    // The shared pointer makes problems. tags is not an C++ object and needs an special destructor
-    //std::shared_ptr<FreefareTag> tags;
-    FreefareTag *tags;
-    MifareDESFireKey key;
+    // The tag list the tag belongs to
+    TagsPtr tags;
+    // Shared with other cards and the key registry
+    KeyPtr key;
+    // Layout of the NDEF file, read once from the file settings
+    NdefLayout ndef_layout;
+    // Deadline of each command in ms set by setTimeout, -1 for the timeout of the reader
+    int64_t timeout;
+    // Set by setAid, NULL for the default 000001h
     MifareDESFireAID aid;
+    // UID as hex string, read once from the tag
+    std::string uid;
+    // Weak handle of the card object, see card_attach
+    Nan::Persistent<v8::Object> self;
 };
 
 /* Extracts Tag data object from nodejs info context */
@@ -86,13 +85,22 @@ class DesfireGuardTag {
      * On negative result an error is detected and the the internal error state of the card reader service is read.
      * In case of communication error the closure is reexecuted n tries on other error an exeption is thrown. */
     DesfireGuardTag(const Nan::FunctionCallbackInfo<v8::Value> &info, bool active = true)
-      : m_info(info), m_data(DesfireData_from_info(info)), m_reader(m_data->reader), m_active(false) {
+      : m_info(&info), m_data(DesfireData_from_info(info)), m_reader(m_data->reader), m_active(false) {
       // We store the m_data->reader pointer as m_reader in case m_data is destroyed for some reason.
       if(active) {
         guard();
       }
     }
 
+    /* Constructor for a card without javascript context, e.g. on a worker thread.
+     * Errors are thrown as plain MifareError and have to be reported by the caller. */
+    DesfireGuardTag(DesfireData *data, bool active = true)
+      : m_info(NULL), m_data(data), m_reader(data->reader), m_active(false) {
+      if(active) {
+        guard();
+      }
+    }
+
     /* Destructor. Unguards the tag. */
     virtual ~DesfireGuardTag() {
       unguard();
@@ -108,18 +116,53 @@ class DesfireGuardTag {
       return m_reader;
     }
 
+    /* The deadline of the session, commands outside retry restart it themselves, see RawChannel */
+    Deadline &deadline() {
+      return m_deadline;
+    }
+
     /* The guard wrapps a FreefareTag and is implicite usable as one */
     operator FreefareTag() {
       return m_data->tag;
     }
 
+    /* Returns the UID of the card as hex string */
+    const std::string &uid() {
+      if(m_data->uid.empty()) {
+        char *uid_c = freefare_get_tag_uid(m_data->tag);
+        if(uid_c) {
+          m_data->uid = uid_c;
+          free(uid_c);
+        }
+      }
+      return m_data->uid;
+    }
+
+    /* Returns size bytes of scratch memory, valid until the tag is unguarded. Throws if the heap is exhausted */
+    uint8_t *scratch(size_t size, int pos_code, const char *name) {
+      uint8_t *result = m_reader->scratch.alloc<uint8_t>(size);
+      if(!result) {
+        throw fail(pos_code, "Allocation of scratch memory failed", 0, name);
+      }
+      return result;
+    }
+
+    /* Returns the message buffer of the reader, emptied. It keeps its capacity, so the sessions reuse it */
+    std::vector<uint8_t> &message() {
+      m_reader->message.clear();
+      return m_reader->message;
+    }
+
     /* Retry a closure/lambda n times and throw an error on failiur with pos_code and name */
-    res_t retry(unsigned int pos_code, const char *name, std::function<res_t ()> try_f, int tries=3) {
+    template<class Try>
+    res_t retry(unsigned int pos_code, const char *name, Try try_f, int tries=3) {
       //std::cout << "ReTry " << name << std::endl;
       res_t ret_code = 0;
       unsigned int int_code = 0;
       while(tries>0) {
         //std::cout << "Try " << tries << " " << name << std::endl;
+        // Every command gets the whole deadline
+        m_deadline.restart();
         freefare_clear_internal_error(m_data->tag);
         ret_code = try_f();
         int_code = error();
@@ -127,20 +170,31 @@ class DesfireGuardTag {
         if(ret_code>=0) {
           return ret_code;
         } else { // ERROR ret is negative
-          if(int_code==28) {
+          if(m_deadline.expired()) {
+            // Aborted by the watchdog, or the card took too long anyway
+            throw fail(DEADLINE_ERROR, "Deadline exceeded", int_code, name);
+          } else if(int_code==28) {
             // ILLEGAL_COMMAND: Propably due to to short time for initialization
             continue;
           } else if(int_code==0x80100010) {
             // CMD ERROR: Propably due to to short time for initialization
             continue;
           } else {
-            throw errorResult(m_info, pos_code, errorString(), int_code, name);
+            throw fail(pos_code, errorString(), int_code, name);
           }
         }
       }
       return ret_code;
     }
 
+    /* Returns the error to throw. It is attached to the javascript result if the guard has a javascript context */
+    MifareError fail(int pos_code, const char *msg, unsigned int res = 0, const char *msg2 = "") {
+      if(m_info) {
+        return errorResult(*m_info, pos_code, msg, res, msg2);
+      }
+      return MifareError(msg, pos_code, res, msg2);
+    }
+
     /* Return the friendly name of the tag */
     const char *name() {
       if(m_data) {
@@ -178,8 +232,15 @@ class DesfireGuardTag {
       //std::cout << "Guard " << std::endl;
       if(!m_active) {
         int res = 0;
-        uv_mutex_lock(  &m_reader->mDevice);
+        m_deadline.start(m_reader, static_cast<uint32_t>(m_data && m_data->timeout >= 0 ? m_data->timeout : m_reader->timeout));
+        if(!m_reader->mDevice.lock(m_deadline.end())) {
+          m_deadline.stop();
+          throw fail(DEADLINE_ERROR, "Deadline exceeded", 0, "Wait for the reader");
+        }
+        // The wait for the reader does not count against the connect
+        m_deadline.restart();
         if(m_data) {
+          DeviceBackoff backoff(m_deadline.end());
           while(1) {
             //std::cout << "Guard: Connect" << std::endl;
             freefare_clear_internal_error(m_data->tag);
@@ -187,21 +248,30 @@ class DesfireGuardTag {
             /*if(res==240) { // ERROR_VC_DISCONNECTED - Card needs reconnect
               res = mifare_desfire_reconnect(m_data->tag);
             }*/
-            if(res && error() == 0x8010000B) {
+            if(res && m_deadline.expired()) {
+              m_reader->mDevice.unlock();
+              m_deadline.stop();
+              throw fail(DEADLINE_ERROR, "Deadline exceeded", error(), "Can't conntect to Mifare DESFire target.");
+            } else if(res && (error() == 0x8010000B || error() == ENXIO)) {
               //std::cout << "Guard: Not a Command" << std::endl;
-              // SCARD_E_SHARING_VIOLATION
-              // The smart card cannot be accessed because of other connections outstanding
-              mifare_sleep();
-              continue;
-            } else if(res && error() == ENXIO) {
-              //std::cout << "Guard: Disconnect. Should not be connected anymore" << std::endl;
-              mifare_desfire_disconnect(m_data->tag);
+              // SCARD_E_SHARING_VIOLATION: The smart card cannot be accessed because of other connections outstanding
+              // ENXIO: Should not be connected anymore
+              unsigned int busy = error();
+              if(busy == ENXIO) {
+                mifare_desfire_disconnect(m_data->tag);
+              }
+              if(!backoff.wait()) {
+                m_reader->mDevice.unlock();
+                m_deadline.stop();
+                throw fail(DEVICE_BUSY_ERROR, "Card in use by another application", busy, "Can't conntect to Mifare DESFire target.");
+              }
               continue;
             } else if(res) {
               //std::cout << "Guard: Throw error: " << res << " " << error() << " " << errno << std::endl;
-              uv_mutex_unlock(&m_reader->mDevice);
+              m_reader->mDevice.unlock();
+              m_deadline.stop();
 
-              throw errorResult(m_info, 0x12303, errorString(), error(), "Can't conntect to Mifare DESFire target.");
+              throw fail(0x12303, errorString(), error(), "Can't conntect to Mifare DESFire target.");
               break;
             } else {
               //std::cout << "Guard: OK" << std::endl;
@@ -224,23 +294,38 @@ class DesfireGuardTag {
           //std::cout << "UnGuard: Disconnect" << std::endl;
           mifare_desfire_disconnect(m_data->tag);
         }
-        uv_mutex_unlock(&m_reader->mDevice);
+        m_reader->scratch.reset();
+        m_reader->mDevice.unlock();
+        m_deadline.stop();
       }
       m_active = false;
     }
 
   private:
-    const Nan::FunctionCallbackInfo<v8::Value> &m_info;
+    const Nan::FunctionCallbackInfo<v8::Value> *m_info;
     DesfireData *m_data;
     ReaderData *m_reader;
     bool m_active;
+    // Deadline of the connect and of each command, runs while the tag is guarded
+    Deadline m_deadline;
 };
 
-v8::Local<v8::Object> DesfireCreate(ReaderData *reader, FreefareTag *tagList, FreefareTag activeTag);
+v8::Local<v8::Object> DesfireCreate(ReaderData *reader, const TagsPtr &tagList, FreefareTag activeTag);
 
 /** Extract tag data from info nodejs info object */
 DesfireData *DesfireData_from_info(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
+/** The version information of a card as javascript object, as returned by info() */
+v8::Local<v8::Object> DesfireVersionObject(const struct mifare_desfire_version_info &info);
+
+/**
+ * Get the version of a card, from the card cache if it was seen before.
+ * Uses no javascript objects and can run on a worker thread.
+ * @param tag The card, guarded if the version has to be read
+ * @param info Returns the version
+ **/
+void DesfireGetVersion(DesfireGuardTag &tag, struct mifare_desfire_version_info &info);
+
 /** Get tag information as an javascript object */
 void DesfireInfo(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
@@ -261,20 +346,124 @@ void DesfireSetAid(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
 void DesfireSetKey(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
+/** card.setTimeout([ms]): Deadline of each command on this card, without argument the timeout of the reader is used */
+void DesfireSetTimeout(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
 void DesfireFormat(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
 void DesfireCreateNdef(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
 /**
  * Helper function to locate and read TVL of a desfire ndef sector
- * @return Might return a result object. This is only used when res is lesser 0 otherwise the object is empty.
+ * Uses no javascript objects and can run on a worker thread.
+ * @return Always 0, errors are thrown
+ */
+int DesfireReadNdefTVL(DesfireGuardTag &tag, uint8_t &file_no, uint16_t &ndefmaxlen, MifareDESFireKey key_app);
+
+/** Like above for a card of which the version is already known */
+int DesfireReadNdefTVL(DesfireGuardTag &tag, const struct mifare_desfire_version_info &cardinfo, uint8_t &file_no, uint16_t &ndefmaxlen, MifareDESFireKey key_app);
+
+/**
+ * Helper function to read the NDEF message from the selected NDEF application.
+ * Uses no javascript objects and can run on a worker thread.
+ * @param ndef_msg Returns the message without NLEN
+ */
+void DesfireReadNdefFile(DesfireGuardTag &tag, uint8_t file_no, uint16_t ndef_max_len, std::vector<uint8_t> &ndef_msg);
+
+/**
+ * Read the NDEF message with ISO 7816-4 commands: SELECT of the NDEF Tag Application, the CC file and the NDEF file,
+ * then READ BINARY with the largest Le of the card. No version and no authentication is needed.
+ * The card cache remembers cards which answered without such an NDEF, they take the native commands right away on the next read.
+ * A read which failed in transport is not remembered.
+ * @param tag The guarded card
+ * @param ndef_msg Returns the message
+ * @param ndef_max_len Returns the size of the NDEF file
+ * @return false if the card has no NDEF which is free to read over ISO, the native commands have to be used then
+ **/
+bool DesfireReadNdefIso(DesfireGuardTag &tag, std::vector<uint8_t> &ndef_msg, uint16_t &ndef_max_len);
+
+/** The NDEF mapping (1 or 2) used for a card version */
+int DesfireNdefMapping(const struct mifare_desfire_version_info &cardinfo);
+
+/** The DESFire AID of the NDEF application of a mapping: EEEE10h for 1, 000001h for 2 */
+MifareDESFireAID DesfireNdefAid(int mapping);
+
+/** The size of the NDEF file created for a card version. A backup file takes twice its size */
+uint16_t DesfireNdefMaxSize(const struct mifare_desfire_version_info &cardinfo, NdefLayout layout = NDEF_LAYOUT_STD);
+
+/**
+ * Parse the NDEF layout option "std" or "backup". Undefined is "std".
+ * Throws an errorResult on unknown values.
  */
-int DesfireReadNdefTVL(const Nan::FunctionCallbackInfo<v8::Value> &info, DesfireData *data, uint8_t &file_no, uint16_t &ndefmaxlen, MifareDESFireKey key_app);
+NdefLayout DesfireNdefLayoutOption(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> value, const char *error);
+
+/**
+ * Helper function to read the layout of the NDEF file in the selected NDEF application.
+ * The layout is cached in the card data.
+ */
+NdefLayout DesfireNdefFileLayout(DesfireGuardTag &tag, uint8_t file_no);
+
+/**
+ * Helper function to create the NDEF application with the capability container and the NDEF file.
+ * The PICC level has to be selected and authenticated if the key settings require it.
+ * @param layout Create the NDEF file as standard or as backup data file
+ * @param file_no Returns the number of the NDEF file
+ * @param ndef_max_len Returns the size of the NDEF file
+ */
+void DesfireCreateNdefFiles(DesfireGuardTag &tag, const struct mifare_desfire_version_info &cardinfo, MifareDESFireKey key_app, NdefLayout layout, uint8_t &file_no, uint16_t &ndef_max_len);
+
+/**
+ * Helper function to write a NDEF message with its length to the selected NDEF application.
+ * A backup file is written with a single write and committed, otherwise the length is invalidated first.
+ * @param layout The layout of the NDEF file
+ * @param blank The file was just created, the length does not have to be invalidated first
+ */
+void DesfireWriteNdefFile(DesfireGuardTag &tag, uint8_t file_no, uint16_t ndef_max_len, uint8_t *ndef_msg, uint16_t ndef_msg_len, NdefLayout layout, bool blank);
+
+/**
+ * Helper function to update the NDEF message in the selected NDEF application from a known previous message.
+ * Only the changed byte ranges and NLEN are written.
+ * @param previous The message on the card before the write
+ */
+void DesfireWriteNdefDiff(DesfireGuardTag &tag, uint8_t file_no, uint16_t ndef_max_len, uint8_t *ndef_msg, uint16_t ndef_msg_len, NdefLayout layout, const std::vector<uint8_t> &previous);
 
 void DesfireReadNdef(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
 void DesfireWriteNdef(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
+/* Everything provision writes to a card. Holds copies only, so it can be handed to a worker thread */
+struct DesfireProvisionSpec {
+  DesfireProvisionSpec() : layout(NDEF_LAYOUT_STD), write_ndef(false) {}
+  KeyPtr picc;
+  KeyPtr app;
+  NdefLayout layout;
+  bool write_ndef;
+  std::vector<uint8_t> ndef;
+};
+
+/**
+ * Parse the provision options object {piccKey, appKey, ndef, layout}
+ * Throws an errorResult on invalid options.
+ */
+void DesfireProvisionOptions(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> options, DesfireProvisionSpec &spec);
+
+/**
+ * Format the card, create the NDEF application and write the NDEF message in the session of tag.
+ * Uses no javascript objects and can run on a worker thread.
+ * @param ndef_max_len Returns the size of the NDEF file
+ * @param ndef_mapping Returns the NDEF mapping used
+ */
+void DesfireProvisionCard(DesfireGuardTag &tag, const DesfireProvisionSpec &spec, uint16_t &ndef_max_len, int &ndef_mapping);
+
+/** Format the card, create the NDEF application and write a NDEF message in one session */
+void DesfireProvision(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+/** card.transceive(command, [response]): Send a raw command, the response goes to a new Buffer or the given one */
+void DesfireTransceive(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+/** card.transceiveMany([commands], [responses]): Send raw commands in one session */
+void DesfireTransceiveMany(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
 void DesfireFree(const Nan::FunctionCallbackInfo<v8::Value> &info);
 
 #endif // DESFIRE_H
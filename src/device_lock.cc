@@ -0,0 +1,78 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "device_lock.h"
+
+/* How long a session waits for a card held by another application without deadline, in ms */
+static const uint64_t DEVICE_BUSY_WAIT = 2000;
+
+/* Longest single sleep of the backoff in ms */
+static const unsigned int DEVICE_BACKOFF_MAX = 32;
+
+DeviceLock::DeviceLock() : m_next(0), m_serving(0) {
+  uv_mutex_init(&m_mutex);
+  uv_cond_init(&m_cond);
+}
+
+DeviceLock::~DeviceLock() {
+  uv_cond_destroy(&m_cond);
+  uv_mutex_destroy(&m_mutex);
+}
+
+bool DeviceLock::lock(uint64_t end) {
+  uv_mutex_lock(&m_mutex);
+  uint64_t ticket = m_next++;
+  while(m_serving != ticket) {
+    if(!end) {
+      uv_cond_wait(&m_cond, &m_mutex);
+      continue;
+    }
+    uint64_t now = uv_hrtime();
+    if(now >= end || uv_cond_timedwait(&m_cond, &m_mutex, end - now) == UV_ETIMEDOUT) {
+      if(m_serving == ticket) {
+        // Served right at the timeout
+        break;
+      }
+      m_abandoned.insert(ticket);
+      uv_mutex_unlock(&m_mutex);
+      return false;
+    }
+  }
+  uv_mutex_unlock(&m_mutex);
+  return true;
+}
+
+void DeviceLock::unlock() {
+  uv_mutex_lock(&m_mutex);
+  m_serving++;
+  while(m_abandoned.erase(m_serving)) {
+    m_serving++;
+  }
+  // The waiters check their ticket, only the next one proceeds
+  uv_cond_broadcast(&m_cond);
+  uv_mutex_unlock(&m_mutex);
+}
+
+DeviceBackoff::DeviceBackoff(uint64_t end) : m_end(end ? end : uv_hrtime() + DEVICE_BUSY_WAIT * 1000000), m_delay(1) {
+}
+
+bool DeviceBackoff::wait() {
+  if(uv_hrtime() + static_cast<uint64_t>(m_delay) * 1000000 > m_end) {
+    return false;
+  }
+#if defined(_WIN32)
+  Sleep(m_delay);
+#else
+  usleep(m_delay * 1000);
+#endif
+  if(m_delay < DEVICE_BACKOFF_MAX) {
+    m_delay *= 2;
+  }
+  return true;
+}
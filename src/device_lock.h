@@ -0,0 +1,60 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef DEVICE_LOCK_H
+#define DEVICE_LOCK_H
+
+#include <uv.h>
+#include <stdint.h>
+#include <set>
+
+/* Position code of the error thrown when another PCSC client holds the card longer than the wait allows */
+static const int DEVICE_BUSY_ERROR = 0x1233A;
+
+/*
+ * Exclusive access to the device of a reader for the threads of this process.
+ * A ticket lock: the waiters sleep on a condition variable and get the device in the order they asked for it,
+ * so a card session waiting on the main thread is not starved by the jobs on the pool and vice versa.
+ */
+class DeviceLock {
+  public:
+    DeviceLock();
+    ~DeviceLock();
+
+    /* Wait for the device */
+    void lock() {
+      lock(0);
+    }
+
+    /* Wait for the device until end (ns of uv_hrtime, 0 waits forever). Returns false if the wait timed out */
+    bool lock(uint64_t end);
+
+    /* Hand the device to the next waiter */
+    void unlock();
+
+  private:
+    uv_mutex_t m_mutex;
+    uv_cond_t m_cond;
+    uint64_t m_next;
+    uint64_t m_serving;
+    // Tickets of waiters which timed out, skipped when they are served
+    std::set<uint64_t> m_abandoned;
+};
+
+/*
+ * Bounded exponential backoff for a card held by another PCSC client (SCARD_E_SHARING_VIOLATION).
+ * Starts at 1 ms and doubles up to 32 ms per wait.
+ */
+class DeviceBackoff {
+  public:
+    /* Waits until end (ns of uv_hrtime), 0 for the default of DEVICE_BUSY_WAIT ms from now */
+    DeviceBackoff(uint64_t end);
+
+    /* Sleep before the next try. Returns false if the wait would pass the end */
+    bool wait();
+
+  private:
+    uint64_t m_end;
+    unsigned int m_delay;
+};
+
+#endif // DEVICE_LOCK_H
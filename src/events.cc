@@ -0,0 +1,245 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "events.h"
+#include "utils.h"
+
+/* Default size of the ring */
+static const uint32_t EVENTS_HIGH_WATER_MARK = 16;
+
+/* The iterator result {value, done} */
+static v8::Local<v8::Object> iterator_result(v8::Local<v8::Value> value, bool done) {
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  result->Set(Nan::New("value").ToLocalChecked(), value);
+  result->Set(Nan::New("done").ToLocalChecked(), Nan::New(done));
+  return result;
+}
+
+static v8::Local<v8::Promise> resolved(v8::Local<v8::Value> value) {
+  v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+  resolver->Resolve(Nan::GetCurrentContext(), value).FromJust();
+  return resolver->GetPromise();
+}
+
+EventQueue::EventQueue(ReaderData *reader, uint32_t high_water_mark, EventOverflow overflow)
+  : m_reader(reader), m_ring(new Nan::Persistent<v8::Object>[high_water_mark]), m_capacity(high_water_mark), m_head(0), m_count(0),
+    m_overflow(overflow), m_ended(false), m_delivered(0), m_dropped(0), m_coalesced(0), m_overflows(0) {
+}
+
+EventQueue::~EventQueue() {
+  end();
+  delete [] m_ring;
+}
+
+void EventQueue::detach() {
+  end();
+  m_reader = NULL;
+}
+
+void EventQueue::discard(Nan::Persistent<v8::Object> &event) {
+  v8::Local<v8::Value> card = Nan::New(event)->Get(Nan::New("card").ToLocalChecked());
+  if(card->IsObject()) {
+    v8::Local<v8::Value> free = v8::Local<v8::Object>::Cast(card)->Get(Nan::New("free").ToLocalChecked());
+    if(free->IsFunction()) {
+      Nan::Call(free.As<v8::Function>(), v8::Local<v8::Object>::Cast(card), 0, NULL);
+    }
+  }
+  event.Reset();
+}
+
+void EventQueue::push(v8::Local<v8::Object> event) {
+  if(m_ended) {
+    Nan::Persistent<v8::Object> dropped(event);
+    discard(dropped);
+    return;
+  }
+  if(!m_waiting.empty()) {
+    // Somebody waits, the event does not need to be queued
+    Nan::Persistent<v8::Promise::Resolver> *waiting = m_waiting.front();
+    m_waiting.pop_front();
+    Nan::New(*waiting)->Resolve(Nan::GetCurrentContext(), iterator_result(event, false)).FromJust();
+    waiting->Reset();
+    delete waiting;
+    m_delivered++;
+    return;
+  }
+  if(m_count == m_capacity) {
+    m_overflows++;
+    if(m_overflow == EVENT_OVERFLOW_COALESCE) {
+      Nan::Persistent<v8::Object> &newest = m_ring[(m_head + m_count - 1) % m_capacity];
+      discard(newest);
+      newest.Reset(event);
+      m_coalesced++;
+      return;
+    }
+    discard(m_ring[m_head]);
+    m_head = (m_head + 1) % m_capacity;
+    m_count--;
+    m_dropped++;
+  }
+  m_ring[(m_head + m_count) % m_capacity].Reset(event);
+  m_count++;
+}
+
+v8::Local<v8::Promise> EventQueue::next() {
+  if(m_count) {
+    v8::Local<v8::Object> event = Nan::New(m_ring[m_head]);
+    m_ring[m_head].Reset();
+    m_head = (m_head + 1) % m_capacity;
+    m_count--;
+    m_delivered++;
+    return resolved(iterator_result(event, false));
+  }
+  if(m_ended) {
+    return resolved(iterator_result(Nan::Undefined(), true));
+  }
+  v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+  m_waiting.push_back(new Nan::Persistent<v8::Promise::Resolver>(resolver));
+  return resolver->GetPromise();
+}
+
+void EventQueue::end() {
+  m_ended = true;
+  while(m_count) {
+    discard(m_ring[m_head]);
+    m_head = (m_head + 1) % m_capacity;
+    m_count--;
+  }
+  while(!m_waiting.empty()) {
+    Nan::Persistent<v8::Promise::Resolver> *waiting = m_waiting.front();
+    m_waiting.pop_front();
+    Nan::New(*waiting)->Resolve(Nan::GetCurrentContext(), iterator_result(Nan::Undefined(), true)).FromJust();
+    waiting->Reset();
+    delete waiting;
+  }
+}
+
+v8::Local<v8::Object> EventQueue::stats() {
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  result->Set(Nan::New("queued").ToLocalChecked(), Nan::New(m_count));
+  result->Set(Nan::New("highWaterMark").ToLocalChecked(), Nan::New(m_capacity));
+  result->Set(Nan::New("delivered").ToLocalChecked(), Nan::New(m_delivered));
+  result->Set(Nan::New("dropped").ToLocalChecked(), Nan::New(m_dropped));
+  result->Set(Nan::New("coalesced").ToLocalChecked(), Nan::New(m_coalesced));
+  result->Set(Nan::New("overflows").ToLocalChecked(), Nan::New(m_overflows));
+  result->Set(Nan::New("ended").ToLocalChecked(), Nan::New(m_ended));
+  return result;
+}
+
+/* The iterator's share of its queue, freed when the functions of the iterator are collected */
+struct EventsHandle {
+  std::shared_ptr<EventQueue> queue;
+  Nan::Persistent<v8::External> self;
+};
+
+static void events_collected(const Nan::WeakCallbackInfo<EventsHandle> &info) {
+  EventsHandle *handle = info.GetParameter();
+  handle->self.Reset();
+  delete handle;
+}
+
+/* Extracts the queue from the data of a bound function */
+static EventQueue *events_queue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  return static_cast<EventsHandle *>(v8::Local<v8::External>::Cast(info.Data())->Value())->queue.get();
+}
+
+/* The listen callback of a reader streaming its events */
+static void EventsSink(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  EventQueue *queue = events_queue(info);
+  v8::Local<v8::Object> event = Nan::New<v8::Object>();
+  // The reader object is reused for all events, the status is copied
+  v8::Local<v8::Value> status = Nan::Undefined();
+  if(info[1]->IsObject()) {
+    status = v8::Local<v8::Object>::Cast(info[1])->Get(Nan::New("status").ToLocalChecked());
+  }
+  if(status->IsString() && status->Equals(Nan::New("timeout").ToLocalChecked())) {
+    // PCSC reports every poll without change as timeout, queued they would push the arrivals out of the ring
+    return;
+  }
+  event->Set(Nan::New("err").ToLocalChecked(), info[0]);
+  event->Set(Nan::New("reader").ToLocalChecked(), info[1]);
+  event->Set(Nan::New("status").ToLocalChecked(), status);
+  event->Set(Nan::New("card").ToLocalChecked(), info[2]);
+  queue->push(event);
+}
+
+static void EventsNext(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  info.GetReturnValue().Set(events_queue(info)->next());
+}
+
+/* Called by break in for await: stops the reader if it still feeds this iteration */
+static void EventsReturn(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  EventQueue *queue = events_queue(info);
+  if(queue->reader()) {
+    // Detaches the queue
+    reader_release(queue->reader());
+  }
+  queue->end();
+  info.GetReturnValue().Set(resolved(iterator_result(info.Length() ? info[0] : Nan::Undefined().As<v8::Value>(), true)));
+}
+
+static void EventsStats(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  info.GetReturnValue().Set(events_queue(info)->stats());
+}
+
+static void EventsSelf(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  info.GetReturnValue().Set(info.This());
+}
+
+/* Sets a method which knows the queue */
+static void events_method(v8::Local<v8::Object> target, v8::Local<v8::Value> key, Nan::FunctionCallback callback, v8::Local<v8::External> data) {
+  Nan::Set(target, key, Nan::GetFunction(Nan::New<v8::FunctionTemplate>(callback, data)).ToLocalChecked());
+}
+
+void ReaderEvents(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  ReaderData *data = ReaderData_from_info(info);
+  const char *error = "The only argument of events is an optional options object {highWaterMark:n, overflow:\"drop-oldest\"|\"coalesce\"} with the options of listen";
+  if(info.Length()>1 || (info.Length()==1 && !info[0]->IsObject())) {
+    Nan::ThrowError(error);
+    return;
+  }
+  v8::Local<v8::Object> options = info.Length()==1 ? v8::Local<v8::Object>::Cast(info[0]) : Nan::New<v8::Object>();
+  uint32_t high_water_mark = EVENTS_HIGH_WATER_MARK;
+  EventOverflow overflow = EVENT_OVERFLOW_DROP_OLDEST;
+  v8::Local<v8::Value> value = options->Get(Nan::New("highWaterMark").ToLocalChecked());
+  if(!value->IsUndefined()) {
+    if(!value->IsUint32() || Nan::To<uint32_t>(value).FromJust() == 0) {
+      Nan::ThrowError(error);
+      return;
+    }
+    high_water_mark = Nan::To<uint32_t>(value).FromJust();
+  }
+  value = options->Get(Nan::New("overflow").ToLocalChecked());
+  if(value->Equals(Nan::New("coalesce").ToLocalChecked())) {
+    overflow = EVENT_OVERFLOW_COALESCE;
+  } else if(!value->IsUndefined() && !value->Equals(Nan::New("drop-oldest").ToLocalChecked())) {
+    Nan::ThrowError(error);
+    return;
+  }
+
+  if(data->events) {
+    // The previous iteration ends, its iterator reports done from now on
+    data->events->detach();
+  }
+  EventsHandle *handle = new EventsHandle();
+  handle->queue = std::make_shared<EventQueue>(data, high_water_mark, overflow);
+  v8::Local<v8::External> external = Nan::New<v8::External>(handle);
+  handle->self.Reset(external);
+  handle->self.SetWeak(handle, events_collected, Nan::WeakCallbackType::kParameter);
+  data->events = handle->queue;
+  v8::Local<v8::Function> sink = Nan::GetFunction(Nan::New<v8::FunctionTemplate>(EventsSink, external)).ToLocalChecked();
+  if(!reader_listen(data, info.This(), sink, options)) {
+    data->events->detach();
+    data->events.reset();
+    return;
+  }
+
+  v8::Local<v8::Object> iterator = Nan::New<v8::Object>();
+  events_method(iterator, Nan::New("next").ToLocalChecked(), EventsNext, external);
+  events_method(iterator, Nan::New("return").ToLocalChecked(), EventsReturn, external);
+  events_method(iterator, Nan::New("stats").ToLocalChecked(), EventsStats, external);
+#if NODE_VERSION_AT_LEAST(10, 0, 0)
+  events_method(iterator, v8::Symbol::GetAsyncIterator(v8::Isolate::GetCurrent()), EventsSelf, external);
+#endif
+  info.GetReturnValue().Set(iterator);
+}
@@ -0,0 +1,69 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <nan.h>
+#include <deque>
+#include <memory>
+
+#include "reader.h"
+
+/* What happens with a new event if the queue is full */
+enum EventOverflow {
+  // The oldest queued event is dropped
+  EVENT_OVERFLOW_DROP_OLDEST,
+  // The newest queued event is replaced, the queue ends with the current state of the reader
+  EVENT_OVERFLOW_COALESCE
+};
+
+/*
+ * The bounded ring of one reader.events() iteration. Events are queued until the iterator asks for them,
+ * a pending next() gets the next event directly. Shared by the reader and the iterator, the reader
+ * detaches it when it is released, listens otherwise or starts a new iteration. Only used on the main thread.
+ */
+class EventQueue {
+  public:
+    EventQueue(ReaderData *reader, uint32_t high_water_mark, EventOverflow overflow);
+    ~EventQueue();
+
+    /* The reader feeding the queue, NULL once detached */
+    ReaderData *reader() const { return m_reader; }
+
+    /* Ends the iteration and forgets the reader */
+    void detach();
+
+    /* Queue an event object {err, reader, status, card} */
+    void push(v8::Local<v8::Object> event);
+
+    /* Returns a promise of the next iterator result */
+    v8::Local<v8::Promise> next();
+
+    /* Ends the iteration: pending and later next() calls are done, queued events are dropped */
+    void end();
+
+    /* The counters as javascript object */
+    v8::Local<v8::Object> stats();
+
+  private:
+    /* Frees the card of a dropped event */
+    void discard(Nan::Persistent<v8::Object> &event);
+
+    ReaderData *m_reader;
+    Nan::Persistent<v8::Object> *m_ring;
+    uint32_t m_capacity;
+    uint32_t m_head;
+    uint32_t m_count;
+    EventOverflow m_overflow;
+    bool m_ended;
+    std::deque<Nan::Persistent<v8::Promise::Resolver> *> m_waiting;
+    double m_delivered;
+    double m_dropped;
+    double m_coalesced;
+    double m_overflows;
+};
+
+/** reader.events({highWaterMark, overflow, ...listen options}): Async iterator over the reader events */
+void ReaderEvents(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+#endif // EVENTS_H
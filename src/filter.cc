@@ -0,0 +1,73 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "filter.h"
+
+static const uint64_t NS_PER_MS = 1000000;
+
+PresenceFilter::PresenceFilter()
+  : m_min_presence(0), m_departure_grace(0), m_retap_window(0), m_state(STATE_EMPTY), m_since(0), m_last_departure(0) {
+}
+
+void PresenceFilter::configure(uint32_t min_presence_ms, uint32_t departure_grace_ms, uint32_t retap_window_ms) {
+  m_min_presence = min_presence_ms * NS_PER_MS;
+  m_departure_grace = departure_grace_ms * NS_PER_MS;
+  m_retap_window = retap_window_ms * NS_PER_MS;
+  m_state = STATE_EMPTY;
+  m_last_uid.clear();
+  m_last_departure = 0;
+}
+
+bool PresenceFilter::active() const {
+  return m_min_presence || m_departure_grace || m_retap_window;
+}
+
+FilterReport PresenceFilter::present(uint64_t now) {
+  switch(m_state) {
+    case STATE_EMPTY:
+      m_state = STATE_ARRIVING;
+      m_since = now;
+      // fall through
+    case STATE_ARRIVING:
+      return now - m_since >= m_min_presence ? FILTER_ARRIVAL : FILTER_NONE;
+    case STATE_LEAVING:
+      // Back within the grace period, the card was never gone
+      m_state = STATE_PRESENT;
+      return FILTER_NONE;
+    default:
+      return FILTER_NONE;
+  }
+}
+
+FilterReport PresenceFilter::absent(uint64_t now) {
+  switch(m_state) {
+    case STATE_ARRIVING:
+    case STATE_SUPPRESSED:
+      // Never reported, so the departure is not either
+      m_state = STATE_EMPTY;
+      return FILTER_NONE;
+    case STATE_PRESENT:
+      m_state = STATE_LEAVING;
+      m_since = now;
+      // fall through
+    case STATE_LEAVING:
+      if(now - m_since < m_departure_grace) {
+        return FILTER_NONE;
+      }
+      m_state = STATE_EMPTY;
+      m_last_departure = now;
+      return FILTER_DEPARTURE;
+    default:
+      return FILTER_NONE;
+  }
+}
+
+bool PresenceFilter::accept(const std::string &uid, uint64_t now) {
+  if(m_retap_window && !uid.empty() && uid == m_last_uid && now - m_last_departure < m_retap_window) {
+    m_state = STATE_SUPPRESSED;
+    return false;
+  }
+  m_state = STATE_PRESENT;
+  m_last_uid = uid;
+  return true;
+}
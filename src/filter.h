@@ -0,0 +1,65 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <string>
+#include <stdint.h>
+
+/* What a poll has to report after filtering */
+enum FilterReport {
+  FILTER_NONE,
+  FILTER_ARRIVAL,
+  FILTER_DEPARTURE
+};
+
+/*
+ * Debounce of the card presence of a reader, fed with the raw presence of every poll.
+ * A card has to stay in the field for min_presence before it is reported, a departure is
+ * only reported after departure_grace without card and the same UID is not reported again
+ * within retap_window after its departure. Times in ns, 0 disables the filter.
+ * Only used on the main thread.
+ */
+class PresenceFilter {
+  public:
+    PresenceFilter();
+
+    /* Set the filter times in ms and start with an empty reader */
+    void configure(uint32_t min_presence_ms, uint32_t departure_grace_ms, uint32_t retap_window_ms);
+
+    /* True if any filter is configured */
+    bool active() const;
+
+    /* A card is in the field at now. Returns FILTER_ARRIVAL if it has to be reported, call accept then */
+    FilterReport present(uint64_t now);
+
+    /* No card is in the field at now. Returns FILTER_DEPARTURE if the departure has to be reported */
+    FilterReport absent(uint64_t now);
+
+    /* Checks the UID of an arrival against the retap window. Returns false if the arrival is suppressed */
+    bool accept(const std::string &uid, uint64_t now);
+
+  private:
+    enum State {
+      // No card
+      STATE_EMPTY,
+      // A card is in the field, not reported yet
+      STATE_ARRIVING,
+      // The card is reported
+      STATE_PRESENT,
+      // The reported card left the field, the departure is not reported yet
+      STATE_LEAVING,
+      // A card is in the field and was not reported because of the retap window
+      STATE_SUPPRESSED
+    };
+
+    uint64_t m_min_presence;
+    uint64_t m_departure_grace;
+    uint64_t m_retap_window;
+    State m_state;
+    uint64_t m_since;
+    std::string m_last_uid;
+    uint64_t m_last_departure;
+};
+
+#endif // FILTER_H
@@ -0,0 +1,239 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include <deque>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <uv.h>
+
+#include "jobs.h"
+#include "desfire.h"
+#include "autoread.h"
+#include "addon.h"
+#include "utils.h"
+
+/* A queued provision job */
+struct Job {
+  uint32_t id;
+  DesfireProvisionSpec spec;
+  Nan::Persistent<v8::Function> callback;
+};
+
+/* A job running on a reader. Only the card is touched on the worker thread */
+struct JobWork {
+  JobWork() : job(NULL), reader(NULL), card(NULL), blank(false), failed(false), ndef_max_len(0), ndef_mapping(0), start(0), end(0) {
+    req.data = this;
+  }
+
+  uv_work_t req;
+  Job *job;
+  ReaderData *reader;
+  DesfireData *card;
+  bool blank;
+  bool failed;
+  MifareError error;
+  std::string uid;
+  uint16_t ndef_max_len;
+  int ndef_mapping;
+  uint64_t start;
+  uint64_t end;
+};
+
+JobQueue::~JobQueue() {
+  for(std::deque<Job *>::iterator job = pending.begin(); job != pending.end(); ++job) {
+    (*job)->callback.Reset();
+    delete *job;
+  }
+  pending.clear();
+}
+
+bool JobsRunning(const AddonData *addon) {
+  return addon->jobs.running != 0;
+}
+
+/* A fresh card has no application besides the PICC level */
+static bool job_blank(DesfireGuardTag &tag) {
+  MifareDESFireAID *aids = NULL;
+  size_t count = 0;
+  try {
+    tag.retry(0x12335, "List applications",
+              [&]()mutable->res_t{return mifare_desfire_get_application_ids(tag, &aids, &count);});
+  } catch(MifareError err) {
+    // The directory is protected, so the card is in use
+    return false;
+  }
+  mifare_desfire_free_application_ids(aids);
+  return count == 0;
+}
+
+/* Runs on a thread of the libuv pool */
+static void job_work(uv_work_t *req) {
+  JobWork *work = static_cast<JobWork *>(req->data);
+  work->start = uv_hrtime();
+  try {
+    DesfireGuardTag tag(work->card);
+    char *uid = freefare_get_tag_uid(tag);
+    if(uid) {
+      work->uid = uid;
+      free(uid);
+    }
+    work->blank = job_blank(tag);
+    if(work->blank) {
+      DesfireProvisionCard(tag, work->job->spec, work->ndef_max_len, work->ndef_mapping);
+    }
+  } catch(MifareError err) {
+    work->failed = true;
+    work->error = err;
+  }
+  work->end = uv_hrtime();
+}
+
+/* Back on the main thread */
+static void job_after(uv_work_t *req, int status) {
+  Nan::HandleScope scope;
+  JobWork *work = static_cast<JobWork *>(req->data);
+  ReaderData *reader = work->reader;
+  Job *job = work->job;
+  JobQueue &jobs = reader->addon->jobs;
+  --jobs.running;
+  reader->reading = false;
+
+  if(reader->addon->cleanup) {
+    // The environment exits, nobody is left to report to
+    delete work->card;
+    job->callback.Reset();
+    delete job;
+    delete work;
+    return;
+  }
+  JobReaderStats &reader_stats = jobs.stats[reader->name];
+  if(!work->blank && !work->failed) {
+    // Not a blank card: the job waits for the next one, the card goes to the listen callback as usual
+    jobs.pending.push_front(job);
+    reader_stats.skipped++;
+    // The tags stay alive for the card object, or are freed with the last reference below
+    TagsPtr tags = work->card->tags;
+    FreefareTag tag = work->card->tag;
+    delete work->card;
+    if(AutoReadDispatch(reader, tags, tag)) {
+      // Reported with the data read
+    } else if(!reader->callback.IsEmpty()) {
+      v8::Local<v8::Object> reader_obj = Nan::New(reader->self);
+      reader_obj->Set(Nan::New("status").ToLocalChecked(), Nan::New("present").ToLocalChecked());
+      callCallback(reader, Nan::Undefined(), reader_obj, DesfireCreate(reader, tags, tag));
+    }
+    delete work;
+    return;
+  }
+  delete work->card;
+
+  if(!reader_stats.first) {
+    reader_stats.first = work->start;
+  }
+  reader_stats.last = work->end;
+  reader_stats.busy += work->end - work->start;
+
+  const unsigned argc = 2;
+  v8::Local<v8::Value> argv[argc] = { Nan::Undefined(), Nan::Undefined() };
+  if(work->failed) {
+    reader_stats.failed++;
+    v8::Local<v8::Array> errors = Nan::New<v8::Array>();
+    v8::Local<v8::Object> error = errorObject(work->error);
+    error->Set(Nan::New("reader").ToLocalChecked(), Nan::New(reader->name.c_str()).ToLocalChecked());
+    error->Set(Nan::New("uid").ToLocalChecked(), Nan::New(work->uid.c_str()).ToLocalChecked());
+    errors->Set(0, error);
+    argv[0] = errors;
+  } else {
+    reader_stats.done++;
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    result->Set(Nan::New("id").ToLocalChecked(), Nan::New(job->id));
+    result->Set(Nan::New("reader").ToLocalChecked(), Nan::New(reader->name.c_str()).ToLocalChecked());
+    result->Set(Nan::New("uid").ToLocalChecked(), Nan::New(work->uid.c_str()).ToLocalChecked());
+    result->Set(Nan::New("maxLength").ToLocalChecked(), Nan::New(work->ndef_max_len));
+    result->Set(Nan::New("mapping").ToLocalChecked(), Nan::New(work->ndef_mapping));
+    result->Set(Nan::New("time").ToLocalChecked(), Nan::New((work->end - work->start) / 1e6));
+    argv[1] = result;
+  }
+  if(!job->callback.IsEmpty()) {
+    reader_call(reader, Nan::New<v8::Function>(job->callback), argc, argv);
+  }
+  job->callback.Reset();
+  delete job;
+  delete work;
+}
+
+bool JobDispatch(ReaderData *reader, const TagsPtr &tags, FreefareTag tag) {
+  JobQueue &jobs = reader->addon->jobs;
+  // A job takes the whole tag list, so only single cards are taken
+  if(jobs.pending.empty() || !tags || tags.get()[0] != tag || tags.get()[1] != NULL) {
+    return false;
+  }
+  JobWork *work = new JobWork();
+  work->job = jobs.pending.front();
+  jobs.pending.pop_front();
+  work->reader = reader;
+  work->card = new DesfireData(reader, tags);
+  work->card->tag = tag;
+  // The reader is not polled while the job holds the card
+  reader->reading = true;
+  ++jobs.running;
+  uv_queue_work(reader->addon->loop, &work->req, job_work, job_after);
+  return true;
+}
+
+void JobEnqueue(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  JobQueue &jobs = AddonData_from_info(info)->jobs;
+  try {
+    if(info.Length()<1 || info.Length()>2 || (info.Length()==2 && !info[1]->IsFunction())) {
+      throw errorResult(info, 0x12302, "The arguments are the provision options {piccKey, appKey, ndef, layout} and an optional callback(err, result)");
+    }
+    Job *job = new Job();
+    try {
+      DesfireProvisionOptions(info, info[0], job->spec);
+    } catch(MifareError err) {
+      delete job;
+      throw;
+    }
+    job->id = jobs.next_id++;
+    if(info.Length()==2) {
+      job->callback.Reset(info[1].As<v8::Function>());
+    }
+    jobs.pending.push_back(job);
+    validResult(info, Nan::New(job->id));
+  } catch(MifareError err) {
+    // The error is already assigned to the InfoScope
+  }
+}
+
+void JobStats(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  const JobQueue &jobs = AddonData_from_info(info)->jobs;
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  v8::Local<v8::Object> readers = Nan::New<v8::Object>();
+  uint64_t done = 0, first = 0, last = 0;
+  for(std::map<std::string, JobReaderStats>::const_iterator i = jobs.stats.begin(); i != jobs.stats.end(); ++i) {
+    const JobReaderStats &s = i->second;
+    v8::Local<v8::Object> reader = Nan::New<v8::Object>();
+    reader->Set(Nan::New("done").ToLocalChecked(), Nan::New<v8::Number>(s.done));
+    reader->Set(Nan::New("failed").ToLocalChecked(), Nan::New<v8::Number>(s.failed));
+    reader->Set(Nan::New("skipped").ToLocalChecked(), Nan::New<v8::Number>(s.skipped));
+    reader->Set(Nan::New("busy").ToLocalChecked(), Nan::New<v8::Number>(s.busy / 1e6));
+    reader->Set(Nan::New("cardsPerMinute").ToLocalChecked(),
+                Nan::New<v8::Number>(s.last > s.first ? s.done * 6e10 / (s.last - s.first) : 0));
+    readers->Set(Nan::New(i->first.c_str()).ToLocalChecked(), reader);
+    done += s.done;
+    if(s.first && (!first || s.first < first)) {
+      first = s.first;
+    }
+    if(s.last > last) {
+      last = s.last;
+    }
+  }
+  result->Set(Nan::New("pending").ToLocalChecked(), Nan::New<v8::Number>(jobs.pending.size()));
+  result->Set(Nan::New("running").ToLocalChecked(), Nan::New(jobs.running));
+  result->Set(Nan::New("done").ToLocalChecked(), Nan::New<v8::Number>(done));
+  result->Set(Nan::New("cardsPerMinute").ToLocalChecked(),
+              Nan::New<v8::Number>(last > first ? done * 6e10 / (last - first) : 0));
+  result->Set(Nan::New("readers").ToLocalChecked(), readers);
+  validResult(info, result);
+}
@@ -0,0 +1,69 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <nan.h>
+#include <deque>
+#include <map>
+#include <string>
+
+#include "backend.h"
+#include "card.h"
+#include "reader.h"
+
+struct Job;
+struct AddonData;
+
+/* Throughput and failures of one reader */
+struct JobReaderStats {
+  JobReaderStats() : done(0), failed(0), skipped(0), busy(0), first(0), last(0) {}
+  uint64_t done;
+  uint64_t failed;
+  // Cards which were not blank and went to the listen callback instead
+  uint64_t skipped;
+  // Time spent in jobs in ns
+  uint64_t busy;
+  uint64_t first;
+  uint64_t last;
+};
+
+/*
+ * The job queue of one addon instance.
+ * Only used on the thread of the instance: jobs are dispatched from the poll timers
+ * and finished in the after work callback.
+ */
+struct JobQueue {
+  JobQueue() : running(0), next_id(1) {}
+  /* Drops the pending jobs without calling their callbacks */
+  ~JobQueue();
+
+  std::deque<Job *> pending;
+  std::map<std::string, JobReaderStats> stats;
+  unsigned int running;
+  uint32_t next_id;
+};
+
+/**
+ * Offer a freshly detected DESFire card to the job queue.
+ * Called by the poll of the backends before the card is reported to javascript.
+ * @param reader The reader which detected the card
+ * @param tags The tag list of the card, the job owns it if the card is taken
+ * @param tag The card
+ * @return true if a job was started for the card
+ **/
+bool JobDispatch(ReaderData *reader, const TagsPtr &tags, FreefareTag tag);
+
+/**
+ * True while jobs are running on reader threads.
+ * The readers must not be destroyed then.
+ **/
+bool JobsRunning(const AddonData *addon);
+
+/** mifare.enqueueJob(spec, [callback]): Queue a provision job for the next blank card on any reader */
+void JobEnqueue(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+/** mifare.jobStats(): Pending and running jobs, throughput and failures per reader */
+void JobStats(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+#endif // JOBS_H
@@ -0,0 +1,272 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include <map>
+#include <string>
+#include <uv.h>
+#include <node_buffer.h>
+
+#include "keys.h"
+#include "utils.h"
+
+/* The registry of shared keys. Accessed from the main thread and the worker threads */
+static uv_once_t registry_once = UV_ONCE_INIT;
+static uv_mutex_t registry_lock;
+static std::map<uint32_t, KeyPtr> registry;
+static uint32_t registry_next = 1;
+
+static void registry_init() {
+  uv_mutex_init(&registry_lock);
+}
+
+/* Scope guard for the registry */
+class GuardRegistry {
+  public:
+    GuardRegistry() {
+      uv_once(&registry_once, registry_init);
+      uv_mutex_lock(&registry_lock);
+    }
+
+    ~GuardRegistry() {
+      uv_mutex_unlock(&registry_lock);
+    }
+};
+
+uint32_t key_length(KeyType type) {
+  switch(type) {
+    case KEY_TYPE_3DES:
+    case KEY_TYPE_AES:
+      return 16;
+    case KEY_TYPE_3K3DES:
+      return 24;
+    case KEY_TYPE_DES:
+    default:
+      return 8;
+  }
+}
+
+const char *key_type_name(KeyType type) {
+  switch(type) {
+    case KEY_TYPE_3DES: return "3des";
+    case KEY_TYPE_3K3DES: return "3k3des";
+    case KEY_TYPE_AES: return "aes";
+    case KEY_TYPE_DES:
+    default: return "des";
+  }
+}
+
+KeyPtr key_new(const uint8_t *data, KeyType type, bool version, uint8_t aes_version) {
+  typedef MifareDESFireKey (*callback_t)(const uint8_t *);
+  static const callback_t callbacks[3][2] = {
+    {mifare_desfire_des_key_new, mifare_desfire_des_key_new_with_version},
+    {mifare_desfire_3des_key_new, mifare_desfire_3des_key_new_with_version},
+    {mifare_desfire_3k3des_key_new, mifare_desfire_3k3des_key_new_with_version}
+  };
+  MifareDESFireKey key;
+  if(type == KEY_TYPE_AES) {
+    key = version ? mifare_desfire_aes_key_new_with_version(data, aes_version) : mifare_desfire_aes_key_new(data);
+  } else {
+    key = callbacks[type][version](data);
+  }
+  if(!key) {
+    return KeyPtr();
+  }
+  return std::make_shared<DesfireKey>(key, type, version);
+}
+
+KeyPtr key_default() {
+  static const uint8_t null[8] = {0,0,0,0,0,0,0,0};
+  static KeyPtr key = key_new(null, KEY_TYPE_DES, true);
+  return key;
+}
+
+uint32_t key_register(KeyPtr key) {
+  GuardRegistry guard;
+  uint32_t handle = registry_next++;
+  registry[handle] = key;
+  return handle;
+}
+
+KeyPtr key_lookup(uint32_t handle) {
+  GuardRegistry guard;
+  std::map<uint32_t, KeyPtr>::const_iterator iter = registry.find(handle);
+  if(iter == registry.end()) {
+    return KeyPtr();
+  }
+  return iter->second;
+}
+
+bool key_release(uint32_t handle) {
+  GuardRegistry guard;
+  return registry.erase(handle) != 0;
+}
+
+/* Reads the key bytes of an array or buffer into key_val. Returns false if the length or a value does not fit */
+static bool key_bytes(v8::Local<v8::Value> value, uint8_t *key_val, uint32_t len) {
+  if(node::Buffer::HasInstance(value)) {
+    if(node::Buffer::Length(value) != len) {
+      return false;
+    }
+    memcpy(key_val, node::Buffer::Data(value), len);
+    return true;
+  }
+  if(!value->IsArray()) {
+    return false;
+  }
+  v8::Local<v8::Array> key = v8::Local<v8::Array>::Cast(value);
+  if(key->Length() != len) {
+    return false;
+  }
+  for(uint32_t i=0; i<len; i++) {
+    v8::Local<v8::Value> k = key->Get(i);
+    if(!k->IsInt32() || Nan::To<int32_t>(k).FromJust()>255) {
+      return false;
+    }
+    key_val[i] = (uint8_t)(Nan::To<int32_t>(k).FromJust() & 0xFF);
+  }
+  return true;
+}
+
+/* Returns the registered key of a handle object or an empty pointer if value is not a handle */
+static KeyPtr key_from_handle(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> value) {
+  if(!value->IsObject() || value->IsArray() || node::Buffer::HasInstance(value)) {
+    return KeyPtr();
+  }
+  v8::Local<v8::Object> obj = v8::Local<v8::Object>::Cast(value);
+  v8::Local<v8::Value> handle = Nan::GetPrivate(obj, Nan::New("key").ToLocalChecked()).ToLocalChecked();
+  if(!handle->IsUint32()) {
+    return KeyPtr();
+  }
+  KeyPtr key = key_lookup(Nan::To<uint32_t>(handle).FromJust());
+  if(!key) {
+    throw errorResult(info, 0x12333, "The key handle was released");
+  }
+  return key;
+}
+
+KeyPtr key_from_args(const Nan::FunctionCallbackInfo<v8::Value> &info, int offset) {
+  uint8_t key_val[24];
+  bool version = false;
+  uint8_t aes_ver = 0;
+  KeyType type = KEY_TYPE_DES;
+  int argc = info.Length() - offset;
+  std::string error = (
+    "This function takes a key handle from createKey or up to four arguments. "
+    "The first is the key an must be an array or buffer of 8, 16 or 24 bytes, depending on the type. "
+    "The second is the type a string out of (des|3des|3k3des|aes) which defines also the length of the key. "
+    "If you choose \"des\" the key is 8 numbers long. If you choose 3des or aes it is 16 numbers long. "
+    "For 3k3des it has to be 24 numbers long. it will default to \"des\"."
+    "The third is version a boolean describing wether the key is versioned. It will default to false"
+    "If you choose to use an \"aes\" key the fourth argument is the aes version a number smaller 255"
+  );
+  if(argc == 1) {
+    KeyPtr key = key_from_handle(info, info[offset]);
+    if(key) {
+      return key;
+    }
+  }
+  if(argc<=0 || argc>4 ||
+      (argc>1 && !info[offset+1]->IsString()) ||
+      (argc>2 && !info[offset+2]->IsBoolean()) ||
+      (argc>3 && !info[offset+3]->IsUint32()) ||
+      (argc>3 && Nan::To<uint32_t>(info[offset+3]).FromJust()>255)
+    ) {
+    throw errorResult(info, 0x12302, error);
+  }
+
+  if(argc>2) {
+    version = info[offset+2]->BooleanValue();
+  }
+  if(argc>1) {
+    v8::Local<v8::String> t = v8::Local<v8::String>::Cast(info[offset+1]);
+    if(t->Equals(Nan::New("aes").ToLocalChecked())) {
+      type = KEY_TYPE_AES;
+    } else if(t->Equals(Nan::New("3k3des").ToLocalChecked())) {
+      type = KEY_TYPE_3K3DES;
+    } else if(t->Equals(Nan::New("3des").ToLocalChecked())) {
+      type = KEY_TYPE_3DES;
+    }
+  }
+  if(type == KEY_TYPE_AES && argc>3) {
+    aes_ver = (uint8_t)(Nan::To<uint32_t>(info[offset+3]).FromJust()&0xFF);
+    version = true;
+  }
+
+  if(!key_bytes(info[offset], key_val, key_length(type))) {
+    throw errorResult(info, 0x12302, error);
+  }
+  KeyPtr key = key_new(key_val, type, version, aes_ver);
+  memset(key_val, 0, sizeof(key_val));
+  if(!key) {
+    throw errorResult(info, 0x12334, "Allocation of the key failed");
+  }
+  return key;
+}
+
+KeyPtr key_from_value(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> value, int pos_code) {
+  uint8_t key_val[24];
+  KeyPtr key = key_from_handle(info, value);
+  if(key) {
+    return key;
+  }
+  // Plain bytes are taken as versioned (3)DES key, the type follows from the length
+  KeyType types[] = {KEY_TYPE_DES, KEY_TYPE_3DES, KEY_TYPE_3K3DES};
+  for(size_t i = 0; i < sizeof(types)/sizeof(types[0]); i++) {
+    if(key_bytes(value, key_val, key_length(types[i]))) {
+      key = key_new(key_val, types[i], true);
+      memset(key_val, 0, sizeof(key_val));
+      if(!key) {
+        throw errorResult(info, 0x12334, "Allocation of the key failed");
+      }
+      return key;
+    }
+  }
+  throw errorResult(info, pos_code, "A key has to be a key handle from createKey or an array of 8, 16 or 24 bytes");
+}
+
+/* The registry entry of a key handle object, released with the object unless release() came first */
+struct KeyHandle {
+  uint32_t handle;
+  Nan::Persistent<v8::Object> self;
+};
+
+static void key_collected(const Nan::WeakCallbackInfo<KeyHandle> &info) {
+  KeyHandle *data = info.GetParameter();
+  key_release(data->handle);
+  data->self.Reset();
+  delete data;
+}
+
+void KeyCreate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  try {
+    KeyPtr key = key_from_args(info);
+    KeyHandle *data = new KeyHandle();
+    data->handle = key_register(key);
+    v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+    // A forgotten handle drops its key when it is collected, like the cards in card.h
+    data->self.Reset(obj);
+    data->self.SetWeak(data, key_collected, Nan::WeakCallbackType::kParameter);
+    Nan::SetPrivate(obj, Nan::New("key").ToLocalChecked(), Nan::New<v8::Uint32>(data->handle));
+    Nan::Set(obj, Nan::New("type").ToLocalChecked(), Nan::New(key_type_name(key->type)).ToLocalChecked());
+    Nan::Set(obj, Nan::New("version").ToLocalChecked(), Nan::New(key->version));
+    Nan::SetMethod(obj, "release", KeyRelease);
+    info.GetReturnValue().Set(obj);
+  } catch(MifareError err) {
+    // The error is already assigned to the InfoScope
+  }
+}
+
+void KeyRelease(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  try {
+    if(info.Length()!=0) {
+      throw errorResult(info, 0x12302, "This function takes no arguments");
+    }
+    v8::Local<v8::Value> handle = Nan::GetPrivate(info.This(), Nan::New("key").ToLocalChecked()).ToLocalChecked();
+    if(!handle->IsUint32() || !key_release(Nan::To<uint32_t>(handle).FromJust())) {
+      throw errorResult(info, 0x12333, "The key handle was released");
+    }
+    validTrue(info);
+  } catch(MifareError err) {
+    // The error is already assigned to the InfoScope
+  }
+}
@@ -0,0 +1,124 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef KEYS_H
+#define KEYS_H
+
+#include <nan.h>
+#include <memory>
+#include <stdint.h>
+
+#include "backend.h"
+
+/* Key types. The order matches the rows of the libfreefare key constructors */
+enum KeyType {
+  KEY_TYPE_DES = 0,
+  KEY_TYPE_3DES = 1,
+  KEY_TYPE_3K3DES = 2,
+  KEY_TYPE_AES = 3
+};
+
+/*
+ * A DESFire key with its key schedule derived once at creation.
+ * The key is never changed after creation, so one instance can be used
+ * by any number of cards, readers and threads at the same time.
+ * It is freed when the last card or registry entry drops it.
+ */
+class DesfireKey {
+  public:
+    DesfireKey(MifareDESFireKey key, KeyType type, bool version) : key(key), type(type), version(version) {}
+
+    ~DesfireKey() {
+      if(key) {
+        mifare_desfire_key_free(key);
+      }
+    }
+
+    /* The key is implicite usable as MifareDESFireKey */
+    operator MifareDESFireKey() const {
+      return key;
+    }
+
+    const MifareDESFireKey key;
+    const KeyType type;
+    const bool version;
+
+  private:
+    DesfireKey(const DesfireKey &);
+    DesfireKey &operator=(const DesfireKey &);
+};
+
+typedef std::shared_ptr<DesfireKey> KeyPtr;
+
+/**
+ * Number of key bytes of a key type
+ * @param type The key type
+ * @return 8, 16 or 24
+ **/
+uint32_t key_length(KeyType type);
+
+/**
+ * Name of a key type as used in javascript (des|3des|3k3des|aes)
+ * @param type The key type
+ **/
+const char *key_type_name(KeyType type);
+
+/**
+ * Create a new key
+ * @param data The key bytes, key_length(type) long
+ * @param type The key type
+ * @param version Wether the key is versioned (parity bits of des keys)
+ * @param aes_version The version of an aes key
+ * @return The key or an empty pointer if libfreefare failed to allocate it
+ **/
+KeyPtr key_new(const uint8_t *data, KeyType type, bool version, uint8_t aes_version = 0);
+
+/**
+ * The all zero versioned DES key. Default key of every card and of the NDEF applications.
+ * Created once and shared.
+ **/
+KeyPtr key_default();
+
+/**
+ * Add a key to the registry
+ * @return The handle to reference the key
+ **/
+uint32_t key_register(KeyPtr key);
+
+/**
+ * Get a registered key
+ * @param handle The handle returned by key_register
+ * @return The key or an empty pointer if the handle is unknown or released
+ **/
+KeyPtr key_lookup(uint32_t handle);
+
+/**
+ * Remove a key from the registry. Cards already using the key keep it until they are freed.
+ * @return false if the handle was unknown
+ **/
+bool key_release(uint32_t handle);
+
+/**
+ * Get a key from javascript arguments, either a key handle object from createKey
+ * or the arguments (key, type, version, aesVersion) of createKey.
+ * Throws an errorResult on invalid arguments.
+ * @param info The javascript arguments
+ * @param offset The index of the first key argument
+ **/
+KeyPtr key_from_args(const Nan::FunctionCallbackInfo<v8::Value> &info, int offset = 0);
+
+/**
+ * Get a key from a single javascript value, a key handle object or an array/buffer of a des key.
+ * Throws an errorResult with pos_code on invalid values.
+ **/
+KeyPtr key_from_value(const Nan::FunctionCallbackInfo<v8::Value> &info, v8::Local<v8::Value> value, int pos_code);
+
+/**
+ * mifare.createKey(key, type, version, aesVersion): Create a shared key handle.
+ * The key leaves the registry with release() or when the handle object is garbage collected.
+ **/
+void KeyCreate(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+/** key.release(): Remove the key from the registry */
+void KeyRelease(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+#endif // KEYS_H
@@ -0,0 +1,93 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <uv.h>
+
+/*
+ * A cache of values keyed by the card UID, holding a limited number of cards.
+ * The least recently used card is dropped first.
+ * The functions expect the lock to be held, see LruCache::Guard. The caches live as long as the process.
+ */
+template<class Value>
+class LruCache {
+  public:
+    /* Scope guard for the lock of a cache */
+    class Guard {
+      public:
+        Guard(LruCache &cache) : m_cache(cache) {
+          uv_mutex_lock(&m_cache.m_lock);
+        }
+
+        ~Guard() {
+          uv_mutex_unlock(&m_cache.m_lock);
+        }
+
+      private:
+        LruCache &m_cache;
+    };
+
+    LruCache(size_t capacity) : m_capacity(capacity) {
+      uv_mutex_init(&m_lock);
+    }
+
+    /* The value of a card, NULL if the card is unknown. Marks the card as used */
+    Value *find(const std::string &uid) {
+      typename std::map<std::string, Entry>::iterator entry = m_entries.find(uid);
+      if(entry == m_entries.end()) {
+        return NULL;
+      }
+      m_use.splice(m_use.begin(), m_use, entry->second.use);
+      return &entry->second.value;
+    }
+
+    /* The value of a card, default constructed if the card is unknown. Marks the card as used */
+    Value &entry(const std::string &uid) {
+      Value *found = find(uid);
+      if(found) {
+        return *found;
+      }
+      if(m_entries.size() >= m_capacity) {
+        m_entries.erase(m_use.back());
+        m_use.pop_back();
+      }
+      m_use.push_front(uid);
+      typename std::map<std::string, Entry>::iterator entry = m_entries.insert(std::make_pair(uid, Entry())).first;
+      entry->second.use = m_use.begin();
+      return entry->second.value;
+    }
+
+    /* Forget a card */
+    void erase(const std::string &uid) {
+      typename std::map<std::string, Entry>::iterator entry = m_entries.find(uid);
+      if(entry != m_entries.end()) {
+        m_use.erase(entry->second.use);
+        m_entries.erase(entry);
+      }
+    }
+
+    /* Forget all cards */
+    void clear() {
+      m_entries.clear();
+      m_use.clear();
+    }
+
+  private:
+    struct Entry {
+      Value value;
+      // Position in the usage list
+      std::list<std::string>::iterator use;
+    };
+
+    size_t m_capacity;
+    uv_mutex_t m_lock;
+    std::map<std::string, Entry> m_entries;
+    // Most recently used first
+    std::list<std::string> m_use;
+};
+
+#endif // LRU_CACHE_H
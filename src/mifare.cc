@@ -9,131 +9,122 @@
 
 
 #include "reader.h"
+#include "keys.h"
+#include "jobs.h"
+#include "autoread.h"
+#include "events.h"
+#include "card_cache.h"
+#include "call_watch.h"
+#include "addon.h"
 #include "utils.h"
-
-/**
- * plugin global secure card context
- **/
-#if defined(USE_LIBNFC)
-#include <signal.h>
-
-#define mifare_init nfc_init
-#define mifare_exit nfc_exit
-typedef nfc_context mifare_context;
-
-#else
-#define mifare_init pcsc_init
-#define mifare_exit pcsc_exit
-typedef pcsc_context mifare_context;
+#if defined(USE_MOCK)
+#include "mock/mock.h"
 #endif
 
-static mifare_context *context = NULL;
-static std::vector<ReaderData *> readers_data;
-static Nan::Persistent<v8::Object> readers_global(Nan::New<v8::Object>());
+/* Name of a reader in a report of the call watch */
+static void ReaderSubject(v8::Local<v8::Object> reader, std::string &name, std::string &uid) {
+  ReaderData *data = static_cast<ReaderData *>(
+    v8::Local<v8::External>::Cast(Nan::GetPrivate(reader, Nan::New("data").ToLocalChecked()).ToLocalChecked())->Value());
+  name = data->name;
+}
 
+/**
+ * Establishes the context of one backend and adds its readers to the reader object
+ * @param addon The instance the readers belong to
+ * @param readers The javascript object the readers are added to, keyed by name
+ * @return false if the backend has no context or could not list its readers
+ **/
+template<class Backend>
+bool list_readers(AddonData *addon, v8::Local<v8::Object> readers) {
+  std::vector<std::string> names;
+  if(!Backend::open(addon) || !Backend::list(addon, names)) {
+    return false;
+  }
+  for(std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name) {
+    addon->readers.push_back(new ReaderData(name->c_str(), Backend::id, addon));
+    // Node Object:
+    v8::Local<v8::External> data = Nan::New<v8::External>(addon->readers.back());
+    v8::Local<v8::Object> reader = Nan::New<v8::Object>();
+    Nan::Set(reader, Nan::New("name").ToLocalChecked(), Nan::New(name->c_str()).ToLocalChecked());
+    Nan::Set(reader, Nan::New("backend").ToLocalChecked(), Nan::New(Backend::name()).ToLocalChecked());
+    watch_method(reader, "listen", ReaderListen, ReaderSubject, addon);
+    watch_method(reader, "release", ReaderRelease, ReaderSubject, addon);
+    watch_method(reader, "events", ReaderEvents, ReaderSubject, addon);
+    Nan::Set(readers, Nan::New(name->c_str()).ToLocalChecked(), reader);
+    Nan::SetPrivate(reader, Nan::New("data").ToLocalChecked(), data);
+  }
+  return true;
+}
 
 /**
- * Get Names of the Readers connected to the computer
- * @param hContext The SCard Context used to search
- * @return An Array of Strings with reader names
+ * Get the readers connected to the computer
+ * @param backend Optional name of the backend to search ("pcsc" or "libnfc"), all compiled in backends otherwise
+ * @return An Object of reader objects keyed by the reader name
  **/
 void getReader(const Nan::FunctionCallbackInfo<v8::Value>& info) {
-#if defined(USE_LIBNFC)
-  const size_t MAX_READERS = 16;
-  size_t numDevices;
-  nfc_connstring reader_names[MAX_READERS];
-#else
-  LONG res;
-  char *reader_names;
-#endif
-  char *reader_iter = NULL;
-  int   reader_count = 0;
-  // Allocate buffer. We assume autoallocate is not present (on Mac OS X anyway)
-  v8::Local<v8::Object> readers_local = Nan::New<v8::Object>(readers_global);
-
-  if(info.Length() > 0){
-    Nan::ThrowError("This function does not take any arguments");
-    return;
-  }
+  AddonData *addon = AddonData_from_info(info);
+  std::string backend;
+  bool found = false;
+  v8::Local<v8::Object> readers_local = Nan::New<v8::Object>(addon->readers_object);
 
-  if(context) {
-    mifare_exit(context);
-  }
-  mifare_init(&context);
-  if(!context) {
-    Nan::ThrowError("Cannot establish context");
+  if(info.Length() > 1 || (info.Length() == 1 && !info[0]->IsString())) {
+    Nan::ThrowError("This function takes an optional backend name (\"pcsc\" or \"libnfc\")");
     return;
   }
-#if defined(USE_LIBNFC)
-  numDevices = nfc_list_devices(context, reader_names, MAX_READERS);
-  if(numDevices == 0) {
-    info.GetReturnValue().Set(Nan::New<v8::Object>(readers_global));
-    return;
+  if(info.Length() == 1) {
+    backend = std::string(*Nan::Utf8String(info[0]));
   }
-#else
-  res = pcsc_list_devices(context, &reader_names);
-  if(res != SCARD_S_SUCCESS || reader_names[0] == '\0') {
-    Nan::ThrowError("Unable to list readers");
+
+  if(JobsRunning(addon) || AutoReadRunning(addon) || addon->reopens) {
+    Nan::ThrowError("Jobs or reads are still running on the readers");
     return;
   }
-#endif
 
-  // Clean before use
-  for(std::vector<ReaderData *>::iterator iter = readers_data.begin();iter!=readers_data.end();iter++) {
-    ReaderData *data = *iter;
-    if(data) {
-      delete data;
-    }
-    *iter = NULL;
-  }
-  readers_data.clear();
+  // Clean before use, the readers hold handles of the contexts which are reestablished below
+  addon_drop_readers(addon);
 
-  // Get number of readers from null separated string
-#if defined(USE_LIBNFC)
-  reader_iter = reader_names[0];
-  char *names_end = reader_names[0] + (MAX_READERS * sizeof(nfc_connstring));
-  while(reader_iter <= names_end) {
-    // see if we can claim it
-    nfc_device *dev = NULL;
-    dev = nfc_open(context, reader_iter);
-    if (dev == NULL) {
-      // XXX: failed to open connstring
-      reader_iter += sizeof(nfc_connstring);
-      continue;
-    }
-    std::cout << "Found device: " << nfc_device_get_name(dev) << std::endl;
-    nfc_close(dev);
-#else
-  reader_iter = reader_names;
-  while(*reader_iter != '\0') {
+#if defined(HAVE_PCSC)
+  if(backend.empty() || backend == PcscBackend::name()) {
+    found = list_readers<PcscBackend>(addon, readers_local) || found;
+  }
 #endif
-    readers_data.push_back(new ReaderData(reader_iter, context));
-    // Node Object:
-    v8::Local<v8::External> data = Nan::New<v8::External>(readers_data.back());
-    v8::Local<v8::Object> reader = Nan::New<v8::Object>();
-    Nan::Set(reader, Nan::New("name").ToLocalChecked(), Nan::New(reader_iter).ToLocalChecked());
-    Nan::SetMethod(reader, "listen", ReaderListen);
-    Nan::SetMethod(reader, "release", ReaderRelease);
-    Nan::Set(readers_local, Nan::New(reader_iter).ToLocalChecked(), reader);
-    Nan::SetPrivate(reader, Nan::New("data").ToLocalChecked(), data);
-#if defined(USE_LIBNFC)
-    reader_iter += sizeof(nfc_connstring);
-#else
-    reader_iter += strlen(reader_iter)+1;
-    reader_count++;
+#if defined(HAVE_LIBNFC)
+  if(backend.empty() || backend == NfcBackend::name()) {
+    found = list_readers<NfcBackend>(addon, readers_local) || found;
+  }
 #endif
+  if(!found) {
+    Nan::ThrowError("Unable to list readers");
+    return;
   }
   info.GetReturnValue().Set(readers_local);
   return;
 }
 
 /**
- * Node.js NaN initialization function
+ * Node.js NaN initialization function.
+ * Runs once per context loading the addon, the main thread and each worker thread get their own instance.
  **/
 
 NAN_MODULE_INIT(init) {
-  Nan::Export(target, "getReader", getReader);
+  AddonData *addon = new AddonData(Nan::GetCurrentEventLoop());
+  addon_export(target, "getReader", getReader, addon);
   Nan::Export(target, "setSleep", mifare_set_sleep);
+  Nan::Export(target, "createKey", KeyCreate);
+  Nan::Export(target, "setCardCache", card_cache_configure);
+  addon_export(target, "enqueueJob", JobEnqueue, addon);
+  addon_export(target, "jobStats", JobStats, addon);
+  addon_export(target, "watchCalls", WatchCalls, addon);
+#if defined(USE_MOCK)
+  MockInit(target);
+#endif
+#if NODE_VERSION_AT_LEAST(10, 2, 0)
+  node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), addon_cleanup, addon);
+#endif
 }
 
-NODE_MODULE(node_mifare, init)
+#if defined(USE_MOCK)
+NAN_MODULE_WORKER_ENABLED(node_mifare_mock, init)
+#else
+NAN_MODULE_WORKER_ENABLED(node_mifare, init)
+#endif
@@ -9,18 +9,7 @@
 #include <iostream>
 #include <cstring>
 
-#ifndef USE_LIBNFC
-#if defined(__APPLE__) || defined(__linux__)
-#include <PCSC/winscard.h>
-#include <PCSC/wintypes.h>
-#else
-#include <winscard.h>
-#endif
-#include <freefare_pcsc.h>
-#else // USE_LIBNFC
-#include <nfc/nfc.h>
-#include <freefare_nfc.h>
-#endif // USE_LIBNFC
+#include "backend.h"
 
 
 /**
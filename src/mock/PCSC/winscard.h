@@ -0,0 +1,72 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+// Mock of the subset of the PC/SC API used by node-mifare.
+// Only used by the node_mifare_mock target (USE_MOCK).
+#ifndef MOCK_PCSC_WINSCARD_H
+#define MOCK_PCSC_WINSCARD_H
+
+#include "wintypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef LONG SCARDCONTEXT;
+typedef LONG SCARDHANDLE;
+
+#define MAX_ATR_SIZE 33
+
+typedef SCARDHANDLE *LPSCARDHANDLE;
+
+typedef struct {
+  unsigned long dwProtocol;
+  unsigned long cbPciLength;
+} SCARD_IO_REQUEST;
+
+#define SCARD_SHARE_SHARED   0x0002
+#define SCARD_PROTOCOL_T0    0x0001
+#define SCARD_PROTOCOL_T1    0x0002
+#define SCARD_LEAVE_CARD     0x0000
+
+typedef struct {
+  const char *szReader;
+  void *pvUserData;
+  DWORD dwCurrentState;
+  DWORD dwEventState;
+  DWORD cbAtr;
+  unsigned char rgbAtr[MAX_ATR_SIZE];
+} SCARD_READERSTATE;
+
+#define SCARD_S_SUCCESS            ((LONG)0x00000000)
+#define SCARD_E_CANCELLED          ((LONG)0x80100002)
+#define SCARD_E_INVALID_HANDLE     ((LONG)0x80100003)
+#define SCARD_E_TIMEOUT            ((LONG)0x8010000A)
+#define SCARD_E_SHARING_VIOLATION  ((LONG)0x8010000B)
+#define SCARD_E_NO_SMARTCARD       ((LONG)0x8010000C)
+#define SCARD_E_NOT_READY          ((LONG)0x80100010)
+#define SCARD_E_UNKNOWN_READER     ((LONG)0x80100009)
+#define SCARD_E_INSUFFICIENT_BUFFER ((LONG)0x80100008)
+
+#define SCARD_STATE_UNAWARE     0x0000
+#define SCARD_STATE_IGNORE      0x0001
+#define SCARD_STATE_CHANGED     0x0002
+#define SCARD_STATE_UNKNOWN     0x0004
+#define SCARD_STATE_UNAVAILABLE 0x0008
+#define SCARD_STATE_EMPTY       0x0010
+#define SCARD_STATE_PRESENT     0x0020
+#define SCARD_STATE_ATRMATCH    0x0040
+#define SCARD_STATE_EXCLUSIVE   0x0080
+#define SCARD_STATE_INUSE       0x0100
+#define SCARD_STATE_MUTE        0x0200
+
+LONG SCardGetStatusChange(SCARDCONTEXT hContext, DWORD dwTimeout, SCARD_READERSTATE *rgReaderStates, DWORD cReaders);
+LONG SCardConnect(SCARDCONTEXT hContext, LPCSTR szReader, DWORD dwShareMode, DWORD dwPreferredProtocols, LPSCARDHANDLE phCard, LPDWORD pdwActiveProtocol);
+LONG SCardTransmit(SCARDHANDLE hCard, const SCARD_IO_REQUEST *pioSendPci, LPCBYTE pbSendBuffer, DWORD cbSendLength, SCARD_IO_REQUEST *pioRecvPci, LPBYTE pbRecvBuffer, LPDWORD pcbRecvLength);
+LONG SCardDisconnect(SCARDHANDLE hCard, DWORD dwDisposition);
+LONG SCardCancel(SCARDCONTEXT hContext);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOCK_PCSC_WINSCARD_H
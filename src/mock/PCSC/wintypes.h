@@ -0,0 +1,20 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+// Mock of the pcsc-lite type definitions used by node-mifare.
+// Only used by the node_mifare_mock target (USE_MOCK).
+#ifndef MOCK_PCSC_WINTYPES_H
+#define MOCK_PCSC_WINTYPES_H
+
+#include <stdint.h>
+
+typedef long LONG;
+typedef unsigned long DWORD;
+typedef DWORD *LPDWORD;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+typedef unsigned char BYTE;
+typedef BYTE *LPBYTE;
+typedef const BYTE *LPCBYTE;
+typedef void *LPVOID;
+
+#endif // MOCK_PCSC_WINTYPES_H
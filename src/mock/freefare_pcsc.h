@@ -0,0 +1,180 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+// Mock of the subset of libfreefare (pcsc flavour) used by node-mifare.
+// The signatures follow libfreefare, the implementation in mock.cc keeps
+// the cards in memory. Only used by the node_mifare_mock target (USE_MOCK).
+#ifndef MOCK_FREEFARE_PCSC_H
+#define MOCK_FREEFARE_PCSC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <PCSC/winscard.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum freefare_tag_type {
+  FELICA,
+  MIFARE_MINI,
+  MIFARE_CLASSIC_1K,
+  MIFARE_CLASSIC_4K,
+  MIFARE_DESFIRE,
+  MIFARE_ULTRALIGHT,
+  MIFARE_ULTRALIGHT_C,
+  NTAG_21x
+};
+
+struct freefare_tag;
+typedef struct freefare_tag *FreefareTag;
+
+struct mifare_desfire_aid;
+typedef struct mifare_desfire_aid *MifareDESFireAID;
+
+struct mifare_desfire_key;
+typedef struct mifare_desfire_key *MifareDESFireKey;
+
+typedef struct pcsc_context {
+  SCARDCONTEXT context;
+} pcsc_context;
+
+struct mifare_desfire_version_info {
+  struct {
+    uint8_t vendor_id;
+    uint8_t type;
+    uint8_t subtype;
+    uint8_t version_major;
+    uint8_t version_minor;
+    uint8_t storage_size;
+    uint8_t protocol;
+  } hardware;
+
+  struct {
+    uint8_t vendor_id;
+    uint8_t type;
+    uint8_t subtype;
+    uint8_t version_major;
+    uint8_t version_minor;
+    uint8_t storage_size;
+    uint8_t protocol;
+  } software;
+
+  uint8_t uid[7];
+  uint8_t batch_number[5];
+  uint8_t production_week;
+  uint8_t production_year;
+};
+
+// DESFire status codes
+#define OPERATION_OK          0x00
+#define NO_CHANGES            0x0C
+#define OUT_OF_EEPROM_ERROR   0x0E
+#define ILLEGAL_COMMAND_CODE  0x1C
+#define INTEGRITY_ERROR       0x1E
+#define NO_SUCH_KEY           0x40
+#define LENGTH_ERROR          0x7E
+#define PERMISSION_ERROR      0x9D
+#define PARAMETER_ERROR       0x9E
+#define APPLICATION_NOT_FOUND 0xA0
+#define AUTHENTICATION_ERROR  0xAE
+#define BOUNDARY_ERROR        0xBE
+#define COMMAND_ABORTED       0xCA
+#define DUPLICATE_ERROR       0xDE
+#define FILE_NOT_FOUND        0xF0
+
+// Communication settings
+#define MDCM_PLAIN      0x00
+#define MDCM_MACED      0x01
+#define MDCM_ENCIPHERED 0x03
+
+enum mifare_desfire_file_types {
+  MDFT_STANDARD_DATA_FILE = 0x00,
+  MDFT_BACKUP_DATA_FILE = 0x01,
+  MDFT_VALUE_FILE_WITH_BACKUP = 0x02,
+  MDFT_LINEAR_RECORD_FILE_WITH_BACKUP = 0x03,
+  MDFT_CYCLIC_RECORD_FILE_WITH_BACKUP = 0x04
+};
+
+struct mifare_desfire_file_settings {
+  uint8_t file_type;
+  uint8_t communication_settings;
+  uint16_t access_rights;
+  union {
+    struct {
+      uint32_t file_size;
+    } standard_file;
+    struct {
+      int32_t lower_limit;
+      int32_t upper_limit;
+      int32_t limited_credit_value;
+      uint8_t limited_credit_enabled;
+    } value_file;
+    struct {
+      uint32_t record_size;
+      uint32_t max_number_of_records;
+      uint32_t current_number_of_records;
+    } linear_record_file;
+  } settings;
+};
+
+LONG pcsc_init(pcsc_context **context);
+void pcsc_exit(pcsc_context *context);
+LONG pcsc_list_devices(pcsc_context *context, LPSTR *string);
+
+FreefareTag *freefare_get_tags_pcsc(pcsc_context *context, const char *reader);
+enum freefare_tag_type freefare_get_tag_type(FreefareTag tag);
+const char *freefare_get_tag_friendly_name(FreefareTag tag);
+char *freefare_get_tag_uid(FreefareTag tag);
+void freefare_free_tags(FreefareTag *tags);
+const char *freefare_strerror(FreefareTag tag);
+int freefare_internal_error(FreefareTag tag);
+void freefare_clear_internal_error(FreefareTag tag);
+
+MifareDESFireAID mifare_desfire_aid_new(uint32_t aid);
+uint32_t mifare_desfire_aid_get_aid(MifareDESFireAID aid);
+
+MifareDESFireKey mifare_desfire_des_key_new(const uint8_t value[8]);
+MifareDESFireKey mifare_desfire_3des_key_new(const uint8_t value[16]);
+MifareDESFireKey mifare_desfire_3k3des_key_new(const uint8_t value[24]);
+MifareDESFireKey mifare_desfire_aes_key_new(const uint8_t value[16]);
+MifareDESFireKey mifare_desfire_des_key_new_with_version(const uint8_t value[8]);
+MifareDESFireKey mifare_desfire_3des_key_new_with_version(const uint8_t value[16]);
+MifareDESFireKey mifare_desfire_3k3des_key_new_with_version(const uint8_t value[24]);
+MifareDESFireKey mifare_desfire_aes_key_new_with_version(const uint8_t value[16], uint8_t version);
+void mifare_desfire_key_free(MifareDESFireKey key);
+
+int mifare_desfire_connect(FreefareTag tag);
+int mifare_desfire_disconnect(FreefareTag tag);
+uint8_t mifare_desfire_last_picc_error(FreefareTag tag);
+
+int mifare_desfire_authenticate(FreefareTag tag, uint8_t key_no, MifareDESFireKey key);
+int mifare_desfire_change_key_settings(FreefareTag tag, uint8_t settings);
+int mifare_desfire_get_key_settings(FreefareTag tag, uint8_t *settings, uint8_t *max_keys);
+int mifare_desfire_get_key_version(FreefareTag tag, uint8_t key_no, uint8_t *version);
+int mifare_desfire_create_application(FreefareTag tag, MifareDESFireAID aid, uint8_t settings, uint8_t key_no);
+int mifare_desfire_create_application_iso(FreefareTag tag, MifareDESFireAID aid, uint8_t settings, uint8_t key_no, int want_iso_file_identifiers, uint16_t iso_file_id, uint8_t *iso_file_name, size_t iso_file_name_len);
+int mifare_desfire_select_application(FreefareTag tag, MifareDESFireAID aid);
+int mifare_desfire_get_application_ids(FreefareTag tag, MifareDESFireAID *aids[], size_t *count);
+void mifare_desfire_free_application_ids(MifareDESFireAID aids[]);
+int mifare_desfire_format_picc(FreefareTag tag);
+int mifare_desfire_get_version(FreefareTag tag, struct mifare_desfire_version_info *version_info);
+int mifare_desfire_free_mem(FreefareTag tag, uint32_t *size);
+int mifare_desfire_create_std_data_file(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size);
+int mifare_desfire_create_std_data_file_iso(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size, uint16_t iso_file_id);
+int mifare_desfire_create_backup_data_file(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size);
+int mifare_desfire_create_backup_data_file_iso(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size, uint16_t iso_file_id);
+int mifare_desfire_get_file_settings(FreefareTag tag, uint8_t file_no, struct mifare_desfire_file_settings *settings);
+int mifare_desfire_commit_transaction(FreefareTag tag);
+int mifare_desfire_abort_transaction(FreefareTag tag);
+ssize_t mifare_desfire_read_data(FreefareTag tag, uint8_t file_no, off_t offset, size_t length, void *data);
+ssize_t mifare_desfire_write_data(FreefareTag tag, uint8_t file_no, off_t offset, size_t length, const void *data);
+
+int mifare_ultralight_connect(FreefareTag tag);
+int mifare_ultralight_disconnect(FreefareTag tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOCK_FREEFARE_PCSC_H
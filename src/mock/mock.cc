@@ -0,0 +1,1214 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include <PCSC/winscard.h>
+#include <freefare_pcsc.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <uv.h>
+
+#include "mock.h"
+
+enum MockKeyType { KEY_DES, KEY_3DES, KEY_3K3DES, KEY_AES };
+
+/* A key as stored on the emulated card */
+struct MockKey {
+  int type;
+  uint8_t data[24];
+  uint8_t version;
+};
+
+/* A file on the emulated card */
+struct MockFile {
+  MockFile() : access_rights(0), iso_file_id(0), backup(false), dirty(false) {}
+  uint16_t access_rights;
+  // ISO 7816-4 file identifier, 0 for none
+  uint16_t iso_file_id;
+  std::vector<uint8_t> data;
+  // Backup data files are written to the mirror and only become visible on commit
+  bool backup;
+  bool dirty;
+  std::vector<uint8_t> mirror;
+};
+
+/* An application on the emulated card. AID 0 is the PICC level */
+struct MockApplication {
+  uint8_t settings;
+  std::vector<MockKey> keys;
+  std::map<uint8_t, MockFile> files;
+  // ISO 7816-4 DF name, empty for none
+  std::vector<uint8_t> iso_name;
+};
+
+/* An emulated DESFire EV1 card */
+struct MockCard {
+  struct mifare_desfire_version_info version;
+  std::map<uint32_t, MockApplication> apps;
+};
+
+/* An emulated reader with an optional card on it */
+struct MockReader {
+  MockReader(const std::string &name) : name(name), events(0), seen(0), event_time(0), pending(false), pending_time(0), iso_app(0), iso_file(-1), held(false) {}
+
+  std::string name;
+  std::shared_ptr<MockCard> card;
+  // Incremented on every insert and remove, reported in the high word of dwEventState like pcsc-lite
+  DWORD events;
+  // The events counter at the last reported state change
+  DWORD seen;
+  // uv_hrtime of the last insert or remove
+  uint64_t event_time;
+  // A reported state change which did not reach the callback yet
+  bool pending;
+  uint64_t pending_time;
+  // Application and file selected by ISO SELECT on the raw channel, -1 for no file
+  uint32_t iso_app;
+  int iso_file;
+  // Another PC/SC application holds the card exclusively, connects fail with a sharing violation
+  bool held;
+};
+
+struct freefare_tag {
+  std::shared_ptr<MockCard> card;
+  MockReader *reader;
+  bool active;
+  uint32_t selected;
+  // Number of the authenticated key in the selected application or -1
+  int authenticated;
+  int internal_error;
+  uint8_t last_picc_error;
+};
+
+struct mifare_desfire_aid {
+  uint32_t aid;
+};
+
+struct mifare_desfire_key {
+  int type;
+  uint8_t data[24];
+  uint8_t version;
+};
+
+namespace {
+
+const uint32_t STORAGE_SIZE = 8192;
+const uint8_t ACCESS_FREE = 0x0E;
+
+std::vector<MockReader> readers(1, MockReader("Mock Reader 00 00"));
+std::map<std::string, std::shared_ptr<MockCard> > cards;
+std::map<std::string, unsigned int> latencies;
+unsigned int default_latency = 0;
+std::string reader_names;
+unsigned long command_count = 0;
+unsigned long written_count = 0;
+
+/* Guards the readers against the tap storm thread. Cards are only touched by the loop thread */
+struct MockLock {
+  MockLock() { uv_mutex_init(&mutex); }
+  ~MockLock() { uv_mutex_destroy(&mutex); }
+  uv_mutex_t mutex;
+} lock;
+
+/* Scope guard of the reader lock */
+struct ReadersGuard {
+  ReadersGuard() { uv_mutex_lock(&lock.mutex); }
+  ~ReadersGuard() { uv_mutex_unlock(&lock.mutex); }
+};
+
+/* State of the tap storm thread */
+struct Storm {
+  Storm() : running(false), stop(false), rate(0), duration(0) {}
+  bool running;
+  volatile bool stop;
+  unsigned int rate;
+  unsigned int duration;
+  uv_thread_t thread;
+  mock::StormStats stats;
+} storm;
+
+MockReader *find_reader(const std::string &name) {
+  for(std::vector<MockReader>::iterator i = readers.begin(); i != readers.end(); ++i) {
+    if(i->name == name) {
+      return &*i;
+    }
+  }
+  return NULL;
+}
+
+std::string uid_key(const uint8_t uid[7]) {
+  return std::string(reinterpret_cast<const char *>(uid), 7);
+}
+
+size_t key_length(int type) {
+  return type == KEY_DES ? 8 : type == KEY_3K3DES ? 24 : 16;
+}
+
+/* Expands a key to its 3K3DES or AES form so DES and 3DES keys with the same value compare equal.
+ * The parity bits of (3)DES keys carry the version and are ignored. */
+void key_normalize(int type, const uint8_t *data, uint8_t out[24]) {
+  if(type == KEY_AES) {
+    memcpy(out, data, 16);
+    memset(out + 16, 0, 8);
+    return;
+  }
+  if(type == KEY_DES) {
+    memcpy(out, data, 8);
+    memcpy(out + 8, data, 8);
+    memcpy(out + 16, data, 8);
+  } else if(type == KEY_3DES) {
+    memcpy(out, data, 16);
+    memcpy(out + 16, data, 8);
+  } else {
+    memcpy(out, data, 24);
+  }
+  for(int i = 0; i < 24; i++) {
+    out[i] &= 0xFE;
+  }
+}
+
+bool key_matches(const MockKey &stored, MifareDESFireKey key) {
+  if((stored.type == KEY_AES) != (key->type == KEY_AES)) {
+    return false;
+  }
+  uint8_t a[24], b[24];
+  key_normalize(stored.type, stored.data, a);
+  key_normalize(key->type, key->data, b);
+  return memcmp(a, b, 24) == 0;
+}
+
+MockKey default_key(int type) {
+  MockKey key;
+  key.type = type;
+  memset(key.data, 0, sizeof(key.data));
+  key.version = 0;
+  return key;
+}
+
+MockApplication new_application(uint8_t settings, uint8_t key_no) {
+  MockApplication app;
+  app.settings = settings;
+  // The upper bits of key_no select the crypto method of the application keys
+  app.keys.assign(key_no & 0x0F, default_key((key_no & 0x80) ? KEY_AES : (key_no & 0x40) ? KEY_3K3DES : KEY_DES));
+  return app;
+}
+
+std::shared_ptr<MockCard> new_card(const uint8_t uid[7], const mock::CardOptions &options) {
+  std::shared_ptr<MockCard> card = std::make_shared<MockCard>();
+  struct mifare_desfire_version_info &v = card->version;
+  v.hardware.vendor_id = v.software.vendor_id = 0x04;
+  v.hardware.type = v.software.type = 0x01;
+  v.hardware.subtype = v.software.subtype = 0x01;
+  v.hardware.version_major = v.software.version_major = 0x01;
+  v.hardware.version_minor = v.software.version_minor = 0x00;
+  v.hardware.storage_size = v.software.storage_size = 0x1A;
+  v.hardware.protocol = v.software.protocol = 0x05;
+  memcpy(v.uid, uid, 7);
+  memset(v.batch_number, 0xBA, 5);
+  v.production_week = 0x12;
+  v.production_year = 0x26;
+
+  MockApplication picc = new_application(0x0F, 1);
+  picc.keys[0].type = options.picc_key_type;
+  memcpy(picc.keys[0].data, options.picc_key, key_length(options.picc_key_type));
+  card->apps[0] = picc;
+
+  if(!options.blank) {
+    // NDEF application as written by DesfireCreateNdef with mapping version 2
+    MockApplication ndef = new_application(0x0F, 1);
+    const uint8_t cc[15] = { 0x00, 0x0F, 0x20, 0x00, 0x3B, 0x00, 0x34, 0x04, 0x06, 0xE1, 0x04, 0x08, 0x00, 0x00, 0x00 };
+    const uint8_t ndef_name[7] = { 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01 };
+    ndef.iso_name.assign(ndef_name, ndef_name + sizeof(ndef_name));
+    ndef.files[1].access_rights = 0xE000;
+    ndef.files[1].iso_file_id = 0xE103;
+    ndef.files[1].data.assign(cc, cc + sizeof(cc));
+    ndef.files[2].access_rights = 0xEEE0;
+    ndef.files[2].iso_file_id = 0xE104;
+    ndef.files[2].data.assign(0x0800, 0x00);
+    // An empty NDEF record so a fresh card can be read
+    const uint8_t empty[5] = { 0x00, 0x03, 0xD0, 0x00, 0x00 };
+    memcpy(&ndef.files[2].data[0], empty, sizeof(empty));
+    card->apps[1] = ndef;
+  }
+  return card;
+}
+
+uint32_t used_memory(const MockCard &card) {
+  uint32_t used = 0;
+  for(std::map<uint32_t, MockApplication>::const_iterator a = card.apps.begin(); a != card.apps.end(); ++a) {
+    for(std::map<uint8_t, MockFile>::const_iterator f = a->second.files.begin(); f != a->second.files.end(); ++f) {
+      // A backup data file takes twice its size
+      used += f->second.data.size() * (f->second.backup ? 2 : 1);
+    }
+  }
+  return used;
+}
+
+/* Store a PCSC error code as the internal error of the tag */
+int transport_error(FreefareTag tag, uint32_t code) {
+  tag->internal_error = static_cast<int>(code);
+  return -1;
+}
+
+/* Report a DESFire status code. Like the real card any error drops the authentication */
+int picc_error(FreefareTag tag, uint8_t code) {
+  tag->last_picc_error = code;
+  tag->internal_error = code;
+  tag->authenticated = -1;
+  return -1;
+}
+
+/* Wait the configured latency of a command */
+void latency(const char *name) {
+  std::map<std::string, unsigned int>::const_iterator i = latencies.find(name);
+  unsigned int usec = i == latencies.end() ? default_latency : i->second;
+  if(usec) {
+    usleep(usec);
+  }
+}
+
+/* Common prologue of every card command. Fails if the card left the field */
+bool command(FreefareTag tag, const char *name) {
+  ++command_count;
+  latency(name);
+  tag->last_picc_error = OPERATION_OK;
+  if(!tag->active) {
+    transport_error(tag, SCARD_E_INVALID_HANDLE);
+    return false;
+  }
+  ReadersGuard guard;
+  if(tag->reader->card != tag->card) {
+    transport_error(tag, 0x80100069); // SCARD_W_REMOVED_CARD
+    return false;
+  }
+  return true;
+}
+
+/* Put a card on or take it from a reader. Called with the readers lock held */
+void place(MockReader *reader, const std::shared_ptr<MockCard> &card) {
+  reader->card = card;
+  reader->iso_app = 0;
+  reader->iso_file = -1;
+  reader->events++;
+  reader->event_time = uv_hrtime();
+}
+
+/* Tap storm thread: toggles the storm card of every reader rate times per second in both directions */
+void storm_run(void *arg) {
+  const uint64_t start = uv_hrtime();
+  const uint64_t end = start + (uint64_t)storm.duration * 1000000;
+  const uint64_t period = 1000000000ULL / (2 * storm.rate);
+  std::vector<std::shared_ptr<MockCard> > storm_cards;
+  std::vector<uint64_t> due;
+  {
+    ReadersGuard guard;
+    for(size_t i = 0; i < readers.size(); i++) {
+      uint8_t uid[7] = { 0x04, 0x53, 0x54, 0x00, 0x00, (uint8_t)(i >> 8), (uint8_t)i };
+      storm_cards.push_back(new_card(uid, mock::CardOptions()));
+      // Spread the readers over one period
+      due.push_back(start + period * i / readers.size());
+    }
+  }
+  while(!storm.stop) {
+    uint64_t now = uv_hrtime();
+    if(now >= end) {
+      break;
+    }
+    uint64_t next = end;
+    {
+      ReadersGuard guard;
+      for(size_t i = 0; i < readers.size(); i++) {
+        if(due[i] <= now) {
+          place(&readers[i], readers[i].card ? std::shared_ptr<MockCard>() : storm_cards[i]);
+          storm.stats.generated++;
+          due[i] += period;
+        }
+        if(due[i] < next) {
+          next = due[i];
+        }
+      }
+    }
+    now = uv_hrtime();
+    if(next > now) {
+      usleep((next - now) / 1000);
+    }
+  }
+}
+
+MockApplication *selected_app(FreefareTag tag) {
+  std::map<uint32_t, MockApplication>::iterator app = tag->card->apps.find(tag->selected);
+  return app == tag->card->apps.end() ? NULL : &app->second;
+}
+
+/* True if the access condition is free or the required key is authenticated */
+bool access_granted(FreefareTag tag, uint8_t condition) {
+  return condition == ACCESS_FREE || (tag->authenticated >= 0 && condition == tag->authenticated);
+}
+
+/* True if the master key of the selected application is authenticated or the settings bit grants free access */
+bool master_or_free(FreefareTag tag, MockApplication *app, uint8_t setting_bit) {
+  return (app->settings & setting_bit) || tag->authenticated == 0;
+}
+
+MockFile *file_access(FreefareTag tag, uint8_t file_no, int shift) {
+  MockApplication *app = selected_app(tag);
+  if(!app || !app->files.count(file_no)) {
+    picc_error(tag, FILE_NOT_FOUND);
+    return NULL;
+  }
+  MockFile &file = app->files[file_no];
+  if(!access_granted(tag, (file.access_rights >> shift) & 0x0F) && !access_granted(tag, (file.access_rights >> 4) & 0x0F)) {
+    picc_error(tag, (tag->authenticated < 0) ? AUTHENTICATION_ERROR : PERMISSION_ERROR);
+    return NULL;
+  }
+  return &file;
+}
+
+MifareDESFireKey key_new(int type, const uint8_t *value, uint8_t version) {
+  MifareDESFireKey key = static_cast<MifareDESFireKey>(calloc(1, sizeof(struct mifare_desfire_key)));
+  key->type = type;
+  memcpy(key->data, value, key_length(type));
+  key->version = version;
+  return key;
+}
+
+/* libfreefare stores the version of (3)DES keys in the parity bits of the first 8 bytes */
+uint8_t key_version(const uint8_t *value) {
+  uint8_t version = 0;
+  for(int i = 0; i < 8; i++) {
+    version |= (value[i] & 0x01) << (7 - i);
+  }
+  return version;
+}
+
+} // namespace
+
+namespace mock {
+
+CardOptions::CardOptions() : blank(false), picc_key_type(KEY_DES) {
+  memset(picc_key, 0, sizeof(picc_key));
+}
+
+bool insert(const std::string &name, const uint8_t uid[7], bool keep) {
+  MockReader *reader = find_reader(name);
+  if(!reader) {
+    return false;
+  }
+  if(keep) {
+    std::shared_ptr<MockCard> &card = cards[uid_key(uid)];
+    if(!card) {
+      card = new_card(uid, CardOptions());
+    }
+    ReadersGuard guard;
+    place(reader, card);
+  } else {
+    std::shared_ptr<MockCard> card = new_card(uid, CardOptions());
+    ReadersGuard guard;
+    place(reader, card);
+  }
+  return true;
+}
+
+bool remove(const std::string &name) {
+  MockReader *reader = find_reader(name);
+  if(!reader) {
+    return false;
+  }
+  ReadersGuard guard;
+  place(reader, std::shared_ptr<MockCard>());
+  return true;
+}
+
+bool hold(const std::string &name, bool held) {
+  MockReader *reader = find_reader(name);
+  if(!reader) {
+    return false;
+  }
+  ReadersGuard guard;
+  reader->held = held;
+  return true;
+}
+
+void create(const uint8_t uid[7], const CardOptions &options) {
+  cards[uid_key(uid)] = new_card(uid, options);
+}
+
+void forget() {
+  cards.clear();
+}
+
+void latency(const std::string &command, unsigned int usec) {
+  if(command == "default") {
+    default_latency = usec;
+  } else {
+    latencies[command] = usec;
+  }
+}
+
+bool readers(unsigned int count) {
+  if(storm.running || count == 0) {
+    return false;
+  }
+  ReadersGuard guard;
+  ::readers.clear();
+  for(unsigned int i = 0; i < count; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "Mock Reader 00 %02u", i);
+    ::readers.push_back(MockReader(name));
+  }
+  return true;
+}
+
+bool start_storm(unsigned int rate, unsigned int duration) {
+  if(storm.running || rate == 0) {
+    return false;
+  }
+  storm.stats = StormStats();
+  storm.rate = rate;
+  storm.duration = duration;
+  storm.stop = false;
+  storm.running = uv_thread_create(&storm.thread, storm_run, NULL) == 0;
+  return storm.running;
+}
+
+void stop_storm() {
+  if(storm.running) {
+    storm.stop = true;
+    uv_thread_join(&storm.thread);
+    storm.running = false;
+  }
+}
+
+void delivered(const std::string &name) {
+  uint64_t now = uv_hrtime();
+  ReadersGuard guard;
+  MockReader *reader = find_reader(name);
+  if(reader && reader->pending) {
+    reader->pending = false;
+    storm.stats.delivered++;
+    storm.stats.latencies.push_back((uint32_t)((now - reader->pending_time) / 1000));
+  }
+}
+
+StormStats storm_stats() {
+  ReadersGuard guard;
+  return storm.stats;
+}
+
+unsigned long commands() {
+  return command_count;
+}
+
+unsigned long written() {
+  return written_count;
+}
+
+void reset() {
+  command_count = 0;
+  written_count = 0;
+}
+
+} // namespace mock
+
+extern "C" {
+
+LONG SCardGetStatusChange(SCARDCONTEXT hContext, DWORD dwTimeout, SCARD_READERSTATE *rgReaderStates, DWORD cReaders) {
+  bool changed = false;
+  ReadersGuard guard;
+  for(DWORD i = 0; i < cReaders; i++) {
+    SCARD_READERSTATE &state = rgReaderStates[i];
+    MockReader *reader = find_reader(state.szReader ? state.szReader : "");
+    DWORD event = reader ? (reader->card ? SCARD_STATE_PRESENT : SCARD_STATE_EMPTY) : SCARD_STATE_UNKNOWN;
+    if(reader) {
+      event |= (reader->events & 0xFFFF) << 16;
+    }
+    if(state.dwCurrentState == SCARD_STATE_UNAWARE || (state.dwCurrentState & ~SCARD_STATE_CHANGED) != event) {
+      state.dwEventState = event | SCARD_STATE_CHANGED;
+      changed = true;
+      if(reader && reader->seen != reader->events) {
+        // Every insert or remove since the last change folded into this one is lost
+        storm.stats.detected++;
+        reader->seen = reader->events;
+        reader->pending = true;
+        reader->pending_time = reader->event_time;
+      }
+    } else {
+      state.dwEventState = event;
+    }
+  }
+  return changed ? SCARD_S_SUCCESS : SCARD_E_TIMEOUT;
+}
+
+/* A direct connection is the index of the reader + 1 */
+LONG SCardConnect(SCARDCONTEXT hContext, LPCSTR szReader, DWORD dwShareMode, DWORD dwPreferredProtocols, LPSCARDHANDLE phCard, LPDWORD pdwActiveProtocol) {
+  ReadersGuard guard;
+  MockReader *reader = find_reader(szReader ? szReader : "");
+  if(!reader) {
+    return SCARD_E_UNKNOWN_READER;
+  }
+  if(!reader->card) {
+    return SCARD_E_NO_SMARTCARD;
+  }
+  *phCard = (reader - &readers[0]) + 1;
+  *pdwActiveProtocol = SCARD_PROTOCOL_T1;
+  return SCARD_S_SUCCESS;
+}
+
+/* Writes a status word as the whole response */
+LONG transmit_status(BYTE sw1, BYTE sw2, LPBYTE pbRecvBuffer, LPDWORD pcbRecvLength) {
+  if(*pcbRecvLength < 2) {
+    return SCARD_E_INSUFFICIENT_BUFFER;
+  }
+  pbRecvBuffer[0] = sw1;
+  pbRecvBuffer[1] = sw2;
+  *pcbRecvLength = 2;
+  return SCARD_S_SUCCESS;
+}
+
+/* ISO 7816-4 SELECT by DF name or file identifier and READ BINARY of files with free read access */
+LONG transmit_iso(MockReader &reader, LPCBYTE apdu, DWORD length, LPBYTE pbRecvBuffer, LPDWORD pcbRecvLength) {
+  MockCard &card = *reader.card;
+  if(apdu[1] == 0xA4 && apdu[2] == 0x04 && length >= 5 && length >= 5u + apdu[4]) {
+    for(std::map<uint32_t, MockApplication>::const_iterator a = card.apps.begin(); a != card.apps.end(); ++a) {
+      if(!a->second.iso_name.empty() && a->second.iso_name.size() == apdu[4] &&
+         memcmp(&a->second.iso_name[0], apdu + 5, apdu[4]) == 0) {
+        reader.iso_app = a->first;
+        reader.iso_file = -1;
+        return transmit_status(0x90, 0x00, pbRecvBuffer, pcbRecvLength);
+      }
+    }
+    // File or application not found
+    return transmit_status(0x6A, 0x82, pbRecvBuffer, pcbRecvLength);
+  }
+  std::map<uint32_t, MockApplication>::iterator app = card.apps.find(reader.iso_app);
+  if(apdu[1] == 0xA4 && apdu[2] == 0x00 && length >= 7 && apdu[4] == 2) {
+    const uint16_t fid = (apdu[5] << 8) | apdu[6];
+    if(app != card.apps.end()) {
+      for(std::map<uint8_t, MockFile>::const_iterator f = app->second.files.begin(); f != app->second.files.end(); ++f) {
+        if(f->second.iso_file_id && f->second.iso_file_id == fid) {
+          reader.iso_file = f->first;
+          return transmit_status(0x90, 0x00, pbRecvBuffer, pcbRecvLength);
+        }
+      }
+    }
+    return transmit_status(0x6A, 0x82, pbRecvBuffer, pcbRecvLength);
+  }
+  if(apdu[1] == 0xB0 && length >= 5) {
+    if(app == card.apps.end() || reader.iso_file < 0 || !app->second.files.count(reader.iso_file)) {
+      // Command not allowed, no current EF
+      return transmit_status(0x69, 0x86, pbRecvBuffer, pcbRecvLength);
+    }
+    const MockFile &file = app->second.files[reader.iso_file];
+    if((file.access_rights >> 12) != ACCESS_FREE && ((file.access_rights >> 4) & 0x0F) != ACCESS_FREE) {
+      // Security status not satisfied
+      return transmit_status(0x69, 0x82, pbRecvBuffer, pcbRecvLength);
+    }
+    const size_t offset = ((apdu[2] & 0x7F) << 8) | apdu[3];
+    size_t le = apdu[4] ? apdu[4] : 256;
+    if(offset > file.data.size()) {
+      // Wrong parameters P1-P2
+      return transmit_status(0x6B, 0x00, pbRecvBuffer, pcbRecvLength);
+    }
+    le = std::min(le, file.data.size() - offset);
+    if(*pcbRecvLength < le + 2) {
+      return SCARD_E_INSUFFICIENT_BUFFER;
+    }
+    memcpy(pbRecvBuffer, &file.data[offset], le);
+    pbRecvBuffer[le] = 0x90;
+    pbRecvBuffer[le + 1] = 0x00;
+    *pcbRecvLength = le + 2;
+    return SCARD_S_SUCCESS;
+  }
+  // Instruction not supported
+  return transmit_status(0x6D, 0x00, pbRecvBuffer, pcbRecvLength);
+}
+
+/*
+ * Emulates the GET DATA pseudo APDU for the UID, the first frame of the wrapped DESFire GetVersion
+ * and the ISO 7816-4 SELECT and READ BINARY of the NDEF mapping
+ */
+LONG SCardTransmit(SCARDHANDLE hCard, const SCARD_IO_REQUEST *pioSendPci, LPCBYTE pbSendBuffer, DWORD cbSendLength, SCARD_IO_REQUEST *pioRecvPci, LPBYTE pbRecvBuffer, LPDWORD pcbRecvLength) {
+  static const BYTE get_uid[] = {0xFF, 0xCA, 0x00, 0x00};
+  ++command_count;
+  latency("transmit");
+  ReadersGuard guard;
+  if(hCard < 1 || static_cast<size_t>(hCard) > readers.size()) {
+    return SCARD_E_INVALID_HANDLE;
+  }
+  MockReader &reader = readers[hCard - 1];
+  if(!reader.card) {
+    return 0x80100069; // SCARD_W_REMOVED_CARD
+  }
+  static const BYTE get_version[] = {0x90, 0x60, 0x00, 0x00};
+  if(cbSendLength >= sizeof(get_version) && memcmp(pbSendBuffer, get_version, sizeof(get_version)) == 0) {
+    // The hardware version, 91 AF: more frames follow
+    if(*pcbRecvLength < sizeof(reader.card->version.hardware) + 2) {
+      return SCARD_E_INSUFFICIENT_BUFFER;
+    }
+    memcpy(pbRecvBuffer, &reader.card->version.hardware, sizeof(reader.card->version.hardware));
+    pbRecvBuffer[sizeof(reader.card->version.hardware)] = 0x91;
+    pbRecvBuffer[sizeof(reader.card->version.hardware) + 1] = 0xAF;
+    *pcbRecvLength = sizeof(reader.card->version.hardware) + 2;
+    return SCARD_S_SUCCESS;
+  }
+  if(cbSendLength >= 5 && pbSendBuffer[0] == 0x00) {
+    return transmit_iso(reader, pbSendBuffer, cbSendLength, pbRecvBuffer, pcbRecvLength);
+  }
+  if(cbSendLength < sizeof(get_uid) || memcmp(pbSendBuffer, get_uid, sizeof(get_uid)) != 0) {
+    // Function not supported
+    return transmit_status(0x6A, 0x81, pbRecvBuffer, pcbRecvLength);
+  }
+  if(*pcbRecvLength < 7 + 2) {
+    return SCARD_E_INSUFFICIENT_BUFFER;
+  }
+  memcpy(pbRecvBuffer, reader.card->version.uid, 7);
+  pbRecvBuffer[7] = 0x90;
+  pbRecvBuffer[8] = 0x00;
+  *pcbRecvLength = 7 + 2;
+  return SCARD_S_SUCCESS;
+}
+
+LONG SCardDisconnect(SCARDHANDLE hCard, DWORD dwDisposition) {
+  return SCARD_S_SUCCESS;
+}
+
+LONG SCardCancel(SCARDCONTEXT hContext) {
+  // The emulated commands can not be interrupted, the deadline is checked after each one
+  return SCARD_S_SUCCESS;
+}
+
+LONG pcsc_init(pcsc_context **context) {
+  *context = static_cast<pcsc_context *>(calloc(1, sizeof(pcsc_context)));
+  (*context)->context = 1;
+  return SCARD_S_SUCCESS;
+}
+
+void pcsc_exit(pcsc_context *context) {
+  free(context);
+}
+
+LONG pcsc_list_devices(pcsc_context *context, LPSTR *string) {
+  reader_names.clear();
+  for(std::vector<MockReader>::const_iterator i = readers.begin(); i != readers.end(); ++i) {
+    reader_names.append(i->name);
+    reader_names.push_back('\0');
+  }
+  reader_names.push_back('\0');
+  *string = &reader_names[0];
+  return SCARD_S_SUCCESS;
+}
+
+FreefareTag *freefare_get_tags_pcsc(pcsc_context *context, const char *name) {
+  ReadersGuard guard;
+  MockReader *reader = find_reader(name);
+  if(!reader || !reader->card) {
+    return NULL;
+  }
+  FreefareTag *tags = static_cast<FreefareTag *>(calloc(2, sizeof(FreefareTag)));
+  tags[0] = new freefare_tag();
+  tags[0]->card = reader->card;
+  tags[0]->reader = reader;
+  tags[0]->active = false;
+  tags[0]->selected = 0;
+  tags[0]->authenticated = -1;
+  tags[0]->internal_error = 0;
+  tags[0]->last_picc_error = OPERATION_OK;
+  return tags;
+}
+
+enum freefare_tag_type freefare_get_tag_type(FreefareTag tag) {
+  return MIFARE_DESFIRE;
+}
+
+const char *freefare_get_tag_friendly_name(FreefareTag tag) {
+  return "Mifare DESFire";
+}
+
+char *freefare_get_tag_uid(FreefareTag tag) {
+  char *uid = static_cast<char *>(malloc(2 * 7 + 1));
+  for(int i = 0; i < 7; i++) {
+    snprintf(uid + 2 * i, 3, "%02x", tag->card->version.uid[i]);
+  }
+  return uid;
+}
+
+void freefare_free_tags(FreefareTag *tags) {
+  if(tags) {
+    for(int i = 0; tags[i]; i++) {
+      delete tags[i];
+    }
+    free(tags);
+  }
+}
+
+const char *freefare_strerror(FreefareTag tag) {
+  switch(tag->last_picc_error) {
+    case OPERATION_OK: return tag->internal_error ? "PCSC error" : "Success";
+    case NO_CHANGES: return "NO_CHANGES";
+    case OUT_OF_EEPROM_ERROR: return "OUT_OF_EEPROM_ERROR";
+    case ILLEGAL_COMMAND_CODE: return "ILLEGAL_COMMAND_CODE";
+    case INTEGRITY_ERROR: return "INTEGRITY_ERROR";
+    case NO_SUCH_KEY: return "NO_SUCH_KEY";
+    case LENGTH_ERROR: return "LENGTH_ERROR";
+    case PERMISSION_ERROR: return "PERMISSION_ERROR";
+    case PARAMETER_ERROR: return "PARAMETER_ERROR";
+    case APPLICATION_NOT_FOUND: return "APPLICATION_NOT_FOUND";
+    case AUTHENTICATION_ERROR: return "AUTHENTICATION_ERROR";
+    case BOUNDARY_ERROR: return "BOUNDARY_ERROR";
+    case COMMAND_ABORTED: return "COMMAND_ABORTED";
+    case DUPLICATE_ERROR: return "DUPLICATE_ERROR";
+    case FILE_NOT_FOUND: return "FILE_NOT_FOUND";
+    default: return "Unknown error";
+  }
+}
+
+int freefare_internal_error(FreefareTag tag) {
+  return tag->internal_error;
+}
+
+void freefare_clear_internal_error(FreefareTag tag) {
+  tag->internal_error = 0;
+  tag->last_picc_error = OPERATION_OK;
+}
+
+MifareDESFireAID mifare_desfire_aid_new(uint32_t aid) {
+  MifareDESFireAID res = static_cast<MifareDESFireAID>(malloc(sizeof(struct mifare_desfire_aid)));
+  res->aid = aid & 0x00FFFFFF;
+  return res;
+}
+
+uint32_t mifare_desfire_aid_get_aid(MifareDESFireAID aid) {
+  return aid->aid;
+}
+
+MifareDESFireKey mifare_desfire_des_key_new(const uint8_t value[8]) {
+  uint8_t data[8];
+  for(int i = 0; i < 8; i++) {
+    data[i] = value[i] & 0xFE;
+  }
+  return key_new(KEY_DES, data, 0);
+}
+
+MifareDESFireKey mifare_desfire_3des_key_new(const uint8_t value[16]) {
+  uint8_t data[16];
+  for(int i = 0; i < 16; i++) {
+    data[i] = value[i] & 0xFE;
+  }
+  return key_new(KEY_3DES, data, 0);
+}
+
+MifareDESFireKey mifare_desfire_3k3des_key_new(const uint8_t value[24]) {
+  uint8_t data[24];
+  for(int i = 0; i < 24; i++) {
+    data[i] = value[i] & 0xFE;
+  }
+  return key_new(KEY_3K3DES, data, 0);
+}
+
+MifareDESFireKey mifare_desfire_aes_key_new(const uint8_t value[16]) {
+  return key_new(KEY_AES, value, 0);
+}
+
+MifareDESFireKey mifare_desfire_des_key_new_with_version(const uint8_t value[8]) {
+  return key_new(KEY_DES, value, key_version(value));
+}
+
+MifareDESFireKey mifare_desfire_3des_key_new_with_version(const uint8_t value[16]) {
+  return key_new(KEY_3DES, value, key_version(value));
+}
+
+MifareDESFireKey mifare_desfire_3k3des_key_new_with_version(const uint8_t value[24]) {
+  return key_new(KEY_3K3DES, value, key_version(value));
+}
+
+MifareDESFireKey mifare_desfire_aes_key_new_with_version(const uint8_t value[16], uint8_t version) {
+  return key_new(KEY_AES, value, version);
+}
+
+void mifare_desfire_key_free(MifareDESFireKey key) {
+  free(key);
+}
+
+/* Drops the uncommitted writes of the backup files in the selected application */
+void abort_transaction(FreefareTag tag) {
+  MockApplication *app = selected_app(tag);
+  if(!app) {
+    return;
+  }
+  for(std::map<uint8_t, MockFile>::iterator f = app->files.begin(); f != app->files.end(); ++f) {
+    f->second.dirty = false;
+  }
+}
+
+int mifare_desfire_connect(FreefareTag tag) {
+  latency("connect");
+  if(tag->active) {
+    return transport_error(tag, SCARD_E_SHARING_VIOLATION);
+  }
+  ReadersGuard guard;
+  if(tag->reader->held) {
+    return transport_error(tag, SCARD_E_SHARING_VIOLATION);
+  }
+  if(tag->reader->card != tag->card) {
+    return transport_error(tag, SCARD_E_NO_SMARTCARD);
+  }
+  tag->active = true;
+  tag->selected = 0;
+  tag->authenticated = -1;
+  return 0;
+}
+
+int mifare_desfire_disconnect(FreefareTag tag) {
+  // Leaving the field without commit
+  abort_transaction(tag);
+  tag->active = false;
+  tag->authenticated = -1;
+  return 0;
+}
+
+uint8_t mifare_desfire_last_picc_error(FreefareTag tag) {
+  return tag->last_picc_error;
+}
+
+int mifare_desfire_authenticate(FreefareTag tag, uint8_t key_no, MifareDESFireKey key) {
+  if(!command(tag, "authenticate")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app) {
+    return picc_error(tag, APPLICATION_NOT_FOUND);
+  }
+  if(key_no >= app->keys.size()) {
+    return picc_error(tag, NO_SUCH_KEY);
+  }
+  if(!key_matches(app->keys[key_no], key)) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  tag->authenticated = key_no;
+  return 0;
+}
+
+int mifare_desfire_change_key_settings(FreefareTag tag, uint8_t settings) {
+  if(!command(tag, "change_key_settings")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app) {
+    return picc_error(tag, APPLICATION_NOT_FOUND);
+  }
+  if(tag->authenticated != 0) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  if(!(app->settings & 0x08)) {
+    return picc_error(tag, PERMISSION_ERROR);
+  }
+  app->settings = (app->settings & 0xF0) | (settings & 0x0F);
+  return 0;
+}
+
+int mifare_desfire_get_key_settings(FreefareTag tag, uint8_t *settings, uint8_t *max_keys) {
+  if(!command(tag, "get_key_settings")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app) {
+    return picc_error(tag, APPLICATION_NOT_FOUND);
+  }
+  if(!master_or_free(tag, app, 0x02)) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  *settings = app->settings;
+  *max_keys = app->keys.size();
+  return 0;
+}
+
+int mifare_desfire_get_key_version(FreefareTag tag, uint8_t key_no, uint8_t *version) {
+  if(!command(tag, "get_key_version")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app) {
+    return picc_error(tag, APPLICATION_NOT_FOUND);
+  }
+  if(key_no >= app->keys.size()) {
+    return picc_error(tag, NO_SUCH_KEY);
+  }
+  *version = app->keys[key_no].version;
+  return 0;
+}
+
+int mifare_desfire_create_application(FreefareTag tag, MifareDESFireAID aid, uint8_t settings, uint8_t key_no) {
+  if(!command(tag, "create_application")) {
+    return -1;
+  }
+  MockApplication *picc = selected_app(tag);
+  if(!picc || tag->selected != 0) {
+    return picc_error(tag, PERMISSION_ERROR);
+  }
+  if(!master_or_free(tag, picc, 0x04)) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  if(tag->card->apps.count(aid->aid)) {
+    return picc_error(tag, DUPLICATE_ERROR);
+  }
+  if((key_no & 0x0F) == 0 || (key_no & 0x0F) > 14) {
+    return picc_error(tag, PARAMETER_ERROR);
+  }
+  tag->card->apps[aid->aid] = new_application(settings, key_no);
+  return 0;
+}
+
+int mifare_desfire_create_application_iso(FreefareTag tag, MifareDESFireAID aid, uint8_t settings, uint8_t key_no, int want_iso_file_identifiers, uint16_t iso_file_id, uint8_t *iso_file_name, size_t iso_file_name_len) {
+  int res = mifare_desfire_create_application(tag, aid, settings, key_no);
+  if(res == 0 && iso_file_name) {
+    tag->card->apps[aid->aid].iso_name.assign(iso_file_name, iso_file_name + iso_file_name_len);
+  }
+  return res;
+}
+
+int mifare_desfire_select_application(FreefareTag tag, MifareDESFireAID aid) {
+  if(!command(tag, "select_application")) {
+    return -1;
+  }
+  uint32_t id = aid ? aid->aid : 0;
+  if(!tag->card->apps.count(id)) {
+    return picc_error(tag, APPLICATION_NOT_FOUND);
+  }
+  abort_transaction(tag);
+  tag->selected = id;
+  tag->authenticated = -1;
+  return 0;
+}
+
+int mifare_desfire_get_application_ids(FreefareTag tag, MifareDESFireAID *aids[], size_t *count) {
+  if(!command(tag, "get_application_ids")) {
+    return -1;
+  }
+  MockApplication *picc = selected_app(tag);
+  if(!picc || tag->selected != 0) {
+    return picc_error(tag, PERMISSION_ERROR);
+  }
+  if(!master_or_free(tag, picc, 0x02)) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  // NULL terminated like libfreefare
+  *count = tag->card->apps.size() - 1;
+  *aids = static_cast<MifareDESFireAID *>(malloc((*count + 1) * sizeof(MifareDESFireAID)));
+  size_t i = 0;
+  for(std::map<uint32_t, MockApplication>::const_iterator app = tag->card->apps.begin(); app != tag->card->apps.end(); ++app) {
+    if(app->first != 0) {
+      (*aids)[i++] = mifare_desfire_aid_new(app->first);
+    }
+  }
+  (*aids)[i] = NULL;
+  return 0;
+}
+
+void mifare_desfire_free_application_ids(MifareDESFireAID aids[]) {
+  for(size_t i = 0; aids && aids[i]; i++) {
+    free(aids[i]);
+  }
+  free(aids);
+}
+
+int mifare_desfire_format_picc(FreefareTag tag) {
+  if(!command(tag, "format_picc")) {
+    return -1;
+  }
+  if(tag->selected != 0) {
+    return picc_error(tag, PERMISSION_ERROR);
+  }
+  if(tag->authenticated != 0) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  MockApplication picc = tag->card->apps[0];
+  tag->card->apps.clear();
+  tag->card->apps[0] = picc;
+  return 0;
+}
+
+int mifare_desfire_get_version(FreefareTag tag, struct mifare_desfire_version_info *version_info) {
+  if(!command(tag, "get_version")) {
+    return -1;
+  }
+  *version_info = tag->card->version;
+  return 0;
+}
+
+int mifare_desfire_free_mem(FreefareTag tag, uint32_t *size) {
+  if(!command(tag, "free_mem")) {
+    return -1;
+  }
+  uint32_t used = used_memory(*tag->card);
+  *size = used > STORAGE_SIZE ? 0 : STORAGE_SIZE - used;
+  return 0;
+}
+
+int mifare_desfire_create_std_data_file(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size) {
+  if(!command(tag, "create_std_data_file")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app || tag->selected == 0) {
+    return picc_error(tag, PERMISSION_ERROR);
+  }
+  if(!master_or_free(tag, app, 0x04)) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  if(app->files.count(file_no)) {
+    return picc_error(tag, DUPLICATE_ERROR);
+  }
+  if(used_memory(*tag->card) + file_size > STORAGE_SIZE) {
+    return picc_error(tag, OUT_OF_EEPROM_ERROR);
+  }
+  MockFile &file = app->files[file_no];
+  file.access_rights = access_rights;
+  file.data.assign(file_size, 0x00);
+  return 0;
+}
+
+int mifare_desfire_create_backup_data_file(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size) {
+  if(!command(tag, "create_backup_data_file")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app || tag->selected == 0) {
+    return picc_error(tag, PERMISSION_ERROR);
+  }
+  if(!master_or_free(tag, app, 0x04)) {
+    return picc_error(tag, AUTHENTICATION_ERROR);
+  }
+  if(app->files.count(file_no)) {
+    return picc_error(tag, DUPLICATE_ERROR);
+  }
+  if(used_memory(*tag->card) + 2 * file_size > STORAGE_SIZE) {
+    return picc_error(tag, OUT_OF_EEPROM_ERROR);
+  }
+  MockFile &file = app->files[file_no];
+  file.access_rights = access_rights;
+  file.backup = true;
+  file.data.assign(file_size, 0x00);
+  return 0;
+}
+
+int mifare_desfire_create_backup_data_file_iso(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size, uint16_t iso_file_id) {
+  int res = mifare_desfire_create_backup_data_file(tag, file_no, communication_settings, access_rights, file_size);
+  if(res == 0) {
+    selected_app(tag)->files[file_no].iso_file_id = iso_file_id;
+  }
+  return res;
+}
+
+int mifare_desfire_get_file_settings(FreefareTag tag, uint8_t file_no, struct mifare_desfire_file_settings *settings) {
+  if(!command(tag, "get_file_settings")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app || !app->files.count(file_no)) {
+    return picc_error(tag, FILE_NOT_FOUND);
+  }
+  const MockFile &file = app->files[file_no];
+  memset(settings, 0, sizeof(*settings));
+  settings->file_type = file.backup ? MDFT_BACKUP_DATA_FILE : MDFT_STANDARD_DATA_FILE;
+  settings->communication_settings = MDCM_PLAIN;
+  settings->access_rights = file.access_rights;
+  settings->settings.standard_file.file_size = file.data.size();
+  return 0;
+}
+
+int mifare_desfire_commit_transaction(FreefareTag tag) {
+  if(!command(tag, "commit_transaction")) {
+    return -1;
+  }
+  MockApplication *app = selected_app(tag);
+  if(!app) {
+    return picc_error(tag, PERMISSION_ERROR);
+  }
+  for(std::map<uint8_t, MockFile>::iterator f = app->files.begin(); f != app->files.end(); ++f) {
+    if(f->second.dirty) {
+      f->second.data = f->second.mirror;
+      f->second.dirty = false;
+    }
+  }
+  return 0;
+}
+
+int mifare_desfire_abort_transaction(FreefareTag tag) {
+  if(!command(tag, "abort_transaction")) {
+    return -1;
+  }
+  abort_transaction(tag);
+  return 0;
+}
+
+int mifare_desfire_create_std_data_file_iso(FreefareTag tag, uint8_t file_no, uint8_t communication_settings, uint16_t access_rights, uint32_t file_size, uint16_t iso_file_id) {
+  int res = mifare_desfire_create_std_data_file(tag, file_no, communication_settings, access_rights, file_size);
+  if(res == 0) {
+    selected_app(tag)->files[file_no].iso_file_id = iso_file_id;
+  }
+  return res;
+}
+
+ssize_t mifare_desfire_read_data(FreefareTag tag, uint8_t file_no, off_t offset, size_t length, void *data) {
+  if(!command(tag, "read_data")) {
+    return -1;
+  }
+  MockFile *file = file_access(tag, file_no, 12);
+  if(!file) {
+    return -1;
+  }
+  if(length == 0 && static_cast<size_t>(offset) <= file->data.size()) {
+    length = file->data.size() - offset;
+  }
+  if(static_cast<size_t>(offset) + length > file->data.size()) {
+    return picc_error(tag, BOUNDARY_ERROR);
+  }
+  if(length) {
+    memcpy(data, &file->data[offset], length);
+  }
+  return length;
+}
+
+ssize_t mifare_desfire_write_data(FreefareTag tag, uint8_t file_no, off_t offset, size_t length, const void *data) {
+  if(!command(tag, "write_data")) {
+    return -1;
+  }
+  MockFile *file = file_access(tag, file_no, 8);
+  if(!file) {
+    return -1;
+  }
+  if(static_cast<size_t>(offset) + length > file->data.size()) {
+    return picc_error(tag, BOUNDARY_ERROR);
+  }
+  std::vector<uint8_t> *target = &file->data;
+  if(file->backup) {
+    if(!file->dirty) {
+      file->mirror = file->data;
+      file->dirty = true;
+    }
+    target = &file->mirror;
+  }
+  if(length) {
+    memcpy(&(*target)[offset], data, length);
+  }
+  written_count += length;
+  return length;
+}
+
+int mifare_ultralight_connect(FreefareTag tag) {
+  return mifare_desfire_connect(tag);
+}
+
+int mifare_ultralight_disconnect(FreefareTag tag) {
+  return mifare_desfire_disconnect(tag);
+}
+
+} // extern "C"
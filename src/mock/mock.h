@@ -0,0 +1,146 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef MOCK_H
+#define MOCK_H
+
+#include <nan.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * In memory replacement for libfreefare and PCSC emulating DESFire EV1 cards.
+ * The node_mifare_mock target links the addon against this layer instead of
+ * the real libraries so the binding overhead can be measured and the card
+ * flows can be load tested without hardware.
+ * The emulation covers applications, standard data files with access rights,
+ * key settings and (3)DES/AES authentication by key comparison.
+ **/
+namespace mock {
+
+/* Options of an emulated card */
+struct CardOptions {
+  CardOptions();
+
+  /* Only the PICC level exists, otherwise the card carries an empty NDEF application */
+  bool blank;
+  /* Type of the PICC master key: 0 des, 1 3des, 2 3k3des, 3 aes like DesfireSetKey */
+  int picc_key_type;
+  uint8_t picc_key[24];
+};
+
+/**
+ * Put a card on a reader.
+ * @param reader The name of the emulated reader
+ * @param uid The 7 byte uid of the card
+ * @param keep If true the card is kept by uid and keeps its content between taps.
+ *             A kept card which was not created before is a formatted card with an empty NDEF application.
+ * @return false if the reader is unknown
+ **/
+bool insert(const std::string &reader, const uint8_t uid[7], bool keep);
+
+/**
+ * Remove the card from a reader.
+ * @param reader The name of the mocked reader
+ * @return false if the reader is unknown
+ **/
+bool remove(const std::string &reader);
+
+/**
+ * Let another PC/SC application hold the card of a reader exclusively or give it back.
+ * Connecting to the card fails with a sharing violation while it is held.
+ * @param reader The name of the mocked reader
+ * @param held True to hold the card
+ * @return false if the reader is unknown
+ **/
+bool hold(const std::string &reader, bool held);
+
+/**
+ * Create or replace a kept card.
+ * @param uid The 7 byte uid of the card
+ * @param options The initial content of the card
+ **/
+void create(const uint8_t uid[7], const CardOptions &options);
+
+/**
+ * Drop all kept cards.
+ **/
+void forget();
+
+/**
+ * Set the time every card command takes.
+ * @param command The command name without the mifare_desfire_ prefix (e.g. "authenticate") or "default"
+ * @param usec The latency in microseconds
+ **/
+void latency(const std::string &command, unsigned int usec);
+
+/* Counters of a tap storm */
+struct StormStats {
+  StormStats() : generated(0), detected(0), delivered(0) {}
+
+  /* Arrivals and departures generated */
+  unsigned long generated;
+  /* State changes reported by SCardGetStatusChange */
+  unsigned long detected;
+  /* State changes which reached the JS callback */
+  unsigned long delivered;
+  /* Microseconds from the arrival or departure to the JS callback per delivered change */
+  std::vector<uint32_t> latencies;
+};
+
+/**
+ * Replace the emulated readers by count readers named "Mock Reader 00 NN".
+ * Must be called before getReader and not while a storm is running.
+ * @return false if a storm is running
+ **/
+bool readers(unsigned int count);
+
+/**
+ * Start a tap storm thread. Every reader gets rate arrivals and rate departures per second.
+ * @param rate Arrivals per second and reader
+ * @param duration Duration of the storm in milliseconds
+ * @return false if a storm is already running
+ **/
+bool start_storm(unsigned int rate, unsigned int duration);
+
+/**
+ * Stop the tap storm thread and wait for it.
+ **/
+void stop_storm();
+
+/**
+ * Called by callCallback right before the JS callback of a reader is invoked.
+ * Records the latency of a pending state change.
+ * @param reader The name of the reader
+ **/
+void delivered(const std::string &reader);
+
+/**
+ * Counters of the current or last tap storm
+ **/
+StormStats storm_stats();
+
+/**
+ * Number of card commands issued since the last reset.
+ **/
+unsigned long commands();
+
+/**
+ * Number of data bytes written to cards since the last reset.
+ **/
+unsigned long written();
+
+/**
+ * Reset the command and the written bytes counter.
+ **/
+void reset();
+
+} // namespace mock
+
+/**
+ * Attach the mock control functions as `mock` to the module exports
+ * @param target The module exports object
+ **/
+void MockInit(v8::Local<v8::Object> target);
+
+#endif // MOCK_H
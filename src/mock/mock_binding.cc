@@ -0,0 +1,200 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include <algorithm>
+
+#include "mock.h"
+#include "reader.h"
+
+/* Extracts a 7 byte uid from an optional array argument, generates a sequential one otherwise */
+static bool uid_from_value(v8::Local<v8::Value> value, uint8_t uid[7]) {
+  static uint32_t next = 1;
+  if(value->IsUndefined()) {
+    uint32_t id = next++;
+    uint8_t seq[7] = { 0x04, 0x4D, 0x4F, (uint8_t)(id >> 24), (uint8_t)(id >> 16), (uint8_t)(id >> 8), (uint8_t)id };
+    memcpy(uid, seq, 7);
+    return true;
+  }
+  if(!value->IsArray() || v8::Local<v8::Array>::Cast(value)->Length() != 7) {
+    return false;
+  }
+  v8::Local<v8::Array> array = v8::Local<v8::Array>::Cast(value);
+  for(uint32_t i = 0; i < 7; i++) {
+    uid[i] = (uint8_t)(Nan::To<uint32_t>(array->Get(i)).FromJust() & 0xFF);
+  }
+  return true;
+}
+
+/* Puts a card on a reader. Cards with a given uid are kept and keep their content between taps */
+void MockInsert(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  uint8_t uid[7];
+  if(info.Length() < 1 || info.Length() > 2 || !info[0]->IsString() || !uid_from_value(info[1], uid)) {
+    Nan::ThrowError("insert takes a reader name and an optional uid array of 7 bytes");
+    return;
+  }
+  info.GetReturnValue().Set(Nan::New(mock::insert(*Nan::Utf8String(info[0]), uid, !info[1]->IsUndefined())));
+}
+
+/* Creates a kept card: create(uid, {blank:bool, piccKey:[...], piccKeyType:"des"|"3des"|"3k3des"|"aes"}) */
+void MockCreate(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  uint8_t uid[7];
+  mock::CardOptions options;
+  if(info.Length() < 1 || info.Length() > 2 || info[0]->IsUndefined() || !uid_from_value(info[0], uid) ||
+      (info.Length() == 2 && !info[1]->IsObject())) {
+    Nan::ThrowError("create takes an uid array of 7 bytes and an optional options object {blank, piccKey, piccKeyType}");
+    return;
+  }
+  if(info.Length() == 2) {
+    v8::Local<v8::Object> opts = v8::Local<v8::Object>::Cast(info[1]);
+    options.blank = opts->Get(Nan::New("blank").ToLocalChecked())->IsTrue();
+    v8::Local<v8::Value> type = opts->Get(Nan::New("piccKeyType").ToLocalChecked());
+    if(type->IsString()) {
+      std::string t(*Nan::Utf8String(type));
+      options.picc_key_type = t == "aes" ? 3 : t == "3k3des" ? 2 : t == "3des" ? 1 : 0;
+    }
+    v8::Local<v8::Value> key = opts->Get(Nan::New("piccKey").ToLocalChecked());
+    if(key->IsArray()) {
+      v8::Local<v8::Array> k = v8::Local<v8::Array>::Cast(key);
+      for(uint32_t i = 0; i < k->Length() && i < sizeof(options.picc_key); i++) {
+        options.picc_key[i] = (uint8_t)(Nan::To<uint32_t>(k->Get(i)).FromJust() & 0xFF);
+      }
+    }
+  }
+  mock::create(uid, options);
+}
+
+void MockForget(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  mock::forget();
+}
+
+/* Sets the latency of a card command: latency("authenticate", usec) or latency("default", usec) */
+void MockLatency(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  if(info.Length() != 2 || !info[0]->IsString() || !info[1]->IsUint32()) {
+    Nan::ThrowError("latency takes a command name or \"default\" and the latency in microseconds");
+    return;
+  }
+  mock::latency(*Nan::Utf8String(info[0]), Nan::To<uint32_t>(info[1]).FromJust());
+}
+
+void MockRemove(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  if(info.Length() != 1 || !info[0]->IsString()) {
+    Nan::ThrowError("remove takes a reader name");
+    return;
+  }
+  info.GetReturnValue().Set(Nan::New(mock::remove(*Nan::Utf8String(info[0]))));
+}
+
+/* Lets another application hold the card of a reader: hold(name, bool) */
+void MockHold(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  if(info.Length() != 2 || !info[0]->IsString() || !info[1]->IsBoolean()) {
+    Nan::ThrowError("hold takes a reader name and a boolean");
+    return;
+  }
+  info.GetReturnValue().Set(Nan::New(mock::hold(*Nan::Utf8String(info[0]), info[1]->IsTrue())));
+}
+
+/* Run one poll of a listening reader synchronously instead of waiting for its timer */
+void MockTick(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  if(info.Length() != 1 || !info[0]->IsObject()) {
+    Nan::ThrowError("tick takes a reader object");
+    return;
+  }
+  v8::Local<v8::Object> reader = v8::Local<v8::Object>::Cast(info[0]);
+  ReaderData *data = static_cast<ReaderData *>(
+    v8::Local<v8::External>::Cast(
+      Nan::GetPrivate(reader, Nan::New("data").ToLocalChecked()).ToLocalChecked()
+    )->Value()
+  );
+  if(data->callback.IsEmpty()) {
+    Nan::ThrowError("The reader is not listening");
+    return;
+  }
+  reader_poll(data);
+}
+
+/* Replaces the emulated readers: readers(count). Call before getReader */
+void MockReaders(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  if(info.Length() != 1 || !info[0]->IsUint32()) {
+    Nan::ThrowError("readers takes the number of emulated readers");
+    return;
+  }
+  info.GetReturnValue().Set(Nan::New(mock::readers(Nan::To<uint32_t>(info[0]).FromJust())));
+}
+
+/* Starts a tap storm on all readers: storm({rate: arrivals per second and reader, duration: ms}) */
+void MockStorm(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  if(info.Length() != 1 || !info[0]->IsObject()) {
+    Nan::ThrowError("storm takes an options object {rate, duration}");
+    return;
+  }
+  v8::Local<v8::Object> options = v8::Local<v8::Object>::Cast(info[0]);
+  v8::Local<v8::Value> rate = options->Get(Nan::New("rate").ToLocalChecked());
+  v8::Local<v8::Value> duration = options->Get(Nan::New("duration").ToLocalChecked());
+  if(!rate->IsUint32() || !duration->IsUint32()) {
+    Nan::ThrowError("rate and duration have to be positive integers");
+    return;
+  }
+  info.GetReturnValue().Set(Nan::New(mock::start_storm(Nan::To<uint32_t>(rate).FromJust(), Nan::To<uint32_t>(duration).FromJust())));
+}
+
+void MockStop(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  mock::stop_storm();
+}
+
+/* Returns the storm counters and the latency percentiles in microseconds */
+void MockStats(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  mock::StormStats stats = mock::storm_stats();
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  result->Set(Nan::New("generated").ToLocalChecked(), Nan::New<v8::Number>(stats.generated));
+  result->Set(Nan::New("detected").ToLocalChecked(), Nan::New<v8::Number>(stats.detected));
+  result->Set(Nan::New("delivered").ToLocalChecked(), Nan::New<v8::Number>(stats.delivered));
+  result->Set(Nan::New("lost").ToLocalChecked(), Nan::New<v8::Number>(stats.generated > stats.delivered ? stats.generated - stats.delivered : 0));
+
+  v8::Local<v8::Object> latency = Nan::New<v8::Object>();
+  std::vector<uint32_t> &l = stats.latencies;
+  std::sort(l.begin(), l.end());
+  if(!l.empty()) {
+    double sum = 0;
+    for(size_t i = 0; i < l.size(); i++) {
+      sum += l[i];
+    }
+    latency->Set(Nan::New("min").ToLocalChecked(), Nan::New<v8::Number>(l.front()));
+    latency->Set(Nan::New("mean").ToLocalChecked(), Nan::New<v8::Number>(sum / l.size()));
+    latency->Set(Nan::New("p50").ToLocalChecked(), Nan::New<v8::Number>(l[l.size() / 2]));
+    latency->Set(Nan::New("p99").ToLocalChecked(), Nan::New<v8::Number>(l[(l.size() * 99) / 100]));
+    latency->Set(Nan::New("max").ToLocalChecked(), Nan::New<v8::Number>(l.back()));
+  }
+  result->Set(Nan::New("latency").ToLocalChecked(), latency);
+  info.GetReturnValue().Set(result);
+}
+
+void MockCommands(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  info.GetReturnValue().Set(Nan::New<v8::Number>(mock::commands()));
+}
+
+void MockWritten(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  info.GetReturnValue().Set(Nan::New<v8::Number>(mock::written()));
+}
+
+void MockReset(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  mock::reset();
+}
+
+void MockInit(v8::Local<v8::Object> target) {
+  v8::Local<v8::Object> control = Nan::New<v8::Object>();
+  Nan::SetMethod(control, "insert", MockInsert);
+  Nan::SetMethod(control, "remove", MockRemove);
+  Nan::SetMethod(control, "hold", MockHold);
+  Nan::SetMethod(control, "create", MockCreate);
+  Nan::SetMethod(control, "forget", MockForget);
+  Nan::SetMethod(control, "latency", MockLatency);
+  Nan::SetMethod(control, "tick", MockTick);
+  Nan::SetMethod(control, "readers", MockReaders);
+  Nan::SetMethod(control, "storm", MockStorm);
+  Nan::SetMethod(control, "stop", MockStop);
+  Nan::SetMethod(control, "stats", MockStats);
+  Nan::SetMethod(control, "commands", MockCommands);
+  Nan::SetMethod(control, "written", MockWritten);
+  Nan::SetMethod(control, "reset", MockReset);
+  Nan::Set(target, Nan::New("mock").ToLocalChecked(), control);
+}
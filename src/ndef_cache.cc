@@ -0,0 +1,34 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "ndef_cache.h"
+#include "lru_cache.h"
+
+/* Number of cards kept in the cache */
+static const size_t NDEF_CACHE_SIZE = 256;
+
+/* The cache is accessed from the main thread and the job threads */
+static LruCache< std::vector<uint8_t> > cache(NDEF_CACHE_SIZE);
+
+bool ndef_cache_get(const std::string &uid, std::vector<uint8_t> &msg) {
+  LruCache< std::vector<uint8_t> >::Guard guard(cache);
+  std::vector<uint8_t> *found = cache.find(uid);
+  if(!found) {
+    return false;
+  }
+  msg = *found;
+  return true;
+}
+
+void ndef_cache_put(const std::string &uid, const uint8_t *msg, uint16_t len) {
+  if(uid.empty()) {
+    return;
+  }
+  LruCache< std::vector<uint8_t> >::Guard guard(cache);
+  cache.entry(uid).assign(msg, msg + len);
+}
+
+void ndef_cache_drop(const std::string &uid) {
+  LruCache< std::vector<uint8_t> >::Guard guard(cache);
+  cache.erase(uid);
+}
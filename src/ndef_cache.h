@@ -0,0 +1,31 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef NDEF_CACHE_H
+#define NDEF_CACHE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * The last NDEF message read from or written to a card, keyed by the UID.
+ * Used by the differential write to only send the changed bytes.
+ * The cache is shared by all readers and threads and holds a limited number of cards,
+ * the least recently used card is dropped first.
+ */
+
+/**
+ * Lookup the last known NDEF message of a card
+ * @param uid The UID of the card
+ * @param msg Returns a copy of the message
+ * @return false if the content of the card is unknown
+ **/
+bool ndef_cache_get(const std::string &uid, std::vector<uint8_t> &msg);
+
+/** Remember the NDEF message which is now on the card */
+void ndef_cache_put(const std::string &uid, const uint8_t *msg, uint16_t len);
+
+/** Forget the content of a card, e.g. after a failed write or a format */
+void ndef_cache_drop(const std::string &uid);
+
+#endif // NDEF_CACHE_H
@@ -6,7 +6,33 @@
 #include "reader.h"
 #include "desfire.h"
 #include "ultralight.h"
+#include "autoread.h"
+#include "events.h"
+#include "addon.h"
+#include "call_watch.h"
 #include "utils.h"
+#if defined(USE_MOCK)
+#include "mock/mock.h"
+#endif
+
+ReaderData::ReaderData(const char* name, MifareBackend backend, AddonData *addon) : name(name), addon(addon), backend(backend), interval(250), auto_read(0), mode(READER_MODE_CARD), reading(false), timeout(0), async(new Nan::AsyncResource("mifare:Reader")) {
+  this->timer.data = this;
+  uv_timer_init(addon->loop, &timer);
+  switch(backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC: PcscBackend::attach(this); break;
+#endif
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC: NfcBackend::attach(this); break;
+#endif
+    default: break;
+  }
+}
+
+ReaderData::~ReaderData() {
+  callback.Reset();
+  self.Reset();
+}
 
 ReaderData *ReaderData_from_info(const Nan::FunctionCallbackInfo<v8::Value> &info) {
   return static_cast<ReaderData *>(
@@ -19,12 +45,18 @@ ReaderData *ReaderData_from_info(const Nan::FunctionCallbackInfo<v8::Value> &inf
 void callCallback(ReaderData *data, v8::Local<v8::Value> err, v8::Local<v8::Value> reader, v8::Local<v8::Value> card) {
   const unsigned argc = 3;
   v8::Local<v8::Value> argv[argc] = { err, reader, card };
-  Nan::Call(Nan::New<v8::Function>(data->callback), Nan::GetCurrentContext()->Global(), argc, argv);
+#if defined(USE_MOCK)
+  mock::delivered(data->name);
+#endif
+  reader_call(data, Nan::New<v8::Function>(data->callback), argc, argv);
 }
 
+void reader_call(ReaderData *data, v8::Local<v8::Function> callback, int argc, v8::Local<v8::Value> argv[]) {
+  data->async->runInAsyncScope(Nan::GetCurrentContext()->Global(), callback, argc, argv);
+}
 
-#if defined(USE_LIBNFC)
-
+/* The poll timer of a reader. One instance per backend, selected when listen starts the timer */
+template<class Backend>
 #if NODE_VERSION_AT_LEAST(0, 12, 0)
 void reader_timer_callback(uv_timer_t *handle) {
 #else
@@ -32,252 +64,167 @@ void reader_timer_callback(uv_timer_t *handle, int timer_status) {
 #endif
   Nan::HandleScope scope;
   ReaderData *data = static_cast<ReaderData *>(handle->data);
-  v8::Local<v8::String> status;
-  v8::Local<v8::Object> reader = Nan::New(data->self);
-  GuardReader reader_guard(data, true);
-  reader->Set(Nan::New("name").ToLocalChecked(), Nan::New(data->name.c_str()).ToLocalChecked());
-
-  if (!data->device) {
-    reader_guard->unlock();
-    reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("unavailable").ToLocalChecked());
-    const unsigned argc = 3;
-    v8::Local<v8::Value> argv[argc] = {
-      Nan::New("No NFC device associated with this reader").ToLocalChecked(),
-      reader,
-      Nan::Undefined()
-    };
-    Nan::Call(Nan::New<v8::Function>(data->callback), Nan::GetCurrentContext()->Global(), argc, argv);
-    return;
+  if(!data->reading) {
+    uint64_t start = uv_hrtime();
+    Backend::poll(data);
+    // getReader() in the callback only closes the timer, the reader is deleted later
+    watch_poll(data->addon, data->name, start);
   }
+}
 
-  FreefareTag *tags = freefare_get_tags(data->device);
-  int err = nfc_device_get_last_error(data->device);
-  nfc_device_set_property_bool(data->device, NP_INFINITE_SELECT, false);
-  reader_guard->unlock();
-  // return on all but success cases
-  // for succes, we have to distinghish between empty and present
-  if (err != NFC_SUCCESS && err == data->last_err) {
-    freefare_free_tags(tags);
+void reader_poll(ReaderData *data) {
+  if(data->reading) {
     return;
   }
-  if (err == NFC_SUCCESS && tags != NULL && tags[0] != NULL) { // found more than 0 tags -> present
-    data->last_err = err;
-
-    FreefareTag t = NULL;
-    FreefareTag old_tag;
-    size_t len;
-    char *old_tag_uid, *t_uid;
-    // we definetly found new tags if previous search did not get any
-    // else we have to compare in the loop below
-    bool found_new_tag = data->last_uids.size() == 0;
-    for(std::vector<char *>::const_iterator i = data->last_uids.begin(); !found_new_tag && i != data->last_uids.end(); ++i) {
-      found_new_tag = true; // assume tag is new
-      old_tag_uid = *i;
-      int tag_count = 0;
-      for (t = tags[0]; t != NULL && found_new_tag; t=tags[++tag_count]) {
-        t_uid = freefare_get_tag_uid(t);
-        if(0 == strcmp(old_tag_uid, t_uid)) {
-          found_new_tag = false; // unless it matches a known uid
-        }
-        free(t_uid);
-      }
-    }
-
-    // XXX: What happens when an existing tag get's a new uid?!
-    // this would trigger a freefare_free_tags here.
-    if(!found_new_tag) {
-      return;
-    } else {
-      for(std::vector<char *>::iterator i = data->last_uids.begin(); i != data->last_uids.end(); ++i){
-        free(*i);
-        *i = NULL;
-      }
-    }
-    data->last_uids.clear();
-    reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("present").ToLocalChecked());
-
-    t = NULL;
-    int tag_count = 0;
-    bool tags_used = false;
-    for (t = tags[0]; t != NULL; t=tags[++tag_count]) {
-      data->last_uids.push_back(freefare_get_tag_uid(t));
-      // TODO: do something with the tag
-      if(freefare_get_tag_type(t) == MIFARE_DESFIRE) {
-        tags_used = true;
-
-        v8::Local<v8::Object> card = DesfireCreate(data, tags, t);
-
-        const unsigned argc = 3;
-        Nan::Local<v8::Value> argv[argc] = { Nan::Undefined(), reader, card };
-        data->callback->Call(Nan::GetCurrentContext()->Global(), argc, argv);
-        //delete cardData;
-      } else if(freefare_get_tag_type(t) == MIFARE_ULTRALIGHT || freefare_get_tag_type(t) == MIFARE_ULTRALIGHT_C) {
-        tags_used = true;
-
-        v8::Local<v8::Object> card = UltralightCreate(data, tags, t);
-
-        const unsigned argc = 3;
-        Nan::Local<v8::Value> argv[argc] = { Nan::Undefined(), reader, card };
-        data->callback->Call(Nan::GetCurrentContext()->Global(), argc, argv);
-        //delete cardData;
-      }
-    }
-    if(!tags_used) {
-      freefare_free_tags(tags);
-    }
-  } else { // not tag found
-    data->last_err = err;
-    if (err == NFC_SUCCESS) {
-      if(data->last_uids.size() == 0) {
-      // empty -> empty, no change
-        return;
-      }
-      // present -> empty
-      data->last_uids.clear();
-      status = Nan::New("empty");
-    } else if(err == NFC_EIO) {
-      status = Nan::New("ioerror");
-    } else if(err == NFC_EINVARG) {
-      // XXX: should not happen
-    } else if(err == NFC_EDEVNOTSUPP) {
-      status = Nan::New("invalid");
-    } else if(err == NFC_ENOTSUCHDEV) {
-      status = Nan::New("invalid");
-    } else if(err == NFC_ENOTIMPL) {
-      status = Nan::New("invalid");
-    } else if(err == NFC_EOVFLOW) {
-      status = Nan::New("overflow");
-    } else if(err == NFC_ETIMEOUT) {
-      status = Nan::New("timeout");
-    } else if(err == NFC_EOPABORTED) {
-      status = Nan::New("aborted");
-    } else if(err == NFC_ETGRELEASED) {
-      status = Nan::New("released");
-    } else if(err == NFC_ERFTRANS) {
-      status = Nan::New("error");
-    } else if(err == NFC_EMFCAUTHFAIL) {
-      status = Nan::New("authfail");
-    } else if(err == NFC_ESOFT) {
-      status = Nan::New("error");
-    } else if(err == NFC_ECHIP){
-      status = Nan::New("brokenchip");
-    } else {
-      status = make_status("unknown");
-    }
-    /* Came here because err changed. So we call the callback function */
-    reader->Set(Nan::New("status"), status.ToLocalChecked());
-    callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+  uint64_t start = uv_hrtime();
+  switch(data->backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC: PcscBackend::poll(data); break;
+#endif
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC: NfcBackend::poll(data); break;
+#endif
+    default: break;
   }
-  return;
+  watch_poll(data->addon, data->name, start);
 }
-#else  // USE_LIBNFC
 
-#if NODE_VERSION_AT_LEAST(0, 12, 0)
-void reader_timer_callback(uv_timer_t *handle) {
-#else
-void reader_timer_callback(uv_timer_t *handle, int timer_status) {
+void reader_release(ReaderData *data) {
+  uv_timer_stop(&data->timer);
+  switch(data->backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC: PcscBackend::release(data); break;
 #endif
-  Nan::HandleScope scope;
-  ReaderData *data = static_cast<ReaderData *>(handle->data);
-  LONG res;
-  DWORD event;
-  v8::Local<v8::String> status;
-  v8::Local<v8::Object> reader = Nan::New(data->self);
-  reader->Set(Nan::New("name").ToLocalChecked(), Nan::New(data->name.c_str()).ToLocalChecked());
-
-  res = SCardGetStatusChange(data->context->context, 1, &data->state, 1);
-  if(res == SCARD_S_SUCCESS) {
-    event = data->state.dwEventState;
-    if(event & SCARD_STATE_CHANGED) {
-      data->state.dwCurrentState = event;
-      if(event & SCARD_STATE_IGNORE) {
-        status = Nan::New("ignore").ToLocalChecked();
-      } else if(event & SCARD_STATE_ATRMATCH) {
-        status = Nan::New("atrmatch").ToLocalChecked();
-      } else if(event & SCARD_STATE_EXCLUSIVE) {
-        status = Nan::New("exclusive").ToLocalChecked();
-      } else if(event & SCARD_STATE_INUSE) {
-        status = Nan::New("inuse").ToLocalChecked();
-      } else if(event & SCARD_STATE_MUTE) {
-        status = Nan::New("mute").ToLocalChecked();
-      } else if(event & SCARD_STATE_UNKNOWN) {
-        status = Nan::New("unknown").ToLocalChecked();
-      } else if(event & SCARD_STATE_UNAVAILABLE) {
-        status = Nan::New("unavailable").ToLocalChecked();
-      } else if(event & SCARD_STATE_EMPTY) {
-        status = Nan::New("empty").ToLocalChecked();
-      } else if(event & SCARD_STATE_PRESENT) {
-        status = Nan::New("present").ToLocalChecked();
-      }
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC: NfcBackend::release(data); break;
+#endif
+    default: break;
+  }
+  data->callback.Reset();
+  data->self.Reset();
+  if(data->events) {
+    // Ends a running events() iteration, its iterator may outlive the reader
+    data->events->detach();
+    data->events.reset();
+  }
+}
 
-      // Prepare readerObject event
-      reader->Set(Nan::New("status").ToLocalChecked(), status);
+/* The loop is done with the timer, the reader can go */
+static void reader_closed(uv_handle_t *handle) {
+  ReaderData *data = static_cast<ReaderData *>(handle->data);
+  data->addon->closing--;
+  delete data;
+}
 
-      // Card object, will be eventually filled lateron
-      if(event & SCARD_STATE_PRESENT) {
-        // Establishes a connection to a smart card contained by a specific reader.
-        FreefareTag *tags = freefare_get_tags_pcsc(data->context, data->state.szReader);
-        // XXX: With PCSC tags is always length 2 with {tag, NULL} we assume this is allways the case here!!!!
-        for(int i = 0; (!res) && tags && tags[i]; i++) {
-          if(tags[i] && freefare_get_tag_type(tags[i]) == MIFARE_DESFIRE) {
-            v8::Local<v8::Object> card = DesfireCreate(data, tags, tags[i]);
-            callCallback(data, Nan::Undefined(), reader, card);
-          } else if(freefare_get_tag_type(tags[i]) == MIFARE_ULTRALIGHT || freefare_get_tag_type(tags[i]) == MIFARE_ULTRALIGHT_C) {
-            v8::Local<v8::Object> card = UltralightCreate(data, tags, tags[i]);
-            callCallback(data, Nan::Undefined(), reader, card);
-          }
-        }
-      } else {
-        callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
-      }
-    }
-  } else if(static_cast<unsigned int>(res) == SCARD_E_TIMEOUT) {
-      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("timeout").ToLocalChecked());
-      callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
-  } else {
-      reader->Set(Nan::New("status").ToLocalChecked(), Nan::New("unknown").ToLocalChecked());
-      callCallback(data, Nan::Undefined(), reader, Nan::Undefined());
+void reader_destroy(ReaderData *data) {
+  reader_release(data);
+  switch(data->backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC: PcscBackend::detach(data); break;
+#endif
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC: NfcBackend::detach(data); break;
+#endif
+    default: break;
   }
+  {
+    // Emits the destroy hook of the async context
+    Nan::HandleScope scope;
+    delete data->async;
+    data->async = NULL;
+  }
+  // The timer is linked into the loop until it is closed
+  data->addon->closing++;
+  uv_close(reinterpret_cast<uv_handle_t *>(&data->timer), reader_closed);
 }
-#endif // USE_LIBNFC
 
 void ReaderRelease(const Nan::FunctionCallbackInfo<v8::Value>& info) {
   ReaderData *data = ReaderData_from_info(info);
   if(info.Length()!=0) {
     Nan::ThrowError("release does not take any arguments");
   } else {
-    //if(data->timer) {
-      uv_timer_stop(&data->timer);
-    //}
-#if defined(USE_LIBNFC)
-    GuardReader reader_guard(data, true);
-    if (data->device) {
-      nfc_close(data->device);
-    }
-#endif
-    data->callback.Reset();
-    data->self.Reset();
+    reader_release(data);
     info.GetReturnValue().Set(info.This());
   }
 }
 
+bool reader_listen(ReaderData *data, v8::Local<v8::Object> self, v8::Local<v8::Function> callback, v8::Local<v8::Object> options) {
+  unsigned int auto_read = 0;
+  ReaderMode mode = READER_MODE_CARD;
+  uint32_t min_presence = 0, departure_grace = 0, retap_window = 0, timeout = 0;
+  v8::Local<v8::Value> interval = options->Get(Nan::New("interval").ToLocalChecked());
+  if(interval->IsUint32() && Nan::To<uint32_t>(interval).FromJust() > 0) {
+    data->interval = Nan::To<uint32_t>(interval).FromJust();
+  }
+  if(!AutoReadOption(options->Get(Nan::New("autoRead").ToLocalChecked()), auto_read)) {
+    Nan::ThrowError("The autoRead option is an array of \"uid\", \"ndef\" and \"version\"");
+    return false;
+  }
+  v8::Local<v8::Value> mode_value = options->Get(Nan::New("mode").ToLocalChecked());
+  if(mode_value->Equals(Nan::New("uid").ToLocalChecked())) {
+    mode = READER_MODE_UID;
+  } else if(!mode_value->IsUndefined() && !mode_value->Equals(Nan::New("card").ToLocalChecked())) {
+    Nan::ThrowError("The mode option is \"card\" or \"uid\"");
+    return false;
+  }
+  v8::Local<v8::Value> filter_option = options->Get(Nan::New("minPresence").ToLocalChecked());
+  if(filter_option->IsUint32()) {
+    min_presence = Nan::To<uint32_t>(filter_option).FromJust();
+  }
+  filter_option = options->Get(Nan::New("departureGrace").ToLocalChecked());
+  if(filter_option->IsUint32()) {
+    departure_grace = Nan::To<uint32_t>(filter_option).FromJust();
+  }
+  filter_option = options->Get(Nan::New("retapWindow").ToLocalChecked());
+  if(filter_option->IsUint32()) {
+    retap_window = Nan::To<uint32_t>(filter_option).FromJust();
+  }
+  filter_option = options->Get(Nan::New("timeout").ToLocalChecked());
+  if(filter_option->IsUint32()) {
+    timeout = Nan::To<uint32_t>(filter_option).FromJust();
+  }
+  data->auto_read = auto_read;
+  data->timeout = timeout;
+  data->mode = mode;
+  data->filter.configure(min_presence, departure_grace, retap_window);
+
+  data->callback.Reset(callback);
+  data->self.Reset(self);
+
+  // The backend is resolved here once, the timer runs the poll of the backend without further dispatch
+  uv_timer_cb poll = NULL;
+  switch(data->backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC:
+      PcscBackend::listen(data);
+      poll = reader_timer_callback<PcscBackend>;
+      break;
+#endif
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC:
+      NfcBackend::listen(data);
+      poll = reader_timer_callback<NfcBackend>;
+      break;
+#endif
+    default: break;
+  }
+  uv_timer_start(&data->timer, poll, 500, data->interval);
+  return true;
+}
+
 void ReaderListen(const Nan::FunctionCallbackInfo<v8::Value>& info) {
   ReaderData *data = ReaderData_from_info(info);
-  if(info.Length()!=1 || !info[0]->IsFunction()) {
-    Nan::ThrowError("The only argument to listen has to be a callback function");
-  } else{
-
-#if defined(USE_LIBNFC)
-    GuardReader reader_guard(data, true);
-    if (data->context && data->device == NULL) {
-      data->device = nfc_open(data->context, data->name.c_str());
+  if(info.Length()<1 || info.Length()>2 || !info[0]->IsFunction() || (info.Length()==2 && !info[1]->IsObject())) {
+    Nan::ThrowError("The arguments to listen are a callback function and an optional options object {interval:ms, autoRead:[\"uid\", \"ndef\", \"version\"], mode:\"card\"|\"uid\", minPresence:ms, departureGrace:ms, retapWindow:ms, timeout:ms}");
+  } else {
+    v8::Local<v8::Object> options = info.Length()==2 ? v8::Local<v8::Object>::Cast(info[1]) : Nan::New<v8::Object>();
+    if(data->events) {
+      // A plain callback replaces a running events() iteration
+      data->events->detach();
+      data->events.reset();
+    }
+    if(reader_listen(data, info.This(), info[0].As<v8::Function>(), options)) {
+      info.GetReturnValue().Set(info.This());
     }
-#endif
-    data->callback.Reset(info[0].As<v8::Function>());
-    data->self.Reset(info.This());
-
-    uv_timer_start(&data->timer, reader_timer_callback, 500, 250);
-    info.GetReturnValue().Set(info.This());
   }
 }
-
@@ -9,91 +9,162 @@
 #include <vector>
 #include <iostream>
 #include <cstring>
+#include <memory>
 
-#if ! defined(USE_LIBNFC)
-#if defined(__APPLE__) || defined(__linux__)
-#include <PCSC/winscard.h>
-#include <PCSC/wintypes.h>
-#else
-#include <winscard.h>
-#endif
-#include <freefare_pcsc.h>
-#else // USE_LIBNFC
-#include <nfc/nfc.h>
-#include <freefare_nfc.h>
-#endif // USE_LIBNFC
+#include "backend.h"
+#include "filter.h"
+#include "device_lock.h"
+#include "arena.h"
 #include <cstdlib>
 
+/* Data read before a card is reported, see listen({autoRead}) */
+enum AutoRead {
+  AUTO_READ_UID = 1,
+  AUTO_READ_NDEF = 2,
+  AUTO_READ_VERSION = 4
+};
+
+/* What listen reports for a card */
+enum ReaderMode {
+  // A card object with all functions
+  READER_MODE_CARD = 0,
+  // Only the UID as Buffer, no card objects are created
+  READER_MODE_UID = 1
+};
+
+class EventQueue;
+struct AddonData;
+
 struct ReaderData {
   /**
    * Create a new reader status instance
-   * @param name The name of the reader
-   * @return The SCARD_READERSTATE object representating this object
+   * @param name The name of the reader (PCSC reader name or libnfc connstring)
+   * @param backend The backend driving this reader
+   * @param addon The addon instance owning the reader, its loop runs the timer
    */
-  ReaderData(const char* name,
-#if defined(USE_LIBNFC)
-      nfc_context *context,
-      nfc_device *device = NULL
-#else
-      pcsc_context *hContext
-#endif
-  )
-  {
-    this->name = std::string(name);
-    this->timer.data = this;
-#if defined(USE_LIBNFC)
-    this->context = context;
-    this->last_err = NFC_ENOTSUCHDEV;
-    this->device = device;
-#else
-    this->context = hContext;
-    this->state.szReader = this->name.c_str();
-    this->state.dwCurrentState = SCARD_STATE_UNAWARE;
-    this->state.pvUserData = this;
-#endif
-    uv_mutex_init(&this->mDevice);
-    uv_timer_init(uv_default_loop(), &timer);
-  }
-
-  ~ReaderData() {
-    uv_timer_stop(&timer);
-#ifdef USE_LIBNFC
-    if (device) {
-      nfc_close(device);
-    }
-    device = NULL;
-#else
-    state.szReader = NULL;
-#endif
-    uv_mutex_destroy(&mDevice);
-    callback.Reset();
-    self.Reset();
-  };
+  ReaderData(const char* name, MifareBackend backend, AddonData *addon);
+
+  ~ReaderData();
 
   std::string name;
+  AddonData *addon;
+  MifareBackend backend;
   uv_timer_t timer;
-#if defined(USE_LIBNFC)
-  nfc_context *context;
+  // Poll interval of the timer in milliseconds
+  uint64_t interval;
+  // AutoRead flags of the listen options
+  unsigned int auto_read;
+  ReaderMode mode;
+  // Debounce of arrivals and departures
+  PresenceFilter filter;
+  // A card is read on a worker thread, the reader is not polled meanwhile
+  bool reading;
+  // Deadline of each command on a card in ms, 0 for none
+  uint32_t timeout;
+  // The queue of the running reader.events() iteration, shared with its iterator
+  std::shared_ptr<EventQueue> events;
+#if defined(HAVE_LIBNFC)
+  // Own context of the reader, from its probe
+  nfc_context *nfc;
   int last_err;
   std::vector< char* > last_uids;
   nfc_device *device;
-#else
+  // The device failed and is reopened in the background, see NfcBackend::poll
+  bool broken;
+  // Next reopen in ns of uv_hrtime and the backoff in ms
+  uint64_t reopen_at;
+  uint32_t reopen_delay;
+#endif
+#if defined(HAVE_PCSC)
   SCARD_READERSTATE state;
-  pcsc_context *context;
+  pcsc_context *pcsc;
 #endif
-  uv_mutex_t mDevice;
+  // Exclusive access to the device, fair between the main thread and the pool
+  DeviceLock mDevice;
+  // Scratch buffers of the card session holding the device, reset when it ends
+  Arena scratch;
+  // NDEF message of the session holding the device, see DesfireGuardTag::message
+  std::vector<uint8_t> message;
   Nan::Persistent<v8::Function> callback;
   Nan::Persistent<v8::Object> self;
+  // Async context of the callbacks run for this reader, freed by reader_destroy
+  Nan::AsyncResource *async;
+};
+
+/* Scope guard for exclusive access to the device of a reader */
+class GuardReader {
+  public:
+    /* Locks the device imideatly if active is true */
+    GuardReader(ReaderData *data, bool active = true) : m_data(data), m_active(false) {
+      if(active) {
+        lock();
+      }
+    }
+
+    /* Destructor. Unlocks the device if still locked */
+    ~GuardReader() {
+      unlock();
+    }
+
+    void lock() {
+      if(!m_active) {
+        m_data->mDevice.lock();
+        m_active = true;
+      }
+    }
+
+    void unlock() {
+      if(m_active) {
+        m_data->mDevice.unlock();
+        m_active = false;
+      }
+    }
+
+  private:
+    ReaderData *m_data;
+    bool m_active;
 };
 
 ReaderData *ReaderData_from_info(const Nan::FunctionCallbackInfo<v8::Value> &info);
 void callCallback(ReaderData *data, v8::Local<v8::Value> err, v8::Local<v8::Value> reader, v8::Local<v8::Value> card);
 
-#if NODE_VERSION_AT_LEAST(0, 12, 0)
-void reader_timer_callback(uv_timer_t *handle);
-#else
-void reader_timer_callback(uv_timer_t *handle, int timer_status);
-#endif
+/**
+ * Run a javascript callback from the loop in the async context of a reader.
+ * The microtasks run afterwards, so promises resolved in the callback settle right away.
+ * @param data The reader the callback belongs to
+ * @param callback The function, called with the global object as this
+ **/
+void reader_call(ReaderData *data, v8::Local<v8::Function> callback, int argc, v8::Local<v8::Value> argv[]);
+
+/**
+ * Poll a reader once with its backend
+ * @param data The reader
+ **/
+void reader_poll(ReaderData *data);
+
+/**
+ * Start polling a reader
+ * @param data The reader
+ * @param self The javascript reader object
+ * @param callback Called with (err, reader, card) for every event
+ * @param options The listen options
+ * @return false if the options are invalid, a javascript exception is thrown then
+ **/
+bool reader_listen(ReaderData *data, v8::Local<v8::Object> self, v8::Local<v8::Function> callback, v8::Local<v8::Object> options);
+
+/**
+ * Stop polling a reader
+ * @param data The reader
+ **/
+void reader_release(ReaderData *data);
+
+/**
+ * Release a reader and detach it from its device.
+ * The reader is deleted when the loop has closed its timer.
+ * @param data The reader
+ **/
+void reader_destroy(ReaderData *data);
+
 void ReaderRelease(const Nan::FunctionCallbackInfo<v8::Value>& info);
 void ReaderListen(const Nan::FunctionCallbackInfo<v8::Value>& info);
 
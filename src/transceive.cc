@@ -0,0 +1,96 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+
+#include "transceive.h"
+#include "reader.h"
+
+RawChannel::RawChannel(ReaderData *reader, Deadline *deadline) : m_reader(reader), m_deadline(deadline), m_open(false), m_error(0) {
+#if defined(HAVE_PCSC)
+  m_card = 0;
+  m_protocol = 0;
+#endif
+}
+
+RawChannel::~RawChannel() {
+  close();
+}
+
+res_t RawChannel::open() {
+  close();
+  switch(m_reader->backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC: {
+      LONG res = SCardConnect(m_reader->pcsc->context, m_reader->name.c_str(), SCARD_SHARE_SHARED,
+                              SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1, &m_card, &m_protocol);
+      if(res != SCARD_S_SUCCESS) {
+        m_error = res;
+        return -1;
+      }
+      break;
+    }
+#endif
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC:
+      // The target is selected by the connect of libfreefare
+      if(!m_reader->device) {
+        m_error = NFC_ENOTSUCHDEV;
+        return -1;
+      }
+      break;
+#endif
+    default:
+      return -1;
+  }
+  m_open = true;
+  return 0;
+}
+
+void RawChannel::close() {
+  if(!m_open) {
+    return;
+  }
+#if defined(HAVE_PCSC)
+  if(m_reader->backend == BACKEND_PCSC) {
+    SCardDisconnect(m_card, SCARD_LEAVE_CARD);
+  }
+#endif
+  m_open = false;
+}
+
+res_t RawChannel::transmit(const uint8_t *command, size_t command_len, uint8_t *response, size_t &response_len) {
+  if(!m_open) {
+    return -1;
+  }
+  if(m_deadline) {
+    // Every command gets the whole deadline
+    m_deadline->restart();
+  }
+  switch(m_reader->backend) {
+#if defined(HAVE_PCSC)
+    case BACKEND_PCSC: {
+      SCARD_IO_REQUEST pci = {m_protocol, sizeof(SCARD_IO_REQUEST)};
+      DWORD length = response_len;
+      LONG res = SCardTransmit(m_card, &pci, command, command_len, NULL, response, &length);
+      if(res != SCARD_S_SUCCESS) {
+        m_error = res;
+        return -1;
+      }
+      response_len = length;
+      return 0;
+    }
+#endif
+#if defined(HAVE_LIBNFC)
+    case BACKEND_LIBNFC: {
+      int res = nfc_initiator_transceive_bytes(m_reader->device, command, command_len, response, response_len, -1);
+      if(res < 0) {
+        m_error = res;
+        return -1;
+      }
+      response_len = res;
+      return 0;
+    }
+#endif
+    default:
+      return -1;
+  }
+}
@@ -0,0 +1,68 @@
+// Copyright 2026, node-mifare contributors
+// See LICENCE for more information
+#ifndef TRANSCEIVE_H
+#define TRANSCEIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "backend.h"
+#include "deadline.h"
+
+struct ReaderData;
+
+/* Longest response of a short APDU: 256 bytes of data and the status word */
+static const size_t TRANSCEIVE_MAX_RESPONSE = 258;
+
+/*
+ * A raw channel to the card in the field of a reader, for commands libfreefare does not wrap.
+ * PCSC opens a second shared handle to the reader and uses SCardTransmit,
+ * libnfc sends the bytes to the selected target with nfc_initiator_transceive_bytes.
+ * Open it while the card is guarded, so nobody else talks to the card in between.
+ * The deadline of the session, if any, is restarted for every command like the commands in the guards.
+ */
+class RawChannel {
+  public:
+    RawChannel(ReaderData *reader, Deadline *deadline = NULL);
+
+    /* Closes the channel */
+    ~RawChannel();
+
+    /* Open the channel. Returns a negative value on failure, error() has the code of the backend then */
+    res_t open();
+
+    /* Close the channel, done by the destructor as well */
+    void close();
+
+    /**
+     * Send a command and receive the response
+     * @param command The bytes to send
+     * @param command_len The number of bytes to send
+     * @param response Receives the response
+     * @param response_len The size of response, returns the length of the response
+     * @return A negative value on failure, error() has the code of the backend then
+     **/
+    res_t transmit(const uint8_t *command, size_t command_len, uint8_t *response, size_t &response_len);
+
+    /* The error code of the backend of the last failure */
+    res_t error() const {
+      return m_error;
+    }
+
+    /* True if the last failure came after the deadline */
+    bool expired() const {
+      return m_deadline && m_deadline->expired();
+    }
+
+  private:
+    ReaderData *m_reader;
+    Deadline *m_deadline;
+    bool m_open;
+    res_t m_error;
+#if defined(HAVE_PCSC)
+    SCARDHANDLE m_card;
+    DWORD m_protocol;
+#endif
+};
+
+#endif // TRANSCEIVE_H
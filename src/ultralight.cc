@@ -1,35 +1,55 @@
 // Copyright 2019, Rolf Meyer
 // See LICENCE for more information
 
+#include <cctype>
+
 #include "ultralight.h"
+#include "addon.h"
+#include "call_watch.h"
 #include "utils.h"
 
-v8::Local<v8::Object> UltralightCreate(ReaderData *reader, FreefareTag *tagList, FreefareTag activeTag) {
+/* Value of a hex digit */
+static uint8_t hex_nibble(char c) {
+  return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+/* Reader and UID of a card in a report of the call watch */
+static void UltralightSubject(v8::Local<v8::Object> card, std::string &reader, std::string &uid) {
+  UltralightData *data = static_cast<UltralightData *>(
+    v8::Local<v8::External>::Cast(Nan::GetPrivate(card, Nan::New("data").ToLocalChecked()).ToLocalChecked())->Value());
+  if(data) {
+    reader = data->reader->name;
+    // Known once info() read it, the tag is not asked after a failed call
+    uid = data->uid;
+  }
+}
+
+v8::Local<v8::Object> UltralightCreate(ReaderData *reader, const TagsPtr &tagList, FreefareTag activeTag) {
   UltralightData *cardData = new UltralightData(reader, tagList);
   cardData->tag = activeTag;
   v8::Local<v8::Object> card = Nan::New<v8::Object>();
   Nan::Set(card, Nan::New("type").ToLocalChecked(), Nan::New("ultralight").ToLocalChecked());
-  Nan::SetPrivate(card, Nan::New("data").ToLocalChecked(), Nan::New<v8::External>(cardData));
-
-  Nan::SetMethod(card, "info", UltralightInfo);
-  Nan::SetMethod(card, "freeMemory", UltralightAny);
-  Nan::SetMethod(card, "format", UltralightAny);
-  Nan::SetMethod(card, "createNdef", UltralightAny);
-  Nan::SetMethod(card, "readNdef", UltralightAny);
-  Nan::SetMethod(card, "writeNdef", UltralightAny);
+  card_attach(card, cardData);
+
+  watch_method(card, "info", UltralightInfo, UltralightSubject, reader->addon);
+  watch_method(card, "freeMemory", UltralightAny, UltralightSubject, reader->addon);
+  watch_method(card, "format", UltralightAny, UltralightSubject, reader->addon);
+  watch_method(card, "createNdef", UltralightAny, UltralightSubject, reader->addon);
+  watch_method(card, "readNdef", UltralightAny, UltralightSubject, reader->addon);
+  watch_method(card, "writeNdef", UltralightAny, UltralightSubject, reader->addon);
   //Nan::SetMethod(card, "freeMemory", CardFreeMemory);
   //Nan::SetMethod(card, "format", CardFormat);
   //Nan::SetMethod(card, "createNdef", CardCreateNdef);
   //Nan::SetMethod(card, "readNdef", CardReadNdef);
   //Nan::SetMethod(card, "writeNdef", CardWriteNdef);
-  Nan::SetMethod(card, "free", UltralightFree);
+  watch_method(card, "free", UltralightFree, UltralightSubject, reader->addon);
   return card;
 }
 
 void UltralightInfo(const Nan::FunctionCallbackInfo<v8::Value> &v8info) {
   try {
     v8::Local<v8::Object> card = Nan::New<v8::Object>();
-    char *uid_c;
+    char *uid_c = NULL;
 
     if(v8info.Length()!=0) {
       throw errorResult(v8info, 0x12302, "This function takes no arguments");
@@ -37,22 +57,22 @@ void UltralightInfo(const Nan::FunctionCallbackInfo<v8::Value> &v8info) {
     { // Guarded realm;
       UltralightGuardTag tag(v8info);
       tag.retry(0x12304, "Fetch Tag Version Info",
-                [&]()mutable->res_t{uid_c = freefare_get_tag_uid (tag); return 0;});
-    }
-
-    v8::Local<v8::Array> uid = Nan::New<v8::Array>(7);
-    for(unsigned int j=0; j<7; j++) {
-      uid->Set(j, Nan::New(uid_c[j]));
+                [&]()mutable->res_t{uid_c = freefare_get_tag_uid (tag); return uid_c ? 0 : -1;});
+      // For the reports of the call watch
+      tag.data()->uid = uid_c;
     }
-    card->Set(Nan::New("uid").ToLocalChecked(), uid);
 
-    v8::Local<v8::Array> bno = Nan::New<v8::Array>(5);
-    for(unsigned int j=7; j<14; j++) {
-      bno->Set(j-7, Nan::New(uid_c[j]));
+    // libfreefare reports the UID as hex string, the bytes go to one Buffer like the uid of a DESFire card.
+    // An Ultralight card has no batch number, it is an empty Buffer
+    uint8_t uid[10];
+    size_t uid_len = 0;
+    for(const char *c = uid_c; uid_len < sizeof(uid) && isxdigit(c[0]) && isxdigit(c[1]); c += 2) {
+      uid[uid_len++] = (hex_nibble(c[0]) << 4) | hex_nibble(c[1]);
     }
-    card->Set(Nan::New("batchNumber").ToLocalChecked(), bno);
-    v8info.GetReturnValue().Set(card);
+    card->Set(Nan::New("uid").ToLocalChecked(), Nan::CopyBuffer(reinterpret_cast<char *>(uid), uid_len).ToLocalChecked());
+    card->Set(Nan::New("batchNumber").ToLocalChecked(), Nan::NewBuffer(0).ToLocalChecked());
     free(uid_c);
+    v8info.GetReturnValue().Set(card);
   } catch(MifareError err) {
     // The error is already assigned to the InfoScope
   }
@@ -103,7 +123,7 @@ void UltralightFree(const Nan::FunctionCallbackInfo<v8::Value> &info) {
       throw errorResult(info, 0x12321, "This function takes no arguments");
     }
 
-    delete data;
+    card_release(info.This(), data);
     data = NULL;
     validTrue(info);
   } catch(MifareError err) {
@@ -10,44 +10,34 @@
 #include <cstring>
 #include <memory>
 
-#if ! defined(USE_LIBNFC)
-#if defined(__APPLE__) || defined(__linux__)
-#include <PCSC/winscard.h>
-#include <PCSC/wintypes.h>
-#else
-#include <winscard.h>
-#endif
-#include <freefare_pcsc.h>
-#else
-#include <freefare_nfc.h>
-#endif // ! USE_LIBNFC
+#include "backend.h"
 
+#include "card.h"
 #include "reader.h"
+#include "deadline.h"
 #include "utils.h"
 #include <cstdlib>
-#include <functional>
 
 /* A data object collecting all interesting details for a tag */
 class UltralightData {
   public:
     /* The data object is created from a reader data object and a freefare tag object */
-    UltralightData(ReaderData *reader, FreefareTag *tags) : reader(reader), tags(tags) {
+    UltralightData(ReaderData *reader, const TagsPtr &tags) : reader(reader), tag(NULL), tags(tags) {
     }
 
-    /* If destroyed it will free the tags as well */
+    /* If destroyed it will free the tags as well, unless another card of the same poll still uses them */
     ~UltralightData() {
-      if(tag) {
-        freefare_free_tags(tags);
-      }
       tag = NULL;
-      tags = NULL;
     }
 
     ReaderData *reader;
     FreefareTag tag;
-    // The shared pointer makes problems. tags is not an C++ object and needs an special destructor
-    //std::shared_ptr<FreefareTag> tags;
-    FreefareTag *tags;
+    // The tag list the tag belongs to
+    TagsPtr tags;
+    // UID as hex string, set when info() read it
+    std::string uid;
+    // Weak handle of the card object, see card_attach
+    Nan::Persistent<v8::Object> self;
 };
 
 /* Extracts Tag data object from nodejs info context */
@@ -101,12 +91,15 @@ class UltralightGuardTag {
     }
 
     /* Retry a closure/lambda n times and throw an error on failiur with pos_code and name */
-    res_t retry(unsigned int pos_code, const char *name, std::function<res_t ()> try_f, int tries=3) {
+    template<class Try>
+    res_t retry(unsigned int pos_code, const char *name, Try try_f, int tries=3) {
       //std::cout << "ReTry " << name << std::endl;
       res_t ret_code = 0;
       unsigned int int_code = 0;
       while(tries>0) {
         //std::cout << "Try " << tries << " " << name << std::endl;
+        // Every command gets the whole deadline
+        m_deadline.restart();
         freefare_clear_internal_error(m_data->tag);
         ret_code = try_f();
         int_code = error();
@@ -114,7 +107,9 @@ class UltralightGuardTag {
         if(ret_code>=0) {
           return ret_code;
         } else { // ERROR ret is negative
-          if(int_code==28) {
+          if(m_deadline.expired()) {
+            throw errorResult(m_info, DEADLINE_ERROR, "Deadline exceeded", int_code, name);
+          } else if(int_code==28) {
             // ILLEGAL_COMMAND: Propably due to to short time for initialization
             continue;
           } else if(int_code==0x80100010) {
@@ -165,8 +160,15 @@ class UltralightGuardTag {
       //std::cout << "Guard " << std::endl;
       if(!m_active) {
         int res = 0;
-        uv_mutex_lock(  &m_reader->mDevice);
+        m_deadline.start(m_reader, m_reader->timeout);
+        if(!m_reader->mDevice.lock(m_deadline.end())) {
+          m_deadline.stop();
+          throw errorResult(m_info, DEADLINE_ERROR, "Deadline exceeded", 0, "Wait for the reader");
+        }
+        // The wait for the reader does not count against the connect
+        m_deadline.restart();
         if(m_data) {
+          DeviceBackoff backoff(m_deadline.end());
           while(1) {
             //std::cout << "Guard: Connect" << std::endl;
             freefare_clear_internal_error(m_data->tag);
@@ -174,19 +176,28 @@ class UltralightGuardTag {
             /*if(res==240) { // ERROR_VC_DISCONNECTED - Card needs reconnect
               res = mifare_desfire_reconnect(m_data->tag);
             }*/
-            if(res && error() == 0x8010000B) {
+            if(res && m_deadline.expired()) {
+              m_reader->mDevice.unlock();
+              m_deadline.stop();
+              throw errorResult(m_info, DEADLINE_ERROR, "Deadline exceeded", error(), "Can't conntect to Mifare Ultralight target.");
+            } else if(res && (error() == 0x8010000B || error() == ENXIO)) {
               //std::cout << "Guard: Not a Command" << std::endl;
-              // SCARD_E_SHARING_VIOLATION
-              // The smart card cannot be accessed because of other connections outstanding
-              mifare_sleep();
-              continue;
-            } else if(res && error() == ENXIO) {
-              //std::cout << "Guard: Disconnect. Should not be connected anymore" << std::endl;
-              mifare_ultralight_disconnect(m_data->tag);
+              // SCARD_E_SHARING_VIOLATION: The smart card cannot be accessed because of other connections outstanding
+              // ENXIO: Should not be connected anymore
+              unsigned int busy = error();
+              if(busy == ENXIO) {
+                mifare_ultralight_disconnect(m_data->tag);
+              }
+              if(!backoff.wait()) {
+                m_reader->mDevice.unlock();
+                m_deadline.stop();
+                throw errorResult(m_info, DEVICE_BUSY_ERROR, "Card in use by another application", busy, "Can't conntect to Mifare Ultralight target.");
+              }
               continue;
             } else if(res) {
               //std::cout << "Guard: Throw error: " << res << " " << error() << " " << errno << std::endl;
-              uv_mutex_unlock(&m_reader->mDevice);
+              m_reader->mDevice.unlock();
+              m_deadline.stop();
 
               throw errorResult(m_info, 0x12303, errorString(), error(), "Can't conntect to Mifare DESFire target.");
               break;
@@ -211,7 +222,8 @@ class UltralightGuardTag {
           //std::cout << "UnGuard: Disconnect" << std::endl;
           mifare_ultralight_disconnect(m_data->tag);
         }
-        uv_mutex_unlock(&m_reader->mDevice);
+        m_reader->mDevice.unlock();
+        m_deadline.stop();
       }
       m_active = false;
     }
@@ -221,9 +233,11 @@ class UltralightGuardTag {
     UltralightData *m_data;
     ReaderData *m_reader;
     bool m_active;
+    // Deadline of the connect and of each command, runs while the tag is guarded
+    Deadline m_deadline;
 };
 
-v8::Local<v8::Object> UltralightCreate(ReaderData *reader, FreefareTag *tagList, FreefareTag activeTag);
+v8::Local<v8::Object> UltralightCreate(ReaderData *reader, const TagsPtr &tagList, FreefareTag activeTag);
 
 /** Extract tag data from info nodejs info object */
 UltralightData *UltralightData_from_info(const Nan::FunctionCallbackInfo<v8::Value> &info);
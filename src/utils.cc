@@ -21,19 +21,23 @@ MifareError errorResult(const Nan::FunctionCallbackInfo<v8::Value> &info, int no
 }
 
 MifareError errorResult(const Nan::FunctionCallbackInfo<v8::Value> &info, int no, const char *msg, unsigned int res, const char *msg2) {
+  MifareError err(msg, no, res, msg2);
   v8::Local<v8::Object> result = Nan::New<v8::Object>();
   v8::Local<v8::Array> errors = Nan::New<v8::Array>();
-  v8::Local<v8::Object> error = Nan::New<v8::Object>();
-
-  error->Set(Nan::New("code").ToLocalChecked(), Nan::New(no));
-  error->Set(Nan::New("msg").ToLocalChecked(), Nan::New(msg).ToLocalChecked());
-  error->Set(Nan::New("msg2").ToLocalChecked(), Nan::New(msg2).ToLocalChecked());
-  error->Set(Nan::New("res").ToLocalChecked(), Nan::New(res));
-  errors->Set(0, error);
+  errors->Set(0, errorObject(err));
   result->Set(Nan::New("err").ToLocalChecked(), errors);
   result->Set(Nan::New("data").ToLocalChecked(), Nan::Undefined());
   info.GetReturnValue().Set(result);
-  return MifareError(msg, no);
+  return err;
+}
+
+v8::Local<v8::Object> errorObject(const MifareError &err) {
+  v8::Local<v8::Object> error = Nan::New<v8::Object>();
+  error->Set(Nan::New("code").ToLocalChecked(), Nan::New(err.id()));
+  error->Set(Nan::New("msg").ToLocalChecked(), Nan::New(err.what()).ToLocalChecked());
+  error->Set(Nan::New("msg2").ToLocalChecked(), Nan::New(err.what2()).ToLocalChecked());
+  error->Set(Nan::New("res").ToLocalChecked(), Nan::New(err.res()));
+  return error;
 }
 
 v8::Local<v8::Object> buffer(uint8_t *data, size_t len) {
@@ -45,6 +49,16 @@ v8::Local<v8::Object> buffer(uint8_t *data, size_t len) {
   return result;
 }
 
+std::string hexString(const uint8_t *data, size_t len) {
+  static const char digits[] = "0123456789abcdef";
+  std::string result(2 * len, '0');
+  for(size_t i = 0; i < len; i++) {
+    result[2 * i] = digits[data[i] >> 4];
+    result[2 * i + 1] = digits[data[i] & 0x0F];
+  }
+  return result;
+}
+
 static int mifare_sleep_msec = 0;
 
 void mifare_set_sleep(const Nan::FunctionCallbackInfo<v8::Value> &v8info) {
@@ -5,25 +5,9 @@
 #include <iostream>
 #include <cstring>
 #include <exception>
+#include <string>
 
-#ifndef USE_LIBNFC
-#if defined(__APPLE__) || defined(__linux__)
-#include <PCSC/winscard.h>
-#include <PCSC/wintypes.h>
-#else
-#include <winscard.h>
-#endif
-#include <freefare_pcsc.h>
-#else // USE_LIBNFC
-#include <nfc/nfc.h>
-#include <freefare_nfc.h>
-#endif // USE_LIBNFC
-
-#if defined(USE_LIBNFC)
-  typedef int res_t;
-#else
-  typedef LONG res_t;
-#endif
+#include "backend.h"
 
 #if !defined(_NOEXCEPT)
 #define _NOEXCEPT throw()
@@ -39,8 +23,11 @@ class MifareError : public std::exception {
      * This exception takes a message and a id to construct
      * @param msg The error message.
      * @param id The error code.
+     * @param res An internal error code from the underlying implementation (PCSC).
+     * @param msg2 The name of the failed step.
      **/
-    MifareError(const char *msg = NULL, const int id = 0) : m_id(id), m_msg(msg) {}
+    MifareError(const char *msg = NULL, const int id = 0, unsigned int res = 0, const char *msg2 = NULL)
+      : m_id(id), m_res(res), m_msg(msg ? msg : ""), m_msg2(msg2 ? msg2 : "") {}
 
     /**
      * For some reason the destructor is explecite not allowed to throw anything in nodejs 0.10.x.
@@ -53,7 +40,7 @@ class MifareError : public std::exception {
      * @return The exception message.
      **/
     virtual const char *what() const _NOEXCEPT {
-      return m_msg;
+      return m_msg.c_str();
     }
 
     /**
@@ -64,9 +51,28 @@ class MifareError : public std::exception {
       return m_id;
     }
 
+    /**
+     * Returns the internal error code
+     * @return The error code of the underlying implementation.
+     **/
+    unsigned int res() const _NOEXCEPT {
+      return m_res;
+    }
+
+    /**
+     * Returns the second message
+     * @return The name of the failed step.
+     **/
+    const char *what2() const _NOEXCEPT {
+      return m_msg2.c_str();
+    }
+
   private:
-    const int m_id;
-    const char *m_msg;
+    int m_id;
+    unsigned int m_res;
+    // Copies, the error may outlive the message when it is carried from a worker thread to the main thread
+    std::string m_msg;
+    std::string m_msg2;
 };
 
 /**
@@ -104,6 +110,13 @@ MifareError errorResult(const Nan::FunctionCallbackInfo<v8::Value> &info, int no
  **/
 MifareError errorResult(const Nan::FunctionCallbackInfo<v8::Value> &info, int no, const std::string msg, unsigned int res=0, const std::string msg2 = "");
 
+/**
+ * Generates the error object {code, msg, msg2, res} of an error
+ * @param err The error, might be thrown on another thread.
+ * @return The javascript error object as used in the err list of a result.
+ **/
+v8::Local<v8::Object> errorObject(const MifareError &err);
+
 /**
  * Make an node::Buffer from unsigned char pointer and length
  * @param data The pointer to the data
@@ -112,6 +125,13 @@ MifareError errorResult(const Nan::FunctionCallbackInfo<v8::Value> &info, int no
  **/
 v8::Local<v8::Object> buffer(uint8_t *data, size_t len);
 
+/**
+ * Format bytes as lower case hex string, as freefare_get_tag_uid does
+ * @param data The pointer to the data
+ * @param len The length of the data
+ **/
+std::string hexString(const uint8_t *data, size_t len);
+
 /**
  * Set a default sleep value to delay commands sent to the card reader.
  * The usage of this library has shown, that very often the reader cannot
@@ -0,0 +1,56 @@
+// listen({autoRead}) reports the card with its UID, version and NDEF message read in one session
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+var uid = [0x04, 0x41, 0x55, 0x54, 0x4F, 0x00, 0x01];
+var blank = [0x04, 0x41, 0x55, 0x54, 0x4F, 0x00, 0x02];
+common.deadline(10000);
+
+mifare.mock.create(uid, {blank: true});
+mifare.mock.create(blank, {blank: true});
+var tap = common.tapper(reader);
+check(tap(uid).provision({ndef: ndef}), "provision");
+tap.remove();
+
+function autoRead(uid, verify, next) {
+  reader.listen(function(err, r, card) {
+    if(!card) {
+      return;
+    }
+    assert.equal(r.status, "present");
+    assert.equal(card.uid, common.hex(uid));
+    verify(card);
+    card.free();
+    mifare.mock.remove(reader.name);
+    setImmediate(function() {
+      mifare.mock.tick(reader);
+      next();
+    });
+  }, {autoRead: ["uid", "version", "ndef"]});
+  mifare.mock.insert(reader.name, uid);
+  mifare.mock.tick(reader);
+  // The card is read on the pool, the reader is not polled meanwhile
+  mifare.mock.tick(reader);
+}
+
+autoRead(uid, function(card) {
+  assert.equal(typeof card.version, "object");
+  assert.equal(card.ndef.ndef.toString("hex"), ndef.toString("hex"));
+  assert.ok(!card.readErr, "all parts read");
+  // The card object works as usual
+  assert.equal(check(card.readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+}, function() {
+  // A card without NDEF application is reported with the parts which could be read
+  autoRead(blank, function(card) {
+    assert.equal(typeof card.version, "object");
+    assert.equal(card.ndef, undefined);
+    assert.ok(card.readErr && card.readErr.length, "the NDEF read failed");
+  }, function() {
+    reader.release();
+  });
+});
@@ -0,0 +1,42 @@
+// The backup data file NDEF layout of provision and createNdef, and writeNdef into it
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var tap = common.tapper(reader);
+var std = [0x04, 0x42, 0x41, 0x43, 0x4B, 0x00, 0x01];
+var backup = [0x04, 0x42, 0x41, 0x43, 0x4B, 0x00, 0x02];
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+
+mifare.mock.create(std, {blank: true});
+mifare.mock.create(backup, {blank: true});
+var stdLength = check(tap(std).provision({}), "provision").data.maxLength;
+var backupLength = check(tap(backup).provision({layout: "backup"}), "provision").data.maxLength;
+assert.equal(backupLength, stdLength / 2, "the backup file has half the size");
+
+// NLEN and the message are committed together
+var card = tap(backup);
+check(card.writeNdef(ndef), "writeNdef");
+assert.equal(check(card.readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+var other = new Buffer(32);
+other.fill(0x17);
+check(card.writeNdef(other), "writeNdef");
+assert.equal(check(tap(backup).readNdef(), "readNdef").data.ndef.toString("hex"), other.toString("hex"));
+
+// A message for the standard file does not fit
+assert.ok(tap(backup).writeNdef(new Buffer(stdLength - 2)).err.length, "message larger than the backup file");
+
+// createNdef creates the same layout
+mifare.mock.create(backup, {blank: true});
+card = tap(backup);
+check(card.format(), "format");
+check(card.createNdef({layout: "backup"}), "createNdef");
+check(card.writeNdef(ndef), "writeNdef");
+assert.equal(check(tap(backup).readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+assert.ok(tap(backup).writeNdef(new Buffer(stdLength - 2)).err.length, "message larger than the backup file");
+
+tap.remove();
+reader.release();
@@ -0,0 +1,41 @@
+// A card held by another PC/SC application is retried until the deadline, or for 2 s without one, and fails with 0x1233A
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+var now = common.now;
+
+var reader = common.first(mifare.getReader());
+var uid = [0x04, 0x42, 0x55, 0x53, 0x59, 0x00, 0x01];
+var DEVICE_BUSY_ERROR = 0x1233A;
+var SHARING_VIOLATION = 0x8010000B;
+
+mifare.setCardCache({ttl: 0, versionTtl: 0});
+mifare.mock.create(uid);
+var tap = common.tapper(reader, {timeout: 100});
+var card = tap(uid);
+
+function busy(min, max) {
+  var start = now();
+  var res = card.info();
+  var time = now() - start;
+  assert.ok(res.err.length, "info fails while the card is held");
+  assert.equal(res.err[0].code, DEVICE_BUSY_ERROR);
+  assert.equal(res.err[0].res, SHARING_VIOLATION);
+  assert.ok(time >= min && time < max, "gave up after " + time + " ms");
+}
+
+assert.ok(mifare.mock.hold(reader.name, true));
+// Bounded by the deadline of the reader
+busy(50, 1000);
+// Without a deadline by the default wait
+card.setTimeout(0);
+busy(1500, 5000);
+
+// The card is used again as soon as it is given back
+card.setTimeout();
+assert.ok(mifare.mock.hold(reader.name, false));
+check(card.info(), "info");
+
+tap.remove();
+reader.release();
@@ -0,0 +1,66 @@
+// The card cache answers info() and freeMemory() without card commands until a write or transceive invalidates it
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var tap = common.tapper(reader);
+var uid = [0x04, 0x43, 0x41, 0x43, 0x48, 0x45, 0x01];
+var ndef = new Buffer(64);
+ndef.fill(0x42);
+// DESFire GetVersion wrapped in an ISO 7816-4 APDU
+var getVersion = new Buffer([0x90, 0x60, 0x00, 0x00, 0x00]);
+
+/** The number of card commands of a call */
+function commands(call) {
+  mifare.mock.reset();
+  call();
+  return mifare.mock.commands();
+}
+
+mifare.setCardCache({ttl: 60000, versionTtl: 3600000});
+// A card with NDEF application which was not seen before
+mifare.mock.create(uid);
+var card = tap(uid);
+
+function info() {
+  check(card.info(), "info");
+}
+function freeMemory() {
+  check(card.freeMemory(), "freeMemory");
+}
+
+assert.ok(commands(info) > 0, "first info reads the card");
+assert.equal(commands(info), 0, "info from the cache");
+assert.ok(commands(freeMemory) > 0, "first freeMemory reads the card");
+assert.equal(commands(freeMemory), 0, "freeMemory from the cache");
+
+// The cache is keyed by the UID, a new card object of the same card uses it
+card = tap(uid);
+assert.equal(commands(info), 0, "info from the cache after a new tap");
+
+// writeNdef drops the free memory, the version stays
+check(card.writeNdef(ndef), "writeNdef");
+assert.ok(commands(freeMemory) > 0, "freeMemory read again after writeNdef");
+assert.equal(commands(info), 0, "version kept after writeNdef");
+
+// transceive forgets the card
+check(card.transceive(getVersion), "transceive");
+assert.ok(commands(info) > 0, "info read again after transceive");
+assert.equal(commands(info), 0, "info cached again");
+check(card.transceiveMany([getVersion]), "transceiveMany");
+assert.ok(commands(info) > 0, "info read again after transceiveMany");
+
+// transceive drops the last message of the card as well, a differential write writes all of it
+mifare.mock.reset();
+check(card.writeNdef(ndef, {diff: true}), "writeNdef diff");
+assert.ok(mifare.mock.written() >= ndef.length, "full write after transceive");
+
+// Lifetimes of 0 disable the cache
+mifare.setCardCache({ttl: 0, versionTtl: 0});
+info();
+assert.ok(commands(info) > 0, "no cache");
+
+tap.remove();
+reader.release();
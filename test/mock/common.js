@@ -0,0 +1,20 @@
+// Helpers shared by the tests against the mock backend
+var common = require("../../bench/common");
+
+exports.mifare = common.mifare;
+exports.first = common.first;
+exports.check = common.check;
+exports.now = common.now;
+exports.tapper = common.tapper;
+
+/** The hex string of a byte array, as the UIDs of libfreefare */
+exports.hex = function(bytes) {
+  return new Buffer(bytes).toString("hex");
+};
+
+/** Fails a test whose callbacks never came */
+exports.deadline = function(ms) {
+  setTimeout(function() {
+    throw new Error("Timed out after " + ms + " ms");
+  }, ms).unref();
+};
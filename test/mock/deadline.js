@@ -0,0 +1,56 @@
+// The deadline of listen({timeout}): a command running past it fails with 0x12339 instead of its own error
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+
+var reader = common.first(mifare.getReader());
+var uid = [0x04, 0x44, 0x45, 0x41, 0x44, 0x00, 0x01];
+var DEADLINE_ERROR = 0x12339;
+common.deadline(10000);
+
+// Every read asks the card for its version
+mifare.setCardCache({ttl: 0, versionTtl: 0});
+mifare.mock.create(uid);
+mifare.mock.latency("get_version", 300000);
+
+/* autoRead the version and take the card away while GetVersion is still running on the pool */
+function slowRead(timeout, verify, next) {
+  reader.listen(function(err, r, card) {
+    if(!card) {
+      return;
+    }
+    verify(card.readErr);
+    card.free();
+    setImmediate(function() {
+      mifare.mock.tick(reader);
+      next();
+    });
+  }, {autoRead: ["version"], timeout: timeout});
+  mifare.mock.insert(reader.name, uid);
+  mifare.mock.tick(reader);
+  setTimeout(function() {
+    mifare.mock.remove(reader.name);
+  }, 20);
+}
+
+slowRead(50, function(errors) {
+  assert.ok(errors && errors.length, "the read failed");
+  assert.equal(errors[0].code, DEADLINE_ERROR);
+  assert.equal(errors[0].msg2, "Fetch Tag Version Info");
+}, function() {
+  // Without a deadline the command fails as the removed card makes it fail
+  slowRead(0, function(errors) {
+    assert.ok(errors && errors.length, "the read failed");
+    assert.notEqual(errors[0].code, DEADLINE_ERROR);
+  }, function() {
+    mifare.mock.latency("get_version", 0);
+    var tap = common.tapper(reader, {timeout: 50});
+    var card = tap(uid);
+    assert.strictEqual(card.setTimeout(1000), card);
+    assert.strictEqual(card.setTimeout(), card);
+    assert.equal(card.setTimeout("1000").err[0].code, 0x12302);
+    assert.ok(!card.info().err.length, "info within the deadline");
+    tap.remove();
+    reader.release();
+  });
+});
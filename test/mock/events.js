@@ -0,0 +1,71 @@
+// reader.events(): the queued events, the bounded ring and the end of an iteration
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+
+var reader = common.first(mifare.getReader());
+var uid = [0x04, 0x45, 0x56, 0x45, 0x4E, 0x54, 0x01];
+common.deadline(10000);
+
+function tap() {
+  mifare.mock.insert(reader.name, uid);
+  mifare.mock.tick(reader);
+  mifare.mock.remove(reader.name);
+  mifare.mock.tick(reader);
+}
+
+var events = reader.events({mode: "uid"});
+tap();
+// Polls without change are not queued
+mifare.mock.tick(reader);
+assert.equal(events.stats().queued, 2);
+
+events.next().then(function(res) {
+  assert.equal(res.done, false);
+  assert.equal(res.value.status, "present");
+  assert.equal(res.value.card.toString("hex"), common.hex(uid));
+  return events.next();
+}).then(function(res) {
+  assert.equal(res.value.status, "empty");
+  assert.equal(res.value.card, undefined);
+  assert.equal(events.stats().delivered, 2);
+
+  // The oldest events are dropped from a full ring
+  var ring = reader.events({mode: "uid", highWaterMark: 2});
+  // Another events call ends the previous iteration
+  assert.ok(events.stats().ended);
+  tap();
+  mifare.mock.insert(reader.name, uid);
+  mifare.mock.tick(reader);
+  var stats = ring.stats();
+  assert.equal(stats.queued, 2);
+  assert.equal(stats.dropped, 1);
+  return Promise.all([events.next(), ring.next(), ring.next()]);
+}).then(function(res) {
+  assert.equal(res[0].done, true);
+  assert.equal(res[1].value.status, "empty");
+  assert.equal(res[2].value.status, "present");
+
+  // break in for await releases the reader
+  var ring = reader.events({mode: "uid"});
+  return ring.return().then(function(res) {
+    assert.equal(res.done, true);
+    assert.ok(ring.stats().ended);
+    assert.throws(function() {
+      mifare.mock.tick(reader);
+    }, /not listening/);
+    return ring;
+  });
+}).then(function(ended) {
+  // The iterator outlives the reader
+  var ring = reader.events({mode: "uid"});
+  reader.release();
+  return Promise.all([ring.next(), ring.return(), ended.next()]);
+}).then(function(res) {
+  assert.equal(res[0].done, true);
+  assert.equal(res[1].done, true);
+  assert.equal(res[2].done, true);
+}).catch(function(err) {
+  console.error(err.stack);
+  process.exit(1);
+});
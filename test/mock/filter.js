@@ -0,0 +1,64 @@
+// The presence filter of listen: retapWindow, departureGrace and minPresence
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+
+var reader = common.first(mifare.getReader());
+var a = [0x04, 0x46, 0x49, 0x4C, 0x54, 0x00, 0x01];
+var b = [0x04, 0x46, 0x49, 0x4C, 0x54, 0x00, 0x02];
+var seen;
+common.deadline(10000);
+
+function listen(options) {
+  seen = [];
+  reader.listen(function(err, r, card) {
+    seen.push(card ? r.status + " " + card.toString("hex") : r.status);
+  }, Object.assign({mode: "uid"}, options));
+}
+
+function insert(uid) {
+  mifare.mock.insert(reader.name, uid);
+  mifare.mock.tick(reader);
+}
+
+function remove() {
+  mifare.mock.remove(reader.name);
+  mifare.mock.tick(reader);
+}
+
+// The same UID is not reported again within the window, another one is
+listen({retapWindow: 60000});
+insert(a);
+remove();
+insert(a);
+remove();
+insert(b);
+remove();
+assert.deepEqual(seen, ["present " + common.hex(a), "empty", "present " + common.hex(b), "empty"]);
+
+// A card back within the grace period is the same tap
+listen({departureGrace: 60000});
+insert(a);
+remove();
+insert(a);
+remove();
+assert.deepEqual(seen, ["present " + common.hex(a)]);
+// Polls of the empty field do not report the departure before the grace period
+mifare.mock.tick(reader);
+assert.deepEqual(seen, ["present " + common.hex(a)]);
+
+// A card has to stay in the field for minPresence
+listen({minPresence: 50});
+insert(b);
+assert.deepEqual(seen, []);
+setTimeout(function() {
+  mifare.mock.tick(reader);
+  assert.deepEqual(seen, ["present " + common.hex(b)]);
+  remove();
+  assert.deepEqual(seen, ["present " + common.hex(b), "empty"]);
+  // Gone before minPresence: neither arrival nor departure
+  insert(a);
+  remove();
+  assert.deepEqual(seen, ["present " + common.hex(b), "empty"]);
+  reader.release();
+}, 100);
@@ -0,0 +1,28 @@
+// info() reports uid and batchNumber as Buffers, hardware, software and production are built on first access
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var tap = common.tapper(reader);
+var uid = [0x04, 0x49, 0x4E, 0x46, 0x4F, 0x00, 0x01];
+
+mifare.mock.create(uid);
+var info = check(tap(uid).info(), "info").data;
+
+assert.ok(Buffer.isBuffer(info.uid));
+assert.equal(info.uid.toString("hex"), common.hex(uid));
+assert.ok(Buffer.isBuffer(info.batchNumber));
+assert.equal(info.batchNumber.toString("hex"), "bababababa");
+
+// The derived fields are built on the first read and kept
+var hardware = info.hardware;
+assert.deepEqual(hardware, {vendorId: 4, type: 1, subtype: 1, version: {major: 1, minor: 0}, storageSize: 0x1A, protocol: 5});
+assert.strictEqual(info.hardware, hardware, "built once");
+assert.equal(info.software.vendorId, 4);
+assert.equal(info.software.version.major, 1);
+assert.deepEqual(info.production, {week: 0x12, year: 0x26});
+
+tap.remove();
+reader.release();
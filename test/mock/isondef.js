@@ -0,0 +1,62 @@
+// readNdef remembers cards which answered without an NDEF free to read over ISO, but not reads which failed in transport
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var ndef = new Buffer(16);
+ndef.fill(0x49);
+var uid = [0x04, 0x49, 0x53, 0x4F, 0x00, 0x00, 0x01];
+var blank = [0x04, 0x49, 0x53, 0x4F, 0x00, 0x00, 0x02];
+common.deadline(10000);
+
+mifare.mock.create(uid, {blank: true});
+mifare.mock.create(blank, {blank: true});
+var tap = common.tapper(reader);
+check(tap(uid).provision({ndef: ndef}), "provision");
+
+// The commands of a read over ISO: SELECT of the application, the CC and the NDEF file, two READ BINARY
+var card = tap(uid);
+mifare.mock.reset();
+assert.equal(check(card.readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+var iso = mifare.mock.commands();
+
+// A blank card answers the SELECT of the NDEF Tag Application with 6A 82, the next read goes native right away
+card = tap(blank);
+check(card.info(), "info");
+mifare.mock.reset();
+assert.ok(card.readNdef().err.length, "a blank card has no NDEF");
+var first = mifare.mock.commands();
+mifare.mock.reset();
+assert.ok(card.readNdef().err.length, "a blank card has no NDEF");
+assert.equal(mifare.mock.commands(), first - 2, "the SELECTs are not sent again");
+tap.remove();
+
+// The card leaves the field while the first SELECT is running on the pool
+mifare.mock.latency("transmit", 200000);
+reader.listen(function(err, r, card) {
+  if(!card) {
+    return;
+  }
+  assert.equal(card.ndef, undefined);
+  assert.ok(card.readErr && card.readErr.length, "the read failed");
+  card.free();
+  mifare.mock.latency("transmit", 0);
+  setImmediate(function() {
+    mifare.mock.tick(reader);
+    // The failure is not taken for a card without ISO access
+    var tap = common.tapper(reader);
+    var card = tap(uid);
+    mifare.mock.reset();
+    assert.equal(check(card.readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+    assert.equal(mifare.mock.commands(), iso, "read over ISO again");
+    tap.remove();
+    reader.release();
+  });
+}, {autoRead: ["ndef"]});
+mifare.mock.insert(reader.name, uid);
+mifare.mock.tick(reader);
+setTimeout(function() {
+  mifare.mock.remove(reader.name);
+}, 20);
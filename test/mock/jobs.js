@@ -0,0 +1,72 @@
+// enqueueJob(): a job provisions the next blank card on any reader, other cards requeue it and go to listen
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+mifare.mock.readers(2);
+var readers = mifare.getReader();
+var a = readers["Mock Reader 00 00"];
+var b = readers["Mock Reader 00 01"];
+var used = [0x04, 0x4A, 0x4F, 0x42, 0x00, 0x00, 0x01];
+var blank = [0x04, 0x4A, 0x4F, 0x42, 0x00, 0x00, 0x02];
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+common.deadline(10000);
+
+mifare.mock.create(used);
+mifare.mock.create(blank, {blank: true});
+
+var listened = {};
+[a, b].forEach(function(reader) {
+  reader.listen(function(err, r, card) {
+    if(card) {
+      listened[r.name] = card.info().data;
+      card.free();
+      if(r.name == a.name) {
+        skipped();
+      }
+    }
+  });
+});
+
+var id = check(mifare.enqueueJob({ndef: ndef}, done), "enqueueJob").data;
+mifare.mock.insert(a.name, used);
+mifare.mock.tick(a);
+// The job runs on the pool, the reader is not polled meanwhile
+assert.equal(check(mifare.jobStats(), "jobStats").data.running, 1);
+mifare.mock.tick(a);
+assert.equal(listened[a.name], undefined);
+
+function skipped() {
+  // The card was not blank, the job waits for the next card
+  var stats = check(mifare.jobStats(), "jobStats").data;
+  assert.equal(stats.pending, 1);
+  assert.equal(stats.running, 0);
+  assert.equal(stats.readers[a.name].skipped, 1);
+  mifare.mock.insert(b.name, blank);
+  mifare.mock.tick(b);
+}
+
+function done(err, result) {
+  assert.equal(err, undefined);
+  assert.equal(result.id, id);
+  assert.equal(result.reader, b.name);
+  assert.equal(result.uid, common.hex(blank));
+  assert.ok(result.maxLength >= ndef.length + 2);
+  // The provisioned card is not reported to listen
+  assert.equal(listened[b.name], undefined);
+  var stats = check(mifare.jobStats(), "jobStats").data;
+  assert.equal(stats.pending, 0);
+  assert.equal(stats.done, 1);
+  assert.equal(stats.readers[b.name].done, 1);
+
+  // The message is on the card
+  mifare.mock.remove(b.name);
+  mifare.mock.tick(b);
+  var tap = common.tapper(b);
+  assert.equal(check(tap(blank).readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+  tap.remove();
+  a.release();
+  b.release();
+}
@@ -0,0 +1,46 @@
+// Key handles of createKey: use by cards, release() and the key a card keeps after the release
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var tap = common.tapper(reader);
+var piccKey = [0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80];
+var uid = [0x04, 0x4B, 0x45, 0x59, 0x00, 0x00, 0x01];
+var KEY_RELEASED = 0x12333;
+
+var key = mifare.createKey(piccKey, "des", true);
+assert.equal(key.type, "des");
+assert.equal(key.version, true);
+var wrong = mifare.createKey([0, 0, 0, 0, 0, 0, 0, 0], "des", true);
+
+mifare.mock.create(uid, {piccKey: piccKey, piccKeyType: "des"});
+var card = tap(uid);
+assert.strictEqual(card.setKey(wrong), card);
+assert.ok(card.format().err.length, "format with the wrong key fails");
+
+// The card keeps the key of a released handle
+assert.strictEqual(card.setKey(key), card);
+assert.strictEqual(check(key.release(), "release").data, true);
+check(card.format(), "format");
+
+// A released handle can't be used or released again
+assert.equal(key.release().err[0].code, KEY_RELEASED);
+assert.equal(card.setKey(key).err[0].code, KEY_RELEASED);
+assert.equal(card.provision({piccKey: key}).err[0].code, KEY_RELEASED);
+
+// Handles and plain bytes are interchangeable
+var again = mifare.createKey(piccKey, "des", true);
+check(tap(uid).provision({piccKey: again, appKey: piccKey}), "provision");
+
+// Forgotten handles are dropped by the garbage collector
+for(var i = 0; i < 1000; i++) {
+  mifare.createKey(piccKey, "des", true);
+}
+check(tap(uid).setKey(again).format(), "format");
+
+wrong.release();
+again.release();
+tap.remove();
+reader.release();
@@ -0,0 +1,45 @@
+// writeNdef(buf, {diff: true}) only writes the changed bytes and NLEN, the card ends with the full message
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var tap = common.tapper(reader);
+var ndef = new Buffer(512);
+ndef.fill(0x42);
+
+["std", "backup"].forEach(function(layout, i) {
+  var uid = [0x04, 0x44, 0x49, 0x46, 0x46, 0x00, i];
+  mifare.mock.create(uid, {blank: true});
+  var card = tap(uid);
+  check(card.provision({ndef: ndef, layout: layout}), "provision");
+
+  mifare.mock.reset();
+  ndef.writeUInt32BE(1, 16);
+  check(card.writeNdef(ndef, {diff: true}), "writeNdef diff");
+  var diff = mifare.mock.written();
+  assert.ok(diff > 0, layout + ": the change is written");
+  assert.equal(check(card.readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+
+  mifare.mock.reset();
+  ndef.writeUInt32BE(2, 16);
+  check(card.writeNdef(ndef), "writeNdef");
+  var full = mifare.mock.written();
+  assert.ok(full >= ndef.length, layout + ": the full write covers the message");
+  if(layout == "std") {
+    assert.ok(diff < full, "diff writes " + diff + " bytes, the full write " + full);
+  }
+
+  // Unchanged bytes are not written again, the message read back is the last one
+  mifare.mock.reset();
+  check(card.writeNdef(ndef, {diff: true}), "writeNdef diff");
+  if(layout == "std") {
+    assert.ok(mifare.mock.written() < 8, "at most NLEN is written for an unchanged message");
+  }
+  card = tap(uid);
+  assert.equal(check(card.readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+});
+
+tap.remove();
+reader.release();
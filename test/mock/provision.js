@@ -0,0 +1,47 @@
+// provision() formats a blank card, creates the NDEF application and writes the message in one session
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var tap = common.tapper(reader);
+var key = mifare.createKey([0, 0, 0, 0, 0, 0, 0, 0], "des", true);
+var uid = [0x04, 0x50, 0x52, 0x4F, 0x56, 0x00, 0x01];
+var ndef = new Buffer(128);
+ndef.fill(0x42);
+// Both ways read the version from the card
+mifare.setCardCache({ttl: 0, versionTtl: 0});
+
+mifare.mock.create(uid, {blank: true});
+var card = tap(uid);
+assert.ok(card.readNdef().err.length, "a blank card has no NDEF application");
+
+mifare.mock.reset();
+check(card.provision({piccKey: key, appKey: key, ndef: ndef}), "provision");
+var provisioned = mifare.mock.commands();
+var read = check(card.readNdef(), "readNdef").data;
+assert.equal(read.ndef.toString("hex"), ndef.toString("hex"));
+
+// The card keeps its content for the next tap
+card = tap(uid);
+assert.equal(check(card.readNdef(), "readNdef").data.ndef.toString("hex"), ndef.toString("hex"));
+
+// The same through format, createNdef and writeNdef takes more commands
+mifare.mock.create(uid, {blank: true});
+card = tap(uid);
+mifare.mock.reset();
+check(card.format(), "format");
+check(card.createNdef(), "createNdef");
+check(card.writeNdef(ndef), "writeNdef");
+assert.ok(provisioned < mifare.mock.commands(), "provision " + provisioned + " commands, separate calls " + mifare.mock.commands());
+
+// Provisioning again replaces the message
+var other = new Buffer(64);
+other.fill(0x17);
+check(card.provision({piccKey: key, appKey: key, ndef: other}), "provision");
+assert.equal(check(tap(uid).readNdef(), "readNdef").data.ndef.toString("hex"), other.toString("hex"));
+
+key.release();
+tap.remove();
+reader.release();
@@ -0,0 +1,21 @@
+// Runs each test against the mock backend in its own process.
+//
+//   node-gyp rebuild && npm test
+var spawnSync = require("child_process").spawnSync;
+var fs = require("fs");
+var path = require("path");
+
+var failed = 0;
+fs.readdirSync(__dirname).sort().forEach(function(file) {
+  if(!/\.js$/.test(file) || file == "run.js" || file == "common.js") {
+    return;
+  }
+  var res = spawnSync(process.execPath, [path.join(__dirname, file)], {stdio: "inherit", timeout: 30000});
+  if(res.status === 0) {
+    console.log("ok " + file);
+  } else {
+    console.log("not ok " + file);
+    failed++;
+  }
+});
+process.exit(failed ? 1 : 0);
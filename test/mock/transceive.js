@@ -0,0 +1,51 @@
+// Raw commands through transceive() and transceiveMany(), into new and into given Buffers
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+
+var reader = common.first(mifare.getReader());
+var tap = common.tapper(reader);
+var uid = [0x04, 0x54, 0x52, 0x58, 0x00, 0x00, 0x02];
+// The UID through the GET DATA pseudo APDU
+var getUid = new Buffer([0xFF, 0xCA, 0x00, 0x00, 0x00]);
+// DESFire GetVersion wrapped in an ISO 7816-4 APDU, the first frame is the hardware version
+var getVersion = new Buffer([0x90, 0x60, 0x00, 0x00, 0x00]);
+var unsupported = new Buffer([0x80, 0x12, 0x00, 0x00, 0x00]);
+
+var card = tap(uid);
+
+var res = check(card.transceive(getUid), "transceive");
+assert.ok(Buffer.isBuffer(res.data));
+assert.equal(res.data.toString("hex"), common.hex(uid) + "9000");
+
+res = check(card.transceive(getVersion), "transceive");
+assert.equal(res.data.length, 9);
+assert.equal(res.data.slice(7).toString("hex"), "91af");
+
+// The status word of a rejected command is data, not an error
+res = check(card.transceive(unsupported), "transceive");
+assert.equal(res.data.toString("hex"), "6a81");
+
+// Into a given Buffer the data is the number of bytes written
+var response = new Buffer(16);
+res = check(card.transceive(getUid, response), "transceive");
+assert.equal(res.data, 9);
+assert.equal(response.slice(0, 9).toString("hex"), common.hex(uid) + "9000");
+
+// All commands in one session
+mifare.mock.reset();
+res = check(card.transceiveMany([getUid, getVersion, getUid]), "transceiveMany");
+assert.equal(mifare.mock.commands(), 3);
+assert.equal(res.data.length, 3);
+assert.equal(res.data[0].toString("hex"), common.hex(uid) + "9000");
+assert.equal(res.data[1].slice(7).toString("hex"), "91af");
+assert.equal(res.data[2].toString("hex"), common.hex(uid) + "9000");
+
+var responses = [new Buffer(16), new Buffer(16)];
+res = check(card.transceiveMany([getUid, getVersion], responses), "transceiveMany");
+assert.deepEqual(res.data, [9, 9]);
+assert.equal(responses[0].slice(0, 9).toString("hex"), common.hex(uid) + "9000");
+
+tap.remove();
+reader.release();
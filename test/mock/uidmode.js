@@ -0,0 +1,32 @@
+// listen({mode: "uid"}) reports a Buffer with the UID instead of a card object
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+
+var reader = common.first(mifare.getReader());
+var uid = [0x04, 0x55, 0x49, 0x44, 0x00, 0x00, 0x01];
+var events = [];
+
+reader.listen(function(err, r, card) {
+  assert.equal(err, undefined);
+  if(r.status != "timeout") {
+    events.push({status: r.status, card: card});
+  }
+}, {mode: "uid"});
+
+mifare.mock.insert(reader.name, uid);
+mifare.mock.reset();
+mifare.mock.tick(reader);
+// Only the GET DATA pseudo APDU is sent
+assert.equal(mifare.mock.commands(), 1);
+mifare.mock.remove(reader.name);
+mifare.mock.tick(reader);
+
+assert.equal(events.length, 2);
+assert.equal(events[0].status, "present");
+assert.ok(Buffer.isBuffer(events[0].card), "the arrival reports a Buffer");
+assert.equal(events[0].card.toString("hex"), common.hex(uid));
+assert.equal(events[1].status, "empty");
+assert.equal(events[1].card, undefined);
+
+reader.release();
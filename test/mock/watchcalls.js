@@ -0,0 +1,64 @@
+// watchCalls reports the card calls and reader polls which take at least the threshold
+var assert = require("assert");
+var common = require("./common");
+var mifare = common.mifare;
+var check = common.check;
+var now = common.now;
+
+var reader = common.first(mifare.getReader());
+var uid = [0x04, 0x57, 0x41, 0x54, 0x43, 0x48, 0x01];
+var reports = [];
+
+mifare.setCardCache({ttl: 0, versionTtl: 0});
+mifare.mock.create(uid);
+mifare.watchCalls({threshold: 20}, function(report) {
+  reports.push(report);
+});
+
+// A listen callback blocking the event loop makes its poll slow
+var card;
+reader.listen(function(err, r, tag) {
+  if(tag) {
+    card = tag;
+    for(var start = now(); now() - start < 30;) {
+    }
+  }
+}, {});
+mifare.mock.insert(reader.name, uid);
+mifare.mock.tick(reader);
+assert.ok(card, "the card arrived");
+assert.equal(reports.length, 1);
+assert.equal(reports[0].method, "poll");
+assert.equal(reports[0].reader, reader.name);
+assert.ok(!reports[0].uid, "a poll has no uid");
+assert.ok(reports[0].time >= 30);
+
+// A slow card command, the uid is known once the call read it
+mifare.mock.latency("get_version", 30000);
+check(card.info(), "info");
+assert.equal(reports.length, 2);
+assert.equal(reports[1].method, "info");
+assert.equal(reports[1].reader, reader.name);
+assert.equal(reports[1].uid, common.hex(uid));
+assert.ok(reports[1].time >= 30);
+
+// Fast calls are only counted
+mifare.mock.latency("get_version", 0);
+check(card.info(), "info");
+assert.equal(reports.length, 2);
+
+var stats = mifare.watchCalls();
+assert.ok(stats.calls >= 4, "calls counted");
+assert.equal(stats.slow, 2);
+assert.ok(stats.maxMs >= 30);
+
+// Stopped
+mifare.mock.latency("get_version", 30000);
+check(card.info(), "info");
+assert.equal(reports.length, 2);
+
+mifare.mock.latency("get_version", 0);
+card.free();
+mifare.mock.remove(reader.name);
+mifare.mock.tick(reader);
+reader.release();